@@ -0,0 +1,34 @@
+#version 430 core
+
+layout (local_size_x = 256) in;
+
+// written by splat_covariances.cs
+struct ProjectedSplat {
+    vec4 position;        // ndc
+    vec4 conic;           // inverse of the 2D covariance (xx, xy, yy) and the splat index as float bits
+    vec4 colorAndOpacity;
+};
+
+// indices into the compacted projected splats, sorted by tile and depth
+layout(std430, binding = 3) buffer IndexBuffer {
+    uint indices[];
+};
+
+layout(std430, binding = 5) buffer ProjectedBuffer {
+    ProjectedSplat projected[];
+};
+
+layout(std430, binding = 6) buffer TileSplatBuffer {
+    ProjectedSplat tileSplats[];
+};
+
+uniform uint numEntries;
+
+// copies the projected splats into the sorted order, so that every tile reads its splats as one contiguous block
+void main() {
+    const uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+
+    for (uint i = gl_GlobalInvocationID.x; i < numEntries; i += stride) {
+        tileSplats[i] = projected[indices[i]];
+    }
+}
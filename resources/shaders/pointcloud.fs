@@ -1,7 +1,24 @@
 #version 430 core
+in vec4 splatColor;
+in float splatContour;
+
 out vec4 FragColor;
 
+// per pixel threshold in [0, 1), Jimenez's interleaved gradient noise
+float ditherThreshold(vec2 pixel)
+{
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
 void main()
 {
-	FragColor = vec4(1.0, 1.0, 0.0, 1.0);
-}
\ No newline at end of file
+    // the gaussian of the splat over the sprite, which ends at the contour of the footprint
+    vec2 offset = 2.0 * gl_PointCoord - 1.0;
+    float r2 = dot(offset, offset);
+    if (r2 > 1.0) discard;
+    float alpha = splatColor.w * exp(-0.5 * splatContour * splatContour * r2);
+
+    // no sort: the depth test keeps the nearest splat of a pixel, transparency becomes a screen door pattern
+    if (alpha < ditherThreshold(gl_FragCoord.xy)) discard;
+    FragColor = vec4(splatColor.rgb, 1.0);
+}
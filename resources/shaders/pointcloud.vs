@@ -1,9 +1,61 @@
 #version 430 core
 layout (location = 0) in vec3 aPos;
 
+// the splats of the SplatBuffers, bound like for splat_covariances.cs
+layout(std430, binding = 0) readonly buffer InputBuffer {
+    mat4 inputCovariance[];
+};
+
+layout(std430, binding = 4) readonly buffer ColorOpacityBuffer {
+    vec4 colorAndOpacity[];
+};
+
+uniform mat4 view;
 uniform mat4 mvp;
+uniform float near;
+uniform float screenRightCoord;
+uniform float screenTopCoord;
+uniform vec2 viewportSize;
+uniform float alphaCutoff;
+uniform float maxPointSize;
+
+out vec4 splatColor;
+out float splatContour;
 
 void main()
 {
-	gl_Position = mvp * vec4(aPos, 1.0f);
-}
\ No newline at end of file
+    vec4 color = colorAndOpacity[gl_VertexID];
+    gl_Position = mvp * vec4(aPos, 1.0f);
+
+    // culled like in splat_covariances.cs, outside of the clip volume
+    if (color.w < alphaCutoff || abs(gl_Position.z) > gl_Position.w) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        return;
+    }
+
+    // the projected 2D covariance as in splat_covariances.cs, scaled from ndc to pixels
+    vec4 viewPos = view * vec4(aPos, 1.0);
+    float onePerPosz = 1.0 / viewPos.z;
+    float pixelsX = 0.5 * viewportSize.x * near / screenRightCoord;
+    float pixelsY = 0.5 * viewportSize.y * near / screenTopCoord;
+    mat3 J = mat3(
+        -pixelsX * onePerPosz,  0,                     pixelsX * viewPos.x * onePerPosz * onePerPosz,
+        0,                     -pixelsY * onePerPosz,  pixelsY * viewPos.y * onePerPosz * onePerPosz,
+        0,                      0,                     0
+    );
+    mat3 JW = J * mat3(view);
+    mat2 splatCovariance = mat2(JW * mat3(inputCovariance[gl_VertexID]) * transpose(JW));
+
+    // a round sprite of the same area as the footprint: the geometric mean of the axes
+    float var_x = splatCovariance[0][0];
+    float var_y = splatCovariance[1][1];
+    float cov_xy = splatCovariance[0][1];
+    float determinant = max(var_x * var_y - cov_xy * cov_xy, 0.0);
+    float contourRadius = min(3.034798181, sqrt(2.0 * log(color.w / alphaCutoff)));
+    float radius = contourRadius * sqrt(sqrt(determinant));
+
+    gl_PointSize = clamp(2.0 * radius, 1.0, maxPointSize);
+    splatColor = color;
+    splatContour = contourRadius;
+}
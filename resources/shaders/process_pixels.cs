@@ -1,45 +1,152 @@
 #version 430 core
 
 
-// might need to make higher, the upper limit on how many gaussians can overlap a tile
-const uint MAX_NUM_GAUSSIANS_PER_TILE = 800;
+// compile time parameters, SplatRenderer injects them after the #version line (see ShaderVariantCache)
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+// splats copied to shared memory at a time, chosen from GL_MAX_COMPUTE_SHARED_MEMORY_SIZE
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 512
+#endif
+#ifndef BACKGROUND_COLOR
+#define BACKGROUND_COLOR vec3(0.5)
+#endif
+// large splats merged into the tiles, at most MAX_LARGE_SPLATS of tile_binning.h and at most TILE_SIZE * TILE_SIZE
+#ifndef MAX_LARGE_SPLATS
+#define MAX_LARGE_SPLATS 64
+#endif
+// DEBUG_OUTPUT writes the share of the tile's splats that were blended into each pixel instead of the color
+// TILE_STATS writes the per tile counters of the workload heatmap to TileStatsBuffer
+
 const float SATURATION_THRESHOLD = 0.01;
-const float ALPHA_SKIP_THRESHOLD = 1.0 / 255.0;
-const vec3 BACKGROUND_COLOR = vec3(0.5);
-
-layout (local_size_x = 16, local_size_y = 16) in;
-
-layout(std430, binding = 1) buffer GaussianBuffer {
-    struct {
-        mat2 covariance;
-        vec4 position;
-        vec4 clipPos; // only for debugging
-        ivec2 topCorner;
-        ivec2 botCorner;
-        vec4 axisLength; // only for debugging
-    } gaussianData[];
+const uint NO_SATURATION = 0xFFFFFFFFu;
+const uint TILE_INVOCATIONS = uint(TILE_SIZE * TILE_SIZE);
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+// written by splat_covariances.cs
+struct ProjectedSplat {
+    vec4 position;        // ndc
+    vec4 conic;           // inverse of the 2D covariance (xx, xy, yy) and the splat index as float bits
+    vec4 colorAndOpacity;
 };
 
 layout(std430, binding = 2) buffer RangeBuffer {
     uint ranges[];
 };
 
-layout(std430, binding = 3) buffer IndexBuffer {
-    uint indices[];
+// splats of every tile stored contiguously in sorted order by gather_tiles.cs,
+// ranges[tile] and ranges[tile + 1] bound the splats of a tile
+layout(std430, binding = 6) buffer TileSplatBuffer {
+    ProjectedSplat tileSplats[];
+};
+
+// per tile, the farthest ndc depth at which a pixel saturated as float bits, or NO_SATURATION if some pixel
+// never did. Read back by the occlusion culling of the next frame (occlusion_culling.h).
+layout(std430, binding = 8) buffer TileSaturationBuffer {
+    uint tileSaturation[];
+};
+
+// tile rects (min x, min y, max x, max y) of the splats that cover too many tiles to be binned, see
+// TileBins::largeSplats. gather_tiles.cs writes them in depth order after the splats of the tiles, from
+// largeSplatsBegin on, and every tile merges the ones touching it into its own splats by depth.
+layout(std430, binding = 9) buffer LargeSplatBuffer {
+    ivec4 largeRects[];
 };
 
-layout(std430, binding = 4) buffer ColorOpacityBuffer {
-    vec4 colorAndOpacity[];
+#ifdef TILE_STATS
+// matches TileStats in tile_stats.h
+struct TileStats {
+    uint splats;          // splats of the tile, with the large splats touching it
+    uint truncated;       // splats beyond maxSplatsPerTile
+    uint evaluated;       // splats visited before saturating, summed over the pixels
+    uint contributed;     // splats blended, summed over the pixels
+    uint saturated;       // pixels that saturated
+    uint saturationDepth; // as in tileSaturation
 };
 
+layout(std430, binding = 10) buffer TileStatsBuffer {
+    TileStats tileStats[];
+};
+
+shared uint sharedEvaluated;
+shared uint sharedContributed;
+#endif
+
 layout(rgba32f, binding = 0) uniform image2D outputImage;
 
+// quality settings, 1/255 and 800 at full quality
+uniform float alphaCutoff;
+uniform uint maxSplatsPerTile;
+
+uniform uint largeSplatsBegin;
+uniform uint numLargeSplats;
+
 shared uvec2 sharedIndicesBounds;
+// threads whose pixel is saturated, the tile stops loading batches once all are
+shared uint sharedDoneCount;
+shared uint sharedSaturationDepth;
+
+shared vec4 sharedConicAndOpacity[BATCH_SIZE];
+shared vec3 sharedPosition[BATCH_SIZE]; // ndc x, y and depth
+shared vec3 sharedColor[BATCH_SIZE];
+
+// the large splats touching the tile, in depth order
+shared uint sharedLargeTouches[MAX_LARGE_SPLATS];
+shared uint sharedLargeCount;
+shared vec4 sharedLargeConicAndOpacity[MAX_LARGE_SPLATS];
+shared vec3 sharedLargePosition[MAX_LARGE_SPLATS];
+shared vec3 sharedLargeColor[MAX_LARGE_SPLATS];
+
+// blends one splat into the pixel front to back, returns true once the pixel is saturated
+bool blendSplat(vec2 ndcCoord, vec4 conic, vec3 position, vec3 color, inout vec3 L, inout float T_i, inout float T_next,
+                inout uint evaluated, inout uint blended) {
+    evaluated++;
+
+    // compute alpha_i with:
+    //  -opacity_i
+    //  -thread pixel coordinate x
+    //  -covariance_i
+    //  -(gaussian center position)_i
+    
+    // (x - mu_i)
+    vec2 diff_i = (ndcCoord - position.xy);
+
+    // (x - mu_i)^T * Sigma^-1 * (x - mu_i), with Sigma^-1 = [conic.x conic.y; conic.y conic.z]
+    float shape = conic.x * diff_i.x * diff_i.x + 2.0 * conic.y * diff_i.x * diff_i.y + conic.z * diff_i.y * diff_i.y;
 
-shared mat2 sharedInvCov[MAX_NUM_GAUSSIANS_PER_TILE];   
-shared vec3 sharedPosition[MAX_NUM_GAUSSIANS_PER_TILE];
-shared vec3 sharedColor[MAX_NUM_GAUSSIANS_PER_TILE];
-shared float sharedOpacity[MAX_NUM_GAUSSIANS_PER_TILE];    
+    // exp(-0.5 * (x - mu_i)^T * Sigma_i^-1 * (x - mu_i))
+    float G_i = exp(-0.5 * shape);
+
+    float alpha_i = conic.w * G_i; 
+
+    alpha_i = min(alpha_i, 0.99); // clamp alpha to 0.99 from above
+
+    if (alpha_i < alphaCutoff) return false;
+    
+
+    // Update T:
+    // T_i+1 = T_i * (1 - alpha_i)
+
+    T_next = T_i * (1-alpha_i);
+
+    if (T_next < SATURATION_THRESHOLD) { // think through if correct, maybe put in the end
+        atomicAdd(sharedDoneCount, 1);
+        // the depths are positive after the frustum culling except right at the near plane, where the
+        // binning's depth keys wrap around; a depth of 1 keeps the tile from culling anything
+        float depth = position.z;
+        atomicMax(sharedSaturationDepth, floatBitsToUint(depth < 0.0 ? 1.0 : depth));
+        return true;
+    }
+
+    // compute the final effect of the gaussian i
+    L += color * alpha_i * T_i;
+    blended++;
+
+    T_i = T_next;
+    return false;
+}
 
 void main() {
 
@@ -75,87 +182,116 @@ void main() {
     if (localIndex < 2) {
         sharedIndicesBounds[localIndex] = ranges[tileIndex + localIndex];
     }
+    if (localIndex == 0) {
+        sharedLargeCount = 0;
+        sharedDoneCount = 0;
+        sharedSaturationDepth = 0;
+#ifdef TILE_STATS
+        sharedEvaluated = 0;
+        sharedContributed = 0;
+#endif
+    }
+
+    // one thread per large splat checks whether it touches the tile
+    if (localIndex < numLargeSplats) {
+        ivec4 rect = largeRects[localIndex];
+        ivec2 tile = ivec2(gl_WorkGroupID.xy);
+        sharedLargeTouches[localIndex] = uint(all(greaterThanEqual(tile, rect.xy)) && all(lessThanEqual(tile, rect.zw)));
+    }
     barrier();
 
+    // the touching ones are copied to shared memory, their slot is the number of touching ones before them
+    if (localIndex < numLargeSplats && sharedLargeTouches[localIndex] != 0u) {
+        uint slot = 0;
+        for (uint j = 0; j < localIndex; j++) slot += sharedLargeTouches[j];
+        ProjectedSplat splat = tileSplats[largeSplatsBegin + localIndex];
+        sharedLargeConicAndOpacity[slot] = vec4(splat.conic.xyz, splat.colorAndOpacity.w);
+        sharedLargePosition[slot] = splat.position.xyz;
+        sharedLargeColor[slot] = splat.colorAndOpacity.rgb;
+        atomicAdd(sharedLargeCount, 1);
+    }
+    barrier();
 
     // return if no gaussians in the tile
-    if (sharedIndicesBounds[0] == sharedIndicesBounds[1]) {
+    if (sharedIndicesBounds[0] == sharedIndicesBounds[1] && sharedLargeCount == 0) {
         imageStore(outputImage, texelCoord, vec4(BACKGROUND_COLOR, 1.0));
+        if (localIndex == 0) tileSaturation[tileIndex] = NO_SATURATION;
+#ifdef TILE_STATS
+        if (localIndex == 0) tileStats[tileIndex] = TileStats(0, 0, 0, 0, 0, NO_SATURATION);
+#endif
         return;
     }
 
-    // then each thread reads  0 - 2 indices from indices[] and stores corresponding
-    // covariances and positions to shared memory
-    for (uint i = localIndex; sharedIndicesBounds[0] + i < sharedIndicesBounds[1] && i < MAX_NUM_GAUSSIANS_PER_TILE; i = i + 256) {
-        uint index = indices[sharedIndicesBounds[0] + i];
-        sharedInvCov[i] = inverse(gaussianData[index].covariance); // TODO: should do this in the earlier stage
-        sharedPosition[i] = gaussianData[index].position.xyz;
-        sharedColor[i] = colorAndOpacity[index].xyz;
-        sharedOpacity[i] = colorAndOpacity[index].w;
-    }
-    barrier();
-    
-    // uint a = sharedIndicesBounds[1] - 1;
-    // uint a = 3;
+    // the splats are sorted front to back, a limit drops the farthest ones
+    const uint begin = sharedIndicesBounds[0];
+    const uint count = min(sharedIndicesBounds[1] - begin, maxSplatsPerTile);
 
-    // // hyvä visualisaatio kuinka täysiä shared memoryt on
-    // vec3 L = vec3(float(sharedIndicesBounds[1] - sharedIndicesBounds[0]) / float(MAX_NUM_GAUSSIANS_PER_TILE));
-    // imageStore(outputImage, texelCoord, vec4(L, 1.0));
-    // return;
-    
     vec3 L = vec3(0.0);
     float T_i = 1.0; 
     float T_next = 1.0;
+    bool done = false;
+    uint evaluated = 0;
+    uint blended = 0;
+    // next large splat of the tile
+    uint large = 0;
+
+    for (uint batch = 0; batch < count; batch += uint(BATCH_SIZE)) {
+        // each thread copies a few splats of the batch to shared memory,
+        // the splats are stored contiguously so the reads are linear
+        for (uint i = localIndex; i < uint(BATCH_SIZE) && batch + i < count; i += TILE_INVOCATIONS) {
+            ProjectedSplat splat = tileSplats[begin + batch + i];
+            sharedConicAndOpacity[i] = vec4(splat.conic.xyz, splat.colorAndOpacity.w);
+            sharedPosition[i] = splat.position.xyz;
+            sharedColor[i] = splat.colorAndOpacity.rgb;
+        }
+        barrier();
+
+        for (uint i = 0; !done && i < min(uint(BATCH_SIZE), count - batch); i++) {
+            // the large splats in front of this one come first
+            for (; !done && large < sharedLargeCount && sharedLargePosition[large].z < sharedPosition[i].z; large++) {
+                done = blendSplat(ndcCoord, sharedLargeConicAndOpacity[large], sharedLargePosition[large], sharedLargeColor[large],
+                                  L, T_i, T_next, evaluated, blended);
+            }
+            if (done) break;
+
+            done = blendSplat(ndcCoord, sharedConicAndOpacity[i], sharedPosition[i], sharedColor[i], L, T_i, T_next, evaluated, blended);
+        }
+        barrier();
+
+        // every pixel of the tile is saturated, the remaining batches can not change it
+        if (sharedDoneCount == TILE_INVOCATIONS) break;
+    }
 
-    for (int i = 0; i < min(sharedIndicesBounds[1] - sharedIndicesBounds[0], MAX_NUM_GAUSSIANS_PER_TILE); i++) {
-
-        // compute alpha_i with:
-        //  -opacity_i
-        //  -thread pixel coordinate x
-        //  -covariance_i
-        //  -(gaussian center position)_i
-        
-        // (x - mu_i)
-        vec2 diff_i = (ndcCoord - sharedPosition[i].xy);
-
-        // (x - mu_i)^T * Sigma^-1 * (x - mu_i)
-        float shape = dot(diff_i, sharedInvCov[i] * diff_i);
-
-        // exp(-0.5 * (x - mu_i)^T * Sigma_i^-1 * (x - mu_i))
-        float G_i = exp(-0.5 * shape);
-
-        float alpha_i = sharedOpacity[i] * G_i; 
-
-        alpha_i = min(alpha_i, 0.99); // clamp alpha to 0.99 from above
-
-        if (alpha_i < ALPHA_SKIP_THRESHOLD) continue;
-        
-
-        // Update T:
-        // T_i+1 = T_i * (1 - alpha_i)
-
-        T_next = T_i * (1-alpha_i);
-
-        if (T_next < SATURATION_THRESHOLD) break; // think through if correct, maybe put in the end
-
-        // compute the final effect of the gaussian i
-
-        // L.r += sharedColor[i].r * alpha_i * T_i;
-        // L.g += sharedColor[i].g * alpha_i * T_i;
-        // L.b += sharedColor[i].b * alpha_i * T_i;
-
-        L += sharedColor[i] * alpha_i * T_i;
+    // the large splats behind all splats of the tile
+    for (; !done && large < sharedLargeCount; large++) {
+        done = blendSplat(ndcCoord, sharedLargeConicAndOpacity[large], sharedLargePosition[large], sharedLargeColor[large],
+                          L, T_i, T_next, evaluated, blended);
+    }
+    barrier();
 
-        T_i = T_next;
+    // every atomic of the tile happened before the last barrier
+    if (localIndex == 0) {
+        tileSaturation[tileIndex] = sharedDoneCount == TILE_INVOCATIONS ? sharedSaturationDepth : NO_SATURATION;
+    }
 
+#ifdef TILE_STATS
+    atomicAdd(sharedEvaluated, evaluated);
+    atomicAdd(sharedContributed, blended);
+    barrier();
+    if (localIndex == 0) {
+        const uint tileCount = sharedIndicesBounds[1] - sharedIndicesBounds[0];
+        tileStats[tileIndex] = TileStats(tileCount + sharedLargeCount, tileCount - count, sharedEvaluated, sharedContributed,
+                                         sharedDoneCount, sharedDoneCount == TILE_INVOCATIONS ? sharedSaturationDepth : NO_SATURATION);
     }
+#endif
 
     // after for-loop blend the background color to L
     L += BACKGROUND_COLOR * T_next;
 
+#ifdef DEBUG_OUTPUT
+    L = vec3(float(blended) / float(max(count + sharedLargeCount, 1u)));
+#endif
+
     // set the texture value here
     imageStore(outputImage, texelCoord, vec4(L, 1.0));
 }
-
-
-
@@ -0,0 +1,139 @@
+#version 430 core
+
+
+// compile time parameters, see process_pixels.cs
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+// splats copied to shared memory at a time, the tiles are processed in chunks of this size
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 512
+#endif
+#ifndef MAX_LARGE_SPLATS
+#define MAX_LARGE_SPLATS 64
+#endif
+
+const uint TILE_INVOCATIONS = uint(TILE_SIZE * TILE_SIZE);
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+// written by splat_covariances.cs
+struct ProjectedSplat {
+    vec4 position;        // ndc
+    vec4 conic;           // inverse of the 2D covariance (xx, xy, yy) and the splat index as float bits
+    vec4 colorAndOpacity;
+};
+
+layout(std430, binding = 2) buffer RangeBuffer {
+    uint ranges[];
+};
+
+// splats of every tile stored contiguously by gather_tiles.cs, in any order
+layout(std430, binding = 6) buffer TileSplatBuffer {
+    ProjectedSplat tileSplats[];
+};
+
+// tile rects of the large splats stored after the splats of the tiles, see process_pixels.cs
+layout(std430, binding = 9) buffer LargeSplatBuffer {
+    ivec4 largeRects[];
+};
+
+// sum of color * weight (rgb) and of weight (a), and the product of (1 - alpha), combined by resolve_weighted.cs
+layout(rgba32f, binding = 1) uniform image2D accumImage;
+layout(r32f, binding = 2) uniform image2D revealageImage;
+
+uniform float alphaCutoff;
+
+uniform uint largeSplatsBegin;
+uniform uint numLargeSplats;
+
+shared uvec2 sharedIndicesBounds;
+
+shared vec3 sharedConic[BATCH_SIZE];
+shared vec3 sharedPosition[BATCH_SIZE]; // ndc x, y and depth in [0, 1]
+shared vec4 sharedColorAndOpacity[BATCH_SIZE];
+
+shared uint sharedLargeTouches[MAX_LARGE_SPLATS];
+
+// accumulates one splat into the pixel
+void accumulateSplat(vec2 ndcCoord, vec3 conic, vec3 position, vec4 colorAndOpacity, inout vec4 accum, inout float revealage) {
+    vec2 diff_i = ndcCoord - position.xy;
+    float shape = conic.x * diff_i.x * diff_i.x + 2.0 * conic.y * diff_i.x * diff_i.y + conic.z * diff_i.y * diff_i.y;
+
+    float alpha_i = min(colorAndOpacity.w * exp(-0.5 * shape), 0.99);
+    if (alpha_i < alphaCutoff) return;
+
+    // depth weight, equation (10) of the paper
+    float d = 1.0 - position.z;
+    float weight = alpha_i * clamp(3e3 * d * d * d, 1e-2, 3e3);
+
+    accum += vec4(colorAndOpacity.rgb * weight, weight);
+    revealage *= 1.0 - alpha_i;
+}
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013).
+// Every splat that covers the pixel is accumulated with a weight that falls off with depth, so nearer splats
+// dominate without the splats being sorted. There is no early termination, all splats of the tile are visited.
+void main() {
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    // [0, 800] x [0, 800] --> [-1,1] x [-1,1]
+    vec2 ndcCoord;
+    ndcCoord.x = float(texelCoord.x) / (gl_NumWorkGroups.x * gl_WorkGroupSize.x) * 2.0 - 1.0;
+    ndcCoord.y = float(texelCoord.y) / (gl_NumWorkGroups.y * gl_WorkGroupSize.y) * 2.0 - 1.0;
+
+    uint tileIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint localIndex = gl_LocalInvocationID.y * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+
+    if (localIndex < 2) {
+        sharedIndicesBounds[localIndex] = ranges[tileIndex + localIndex];
+    }
+    if (localIndex < numLargeSplats) {
+        ivec4 rect = largeRects[localIndex];
+        ivec2 tile = ivec2(gl_WorkGroupID.xy);
+        sharedLargeTouches[localIndex] = uint(all(greaterThanEqual(tile, rect.xy)) && all(lessThanEqual(tile, rect.zw)));
+    }
+    barrier();
+
+    // every splat of the tile: the bins are in splat order, a cut off would drop arbitrary splats instead of the farthest
+    const uint begin = sharedIndicesBounds[0];
+    const uint end = sharedIndicesBounds[1];
+
+    vec4 accum = vec4(0.0);
+    float revealage = 1.0;
+
+    for (uint chunk = begin; chunk < end; chunk += uint(BATCH_SIZE)) {
+        for (uint i = localIndex; i < uint(BATCH_SIZE) && chunk + i < end; i += TILE_INVOCATIONS) {
+            ProjectedSplat splat = tileSplats[chunk + i];
+            sharedConic[i] = splat.conic.xyz;
+            sharedPosition[i] = vec3(splat.position.xy, clamp(splat.position.z * 0.5 + 0.5, 0.0, 1.0));
+            sharedColorAndOpacity[i] = splat.colorAndOpacity;
+        }
+        barrier();
+
+        uint count = min(uint(BATCH_SIZE), end - chunk);
+        for (uint i = 0; i < count; i++) {
+            accumulateSplat(ndcCoord, sharedConic[i], sharedPosition[i], sharedColorAndOpacity[i], accum, revealage);
+        }
+        barrier();
+    }
+
+    // the large splats touching the tile, in one more batch (MAX_LARGE_SPLATS is below BATCH_SIZE)
+    if (localIndex < numLargeSplats && sharedLargeTouches[localIndex] != 0u) {
+        uint slot = 0;
+        for (uint j = 0; j < localIndex; j++) slot += sharedLargeTouches[j];
+        ProjectedSplat splat = tileSplats[largeSplatsBegin + localIndex];
+        sharedConic[slot] = splat.conic.xyz;
+        sharedPosition[slot] = vec3(splat.position.xy, clamp(splat.position.z * 0.5 + 0.5, 0.0, 1.0));
+        sharedColorAndOpacity[slot] = splat.colorAndOpacity;
+    }
+    barrier();
+
+    uint numLarge = 0;
+    for (uint j = 0; j < numLargeSplats; j++) numLarge += sharedLargeTouches[j];
+    for (uint i = 0; i < numLarge; i++) {
+        accumulateSplat(ndcCoord, sharedConic[i], sharedPosition[i], sharedColorAndOpacity[i], accum, revealage);
+    }
+
+    imageStore(accumImage, texelCoord, accum);
+    imageStore(revealageImage, texelCoord, vec4(revealage));
+}
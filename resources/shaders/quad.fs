@@ -4,9 +4,15 @@ out vec4 FragColor;
 in vec2 TexCoords;
 	
 uniform sampler2D tex;
+// draws the texture with its alpha for blending over the image, e.g. the tile heatmap
+uniform bool overlay;
 	
 void main()
 {             
+    if (overlay) {
+        FragColor = texture(tex, TexCoords);
+        return;
+    }
     vec3 texCol = texture(tex, TexCoords).rgb;      
     FragColor = vec4(texCol, 1.0);
-}
\ No newline at end of file
+}
@@ -3,9 +3,12 @@ layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec2 aTexCoords;
 	
 out vec2 TexCoords;
+
+// part of the texture covered by the rendered image, smaller than 1 when rendering at a reduced resolution
+uniform vec2 texScale;
 	
 void main()
 {
-    TexCoords = aTexCoords;
+    TexCoords = aTexCoords * texScale;
     gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 430 core
+
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+#ifndef BACKGROUND_COLOR
+#define BACKGROUND_COLOR vec3(0.5)
+#endif
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+// written by process_pixels_weighted.cs
+layout(rgba32f, binding = 1) uniform readonly image2D accumImage;
+layout(r32f, binding = 2) uniform readonly image2D revealageImage;
+
+layout(rgba32f, binding = 0) uniform writeonly image2D outputImage;
+
+// weighted average color of the splats, covering 1 - revealage of the pixel in front of the background
+void main() {
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+
+    vec4 accum = imageLoad(accumImage, texelCoord);
+    float revealage = imageLoad(revealageImage, texelCoord).r;
+
+    vec3 color = accum.rgb / max(accum.a, 1e-5);
+    vec3 L = color * (1.0 - revealage) + BACKGROUND_COLOR * revealage;
+
+    imageStore(outputImage, texelCoord, vec4(L, 1.0));
+}
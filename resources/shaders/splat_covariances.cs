@@ -1,21 +1,51 @@
 #version 430 core
 
-layout (local_size_x = 1) in;
+// splats per work group, SplatRenderer injects it from the device limits
+#ifndef GROUP_SIZE
+#define GROUP_SIZE 128
+#endif
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// everything the rasterizer needs from one splat, gathered per tile by gather_tiles.cs
+struct ProjectedSplat {
+    vec4 position;        // ndc
+    vec4 conic;           // inverse of the 2D covariance (xx, xy, yy) and the splat index as float bits
+    vec4 colorAndOpacity;
+};
 
 layout(std430, binding = 0) buffer InputBuffer {
     mat4 inputCovariance[]; // this is symmetric, need only six values --> struct
 };
 
+// read back by the CPU binning, declared outside the block: GLSL allows no struct declarations inside one
+struct OutputSplat {
+    mat2 covariance;
+    vec4 position;
+    vec4 clipPos; // only for debugging
+    ivec2 topCorner;
+    ivec2 botCorner;
+    vec2 majorEigenVec;
+    vec2 minorEigenVec;
+};
+
+// only the visible splats, compacted in the order they are appended
 layout(std430, binding = 1) buffer OutputBuffer {
-    struct {
-        mat2 covariance;
-        vec4 position;
-        vec4 clipPos; // only for debugging
-        ivec2 topCorner;
-        ivec2 botCorner;
-        vec2 majorEigenVec;
-        vec2 minorEigenVec;
-    } outputData[];
+    OutputSplat outputData[];
+};
+
+layout(std430, binding = 4) buffer ColorOpacityBuffer {
+    vec4 colorAndOpacity[];
+};
+
+// compacted like outputData, entry i of both belongs to the same splat
+layout(std430, binding = 5) buffer ProjectedBuffer {
+    ProjectedSplat projected[];
+};
+
+// number of entries appended to outputData and projected, cleared before the dispatch
+layout(std430, binding = 7) buffer VisibleCountBuffer {
+    uint visibleCount;
 };
 
 uniform float near; // optimization: specify locations
@@ -28,11 +58,33 @@ uniform float screenRightCoord;
 
 uniform float screenTopCoord; 
 
+// number of 16 x 16 pixel tiles on the screen, 50 x 50 at full resolution
+uniform ivec2 tileGrid;
+
+// splats are drawn only where their alpha reaches this, see process_pixels.cs
+uniform float alphaCutoff;
+
+// the last work group is only partly used
+uniform uint numSplats;
+
 void main() {
     const uint index = gl_GlobalInvocationID.x;
+    if (index >= numSplats) return;
+
+    // the peak alpha of a splat is its opacity, one that can not reach the alpha cutoff anywhere is never drawn
+    vec4 color = colorAndOpacity[index];
+    float opacity = color.w;
+    if (opacity < alphaCutoff) return;
+
     mat3 cov = mat3(inputCovariance[index]);
     vec3 worldPos = vec3(inputCovariance[index][3]);
-    
+
+    // transform to clipspace
+    vec4 clipPos = mvp * vec4(worldPos, 1.0);
+
+    // frustum culling (but only for z)
+    if (abs(clipPos.z) > clipPos.w) return;
+
     // transform to viewspace 
     vec4 viewPos = view * vec4(worldPos, 1.0);
 
@@ -53,32 +105,9 @@ void main() {
 
     mat2 splatCovariance = mat2(JW * cov * transpose(JW));
 
-
-    // store 2D covariance matrix
-    outputData[index].covariance = splatCovariance;
-
-    // transform to clipspace
-    vec4 clipPos = mvp * vec4(worldPos, 1.0);
-
-    //degub
-    outputData[index].clipPos = clipPos;
-
-    // frustum culling (but only for z)
-    if (abs(clipPos.z) > clipPos.w) {
-        // debug
-        outputData[index].position = vec4(0.0); 
-        // needed for checking if a point is valid
-        outputData[index].topCorner = ivec2(-1); 
-        return;
-    }
-
     // perspective division, clip --> ndc
     vec4 ndcPos = clipPos / clipPos.w;
 
-    // store ndc pos
-    outputData[index].position = ndcPos;
-
-
     // compute the length of the greater eigen value to determine axis size
     float var_x = splatCovariance[0][0];
     float var_y = splatCovariance[1][1];
@@ -89,54 +118,55 @@ void main() {
     float greaterEig = ((var_x + var_y) + sqrt(varxMinusVary * varxMinusVary + 4*cov_xy*cov_xy)) * 0.5;
     float lesserEig = ((var_x + var_y) - sqrt(varxMinusVary * varxMinusVary + 4*cov_xy*cov_xy)) * 0.5;
 
-    vec2 majorEigenVec = normalize(vec2(-cov_xy, var_x - greaterEig));
-    vec2 minorEigenVec = normalize(vec2(-cov_xy, var_x - lesserEig));
-
-    // axis length of the 99% mass contour
-    float majorAxisLength = 3.034798181 * sqrt(greaterEig);
-    float minorAxisLength = 3.034798181 * sqrt(lesserEig);
-
-    majorEigenVec = majorEigenVec * majorAxisLength;
-    minorEigenVec = minorEigenVec * minorAxisLength;
+    // axis length of the 99% mass contour, or of the contour where the alpha drops below
+    // the cutoff if that is smaller: opacity * exp(-0.5 * r^2) = alphaCutoff
+    float contourRadius = min(3.034798181, sqrt(2.0 * log(opacity / alphaCutoff)));
+    float majorAxisLength = contourRadius * sqrt(greaterEig);
+    float minorAxisLength = contourRadius * sqrt(lesserEig);
 
     // find the bounding box corner points (in ndc) for tile overlap detection
     vec2 topCornerPos = vec2(ndcPos.x + majorAxisLength, ndcPos.y + majorAxisLength); 
     vec2 botCornerPos = vec2(ndcPos.x - majorAxisLength, ndcPos.y - majorAxisLength); 
 
-
     // find the bounding box corner tile indices
-    ivec2 topCornerBlock = ivec2((topCornerPos * 400 + 400) / 16); // expects screen size 800 and block size 16
-    ivec2 botCornerBlock = ivec2((botCornerPos * 400 + 400) / 16);
-
-    // debugging values
-
-    outputData[index].majorEigenVec =  majorEigenVec;
-    outputData[index].minorEigenVec =  minorEigenVec;
-
+    ivec2 topCornerBlock = ivec2((topCornerPos * 0.5 + 0.5) * vec2(tileGrid));
+    ivec2 botCornerBlock = ivec2((botCornerPos * 0.5 + 0.5) * vec2(tileGrid));
 
     if (
-        // hardcoded
         // check if gaussian completely outside the screen
-        topCornerBlock.x < 0 && botCornerBlock.x < 0 ||   // outside left boundary
-        topCornerBlock.y < 0 && botCornerBlock.y < 0 ||   // outside bottom boundary
-        topCornerBlock.x > 49 && botCornerBlock.x > 49 || // outside right boundary
-        topCornerBlock.y > 49 && botCornerBlock.y > 49    // outside top boundary
+        topCornerBlock.x < 0 && botCornerBlock.x < 0 ||                           // outside left boundary
+        topCornerBlock.y < 0 && botCornerBlock.y < 0 ||                           // outside bottom boundary
+        topCornerBlock.x >= tileGrid.x && botCornerBlock.x >= tileGrid.x ||       // outside right boundary
+        topCornerBlock.y >= tileGrid.y && botCornerBlock.y >= tileGrid.y          // outside top boundary
     ) 
     {
-        topCornerBlock = ivec2(-1);
-        
-    } else {
-
-        // clamp to tiles on the screen
-        topCornerBlock = clamp(topCornerBlock, 0, 49);
-        botCornerBlock = clamp(botCornerBlock, 0, 49);
-        
+        return;
     }
 
-    // store bounding box corner tile indices
-    outputData[index].topCorner = topCornerBlock; 
-    outputData[index].botCorner = botCornerBlock; 
+    // clamp to tiles on the screen
+    topCornerBlock = clamp(topCornerBlock, ivec2(0), tileGrid - 1);
+    botCornerBlock = clamp(botCornerBlock, ivec2(0), tileGrid - 1);
+
+    // visible, append to the compacted lists
+    const uint slot = atomicAdd(visibleCount, 1);
 
+    outputData[slot].covariance = splatCovariance;
+    outputData[slot].position = ndcPos;
+    outputData[slot].clipPos = clipPos; // debug
 
+    // debugging values
+    vec2 majorEigenVec = normalize(vec2(-cov_xy, var_x - greaterEig));
+    vec2 minorEigenVec = normalize(vec2(-cov_xy, var_x - lesserEig));
+    outputData[slot].majorEigenVec = majorEigenVec * majorAxisLength;
+    outputData[slot].minorEigenVec = minorEigenVec * minorAxisLength;
 
-}
\ No newline at end of file
+    // store bounding box corner tile indices
+    outputData[slot].topCorner = topCornerBlock; 
+    outputData[slot].botCorner = botCornerBlock; 
+
+    // invert the covariance once per splat instead of once per tile it touches
+    mat2 invCov = inverse(splatCovariance);
+    projected[slot].position = ndcPos;
+    projected[slot].conic = vec4(invCov[0][0], invCov[0][1], invCov[1][1], uintBitsToFloat(index));
+    projected[slot].colorAndOpacity = color;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+
+// Linear allocator for data that only lives for one frame.
+// Allocations bump a pointer inside one block and are never freed individually; reset() makes the whole
+// block reusable. If a frame needs more than the block holds, overflow blocks are taken from the heap and
+// on the next reset() the block is regrown to the high-water mark, so steady-state frames do not touch the heap.
+class FrameArena {
+public:
+    FrameArena(size_t initialBytes = 1 << 20) {
+        grow(initialBytes);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        allocationCount++;
+
+        size_t offset = (used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= capacity) {
+            used = offset + bytes;
+            highWater = std::max(highWater, used + overflowBytes);
+            return block.get() + offset;
+        }
+
+        // does not fit, keep it alive until the next reset in a separate block
+        heapAllocationCount++;
+        overflowBytes += bytes + alignment;
+        highWater = std::max(highWater, used + overflowBytes);
+        overflow.emplace_back(new uint8_t[bytes + alignment]);
+        uintptr_t address = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void*>((address + alignment - 1) & ~(alignment - 1));
+    }
+
+    template<typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // everything allocated since the last reset becomes invalid
+    void reset() {
+        allocationCount = 0;
+        heapAllocationCount = 0;
+        if (!overflow.empty()) {
+            overflow.clear();
+            grow(highWater + highWater / 4);
+        }
+        used = 0;
+        overflowBytes = 0;
+    }
+
+    size_t usedBytes() const { return used + overflowBytes; }
+    size_t capacityBytes() const { return capacity; }
+    size_t highWaterBytes() const { return highWater; }
+    // allocations served since the last reset, and how many of them had to go to the heap
+    uint32_t allocations() const { return allocationCount; }
+    uint32_t heapAllocations() const { return heapAllocationCount; }
+
+private:
+    std::unique_ptr<uint8_t[]> block;
+    std::vector<std::unique_ptr<uint8_t[]>> overflow;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t overflowBytes = 0;
+    size_t highWater = 0;
+    uint32_t allocationCount = 0;
+    uint32_t heapAllocationCount = 0;
+
+    void grow(size_t bytes) {
+        block.reset(new uint8_t[bytes]);
+        capacity = bytes;
+        heapAllocationCount++;
+    }
+};
+
+// Allocator adaptor so that standard containers can live in a FrameArena. Deallocation is a no-op,
+// containers should reserve their final size up front since every regrowth leaves the old storage behind.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocate<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    FrameArena* arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// Two arenas used on alternate frames, so the data of the previous frame stays valid while the
+// next one is built (e.g. when its uploads are still in flight).
+class FrameAllocator {
+public:
+    FrameAllocator(size_t initialBytes = 1 << 20) : arenas{FrameArena(initialBytes), FrameArena(initialBytes)} {}
+
+    // call once at the start of every frame
+    void beginFrame() {
+        // counters of the frame that just ended
+        lastAllocations = arenas[frameIndex].allocations();
+        lastHeapAllocations = arenas[frameIndex].heapAllocations();
+
+        frameIndex ^= 1;
+        arenas[frameIndex].reset();
+    }
+
+    FrameArena& current() { return arenas[frameIndex]; }
+
+    template<typename T>
+    FrameVector<T> vector() { return FrameVector<T>(ArenaAllocator<T>(current())); }
+
+    uint32_t allocationsLastFrame() const { return lastAllocations; }
+    uint32_t heapAllocationsLastFrame() const { return lastHeapAllocations; }
+    size_t highWaterBytes() const { return std::max(arenas[0].highWaterBytes(), arenas[1].highWaterBytes()); }
+
+private:
+    FrameArena arenas[2];
+    uint32_t frameIndex = 0;
+    uint32_t lastAllocations = 0;
+    uint32_t lastHeapAllocations = 0;
+};
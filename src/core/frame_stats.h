@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <cstddef>
+
+// Distribution of the frame times of a run, in milliseconds
+struct FrameTimeSummary {
+    size_t frames = 0;
+    float mean = 0.0f;
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+    float p99 = 0.0f;
+    float max = 0.0f;
+};
+
+// nearest-rank percentiles
+inline FrameTimeSummary summarizeFrameTimes(std::vector<float> frameTimes) {
+    FrameTimeSummary summary;
+    if (frameTimes.empty()) return summary;
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    auto percentile = [&frameTimes](float p) {
+        size_t rank = static_cast<size_t>(p / 100.0f * frameTimes.size() + 0.999f);
+        return frameTimes[std::min(frameTimes.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+
+    summary.frames = frameTimes.size();
+    summary.mean = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+    summary.p50 = percentile(50.0f);
+    summary.p95 = percentile(95.0f);
+    summary.p99 = percentile(99.0f);
+    summary.max = frameTimes.back();
+    return summary;
+}
+
+inline void printFrameTimeSummary(const FrameTimeSummary& summary, std::ostream& out = std::cout) {
+    out << "Frames: " << summary.frames << std::endl;
+    out << "Frame time (ms) mean " << summary.mean
+        << "  p50 " << summary.p50
+        << "  p95 " << summary.p95
+        << "  p99 " << summary.p99
+        << "  max " << summary.max << std::endl;
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+class JobSystem;
+
+// A unit of work submitted to the JobSystem. It runs once all the jobs it depends on have finished.
+class Job {
+public:
+    bool done() const { return finished.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+
+    std::function<void()> work;
+    bool background = false;
+    // unfinished dependencies, plus one until submit() has registered all of them
+    std::atomic<int> pending{1};
+    std::atomic<bool> finished{false};
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Job>> continuations;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work counters of one worker thread, or of the threads outside the system (the last entry of JobSystem::stats())
+struct WorkerStats {
+    uint64_t jobs = 0;
+    uint64_t steals = 0;     // jobs taken from another thread's deque
+    double busySeconds = 0.0;
+    double utilization = 0.0; // share of the time since resetStats() spent running jobs
+};
+
+// Work-stealing job system shared by the loading, binning and CPU rendering code.
+// Every worker owns a deque: it pushes and pops its own jobs at the back and steals from the front of the others.
+// Threads outside the system (the render thread) submit into one more deque that the workers steal from.
+// wait() runs jobs while it waits, so a job can submit and wait for jobs of its own and the waiting thread
+// contributes to the work instead of blocking.
+//
+// Jobs may depend on other jobs, which makes the stages of a frame a graph. Background jobs (submitBackground())
+// are long running tasks like loading a model; only idle workers pick them up, never a thread waiting in wait(),
+// so that a frame never ends up running a whole model load.
+//
+// With zero workers the system runs in a deterministic single thread mode: every job runs on the thread that
+// submits it (or finishes its last dependency), in submission order, which makes runs reproducible for debugging.
+class JobSystem {
+public:
+    // numWorkers threads besides the threads that submit and wait, 0 = deterministic single thread mode
+    explicit JobSystem(unsigned int numWorkers) :
+        deques(numWorkers + 1),
+        counters(numWorkers + 1),
+        statsStart(Clock::now())
+    {
+        for (unsigned int w = 0; w < numWorkers; w++) {
+            workers.emplace_back([this, w]() { workerLoop(w); });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // the instance used by all subsystems, created on first use
+    static JobSystem& global() {
+        static JobSystem instance(globalWorkerCount() < 0 ? defaultWorkerCount() : static_cast<unsigned int>(globalWorkerCount()));
+        return instance;
+    }
+
+    // sets the workers of global() before its first use: -1 = one per core besides the render thread,
+    // 0 = deterministic single thread mode
+    static void configureGlobal(int numWorkers) {
+        globalWorkerCount() = numWorkers;
+    }
+
+    static unsigned int defaultWorkerCount() {
+        return std::max(1u, std::thread::hardware_concurrency()) - (std::thread::hardware_concurrency() > 1 ? 1 : 0);
+    }
+
+    bool singleThreaded() const { return workers.empty(); }
+
+    // threads that can run jobs at the same time, the workers and one waiting thread
+    unsigned int concurrency() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies = {}) {
+        return add(std::move(work), dependencies, false);
+    }
+
+    // a long running job that only idle workers run, see the class comment
+    JobHandle submitBackground(std::function<void()> work, const std::vector<JobHandle>& dependencies = {}) {
+        return add(std::move(work), dependencies, true);
+    }
+
+    // runs other jobs until job has finished
+    void wait(const JobHandle& job) {
+        if (!job) return;
+        const int slot = currentSlot();
+
+        while (!job->done()) {
+            // in single thread mode every job runs when it becomes ready, one that is not done never will be
+            if (singleThreaded()) return;
+
+            if (JobHandle other = findJob(slot, false)) {
+                execute(other, slot);
+                continue;
+            }
+
+            const Clock::time_point idleStart = Clock::now();
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleepCondition.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+                    return job->done() || queuedJobs.load(std::memory_order_acquire) > 0;
+                });
+            }
+            // waiting inside a job is not work
+            if (jobDepth() > 0) counters[slot].idleNanos += nanoseconds(idleStart);
+        }
+    }
+
+    void wait(const std::vector<JobHandle>& jobs) {
+        for (const JobHandle& job : jobs) wait(job);
+    }
+
+    // body(chunkBegin, chunkEnd) for the chunks of [begin, end) of grain elements, the last one may be shorter.
+    // The chunks only depend on grain, not on the number of threads. The calling thread runs the first chunk.
+    template<typename Body>
+    void parallelFor(size_t begin, size_t end, size_t grain, Body&& body) {
+        if (end <= begin) return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t numChunks = (end - begin + grain - 1) / grain;
+
+        if (numChunks == 1 || singleThreaded()) {
+            for (size_t b = begin; b < end; b += grain) body(b, std::min(end, b + grain));
+            return;
+        }
+
+        std::vector<JobHandle> jobs;
+        jobs.reserve(numChunks - 1);
+        for (size_t c = 1; c < numChunks; c++) {
+            const size_t b = begin + c * grain;
+            const size_t e = std::min(end, b + grain);
+            jobs.push_back(submit([&body, b, e]() { body(b, e); }));
+        }
+        body(begin, std::min(end, begin + grain));
+        wait(jobs);
+    }
+
+    // body(chunk) for chunk in [0, numChunks), for work that is already split, e.g. with one buffer per chunk
+    template<typename Body>
+    void parallelChunks(size_t numChunks, Body&& body) {
+        parallelFor(0, numChunks, 1, [&body](size_t chunk, size_t) { body(chunk); });
+    }
+
+    // map(chunkBegin, chunkEnd) for the chunks of [begin, end), combined in chunk order, so the result is the
+    // same for any number of threads as long as grain is the same
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, Map&& map, Combine&& combine) {
+        if (end <= begin) return identity;
+        grain = std::max<size_t>(grain, 1);
+        const size_t numChunks = (end - begin + grain - 1) / grain;
+
+        std::vector<T> partial(numChunks, identity);
+        parallelChunks(numChunks, [&](size_t c) {
+            const size_t b = begin + c * grain;
+            partial[c] = map(b, std::min(end, b + grain));
+        });
+
+        T result = identity;
+        for (const T& value : partial) result = combine(result, value);
+        return result;
+    }
+
+    // exclusive prefix sum of values in place, returns the total: the chunk sums are computed in parallel,
+    // scanned on the calling thread, and added back in parallel
+    template<typename T>
+    T exclusiveScan(T* values, size_t count, size_t grain) {
+        if (count == 0) return T(0);
+        grain = std::max<size_t>(grain, 1);
+        const size_t numChunks = (count + grain - 1) / grain;
+
+        std::vector<T> offsets(numChunks, T(0));
+        parallelChunks(numChunks, [&](size_t c) {
+            T sum = T(0);
+            for (size_t i = c * grain; i < std::min(count, (c + 1) * grain); i++) sum += values[i];
+            offsets[c] = sum;
+        });
+
+        T total = T(0);
+        for (T& offset : offsets) {
+            T sum = offset;
+            offset = total;
+            total += sum;
+        }
+
+        parallelChunks(numChunks, [&](size_t c) {
+            T running = offsets[c];
+            for (size_t i = c * grain; i < std::min(count, (c + 1) * grain); i++) {
+                T value = values[i];
+                values[i] = running;
+                running += value;
+            }
+        });
+        return total;
+    }
+
+    // one entry per worker, then one for the threads outside the system
+    std::vector<WorkerStats> stats() const {
+        const double seconds = std::max(1e-9, std::chrono::duration<double>(Clock::now() - statsStart).count());
+        std::vector<WorkerStats> result(counters.size());
+        for (size_t i = 0; i < counters.size(); i++) {
+            const Counters& c = counters[i];
+            result[i].jobs = c.jobs.load();
+            result[i].steals = c.steals.load();
+            const int64_t busy = std::max<int64_t>(0, static_cast<int64_t>(c.busyNanos.load()) - static_cast<int64_t>(c.idleNanos.load()));
+            result[i].busySeconds = busy / 1e9;
+            result[i].utilization = result[i].busySeconds / seconds;
+        }
+        return result;
+    }
+
+    void resetStats() {
+        for (Counters& c : counters) {
+            c.jobs = 0;
+            c.steals = 0;
+            c.busyNanos = 0;
+            c.idleNanos = 0;
+        }
+        statsStart = Clock::now();
+    }
+
+    // one line per worker: jobs run, jobs stolen, busy time and utilization since resetStats()
+    void printStats(std::ostream& out = std::cout) const {
+        std::vector<WorkerStats> all = stats();
+        out << "Job system, " << workers.size() << (singleThreaded() ? " workers (single thread mode)" : " workers") << std::endl;
+        for (size_t i = 0; i < all.size(); i++) {
+            out << (i + 1 < all.size() ? "  worker " + std::to_string(i) : std::string("  callers ")) << std::fixed << std::setprecision(1)
+                << std::setw(10) << all[i].jobs << " jobs" << std::setw(8) << all[i].steals << " stolen"
+                << std::setw(10) << all[i].busySeconds * 1000.0 << " ms busy" << std::setw(7) << all[i].utilization * 100.0 << "%" << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Deque {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    struct Counters {
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNanos{0};
+        std::atomic<uint64_t> idleNanos{0};
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<Deque> deques; // one per worker, the last one for the threads outside the system
+    std::vector<Counters> counters;
+    Clock::time_point statsStart;
+
+    std::mutex backgroundMutex;
+    std::deque<JobHandle> backgroundJobs;
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<int> queuedJobs{0};
+    std::atomic<int> queuedBackgroundJobs{0};
+    bool stopping = false;
+
+    static int& globalWorkerCount() {
+        static int numWorkers = -1;
+        return numWorkers;
+    }
+
+    // the worker index of this thread, -1 outside the system
+    static int& workerIndex() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    // nesting of jobs on this thread, a job that waits runs other jobs inside of it
+    static int& jobDepth() {
+        thread_local int depth = 0;
+        return depth;
+    }
+
+    int currentSlot() const {
+        const int index = workerIndex();
+        return index >= 0 ? index : static_cast<int>(deques.size()) - 1;
+    }
+
+    static uint64_t nanoseconds(Clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    JobHandle add(std::function<void()> work, const std::vector<JobHandle>& dependencies, bool background) {
+        JobHandle job = std::make_shared<Job>();
+        job->work = std::move(work);
+        job->background = background;
+
+        for (const JobHandle& dependency : dependencies) {
+            if (!dependency) continue;
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if (dependency->done()) continue;
+            job->pending.fetch_add(1, std::memory_order_relaxed);
+            dependency->continuations.push_back(job);
+        }
+
+        if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(job);
+        return job;
+    }
+
+    void enqueue(const JobHandle& job) {
+        if (singleThreaded()) {
+            execute(job, 0);
+            return;
+        }
+
+        if (job->background) {
+            std::lock_guard<std::mutex> lock(backgroundMutex);
+            backgroundJobs.push_back(job);
+            queuedBackgroundJobs.fetch_add(1, std::memory_order_release);
+        } else {
+            Deque& deque = deques[currentSlot()];
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            deque.jobs.push_back(job);
+            queuedJobs.fetch_add(1, std::memory_order_release);
+        }
+
+        // taking the lock orders the push before a sleeping thread checks its predicate
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        sleepCondition.notify_one();
+    }
+
+    // the newest job of the own deque, the oldest of another one, and a background job only if allowed
+    JobHandle findJob(int slot, bool allowBackground) {
+        if (queuedJobs.load(std::memory_order_acquire) > 0) {
+            {
+                Deque& own = deques[slot];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.jobs.empty()) {
+                    JobHandle job = std::move(own.jobs.back());
+                    own.jobs.pop_back();
+                    queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+                    return job;
+                }
+            }
+            for (size_t k = 1; k < deques.size(); k++) {
+                Deque& victim = deques[(slot + k) % deques.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.jobs.empty()) {
+                    JobHandle job = std::move(victim.jobs.front());
+                    victim.jobs.pop_front();
+                    queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+                    counters[slot].steals++;
+                    return job;
+                }
+            }
+        }
+
+        if (allowBackground && queuedBackgroundJobs.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(backgroundMutex);
+            if (!backgroundJobs.empty()) {
+                JobHandle job = std::move(backgroundJobs.front());
+                backgroundJobs.pop_front();
+                queuedBackgroundJobs.fetch_sub(1, std::memory_order_acq_rel);
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void execute(const JobHandle& job, int slot) {
+        const Clock::time_point start = Clock::now();
+        jobDepth()++;
+        job->work();
+        job->work = nullptr; // releases what the job captured
+        jobDepth()--;
+        if (jobDepth() == 0) counters[slot].busyNanos += nanoseconds(start);
+        counters[slot].jobs++;
+
+        // the jobs waiting for this one
+        std::vector<JobHandle> continuations;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.store(true, std::memory_order_release);
+            continuations.swap(job->continuations);
+        }
+        for (const JobHandle& continuation : continuations) {
+            if (continuation->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(continuation);
+        }
+
+        if (!singleThreaded()) {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            sleepCondition.notify_all();
+        }
+    }
+
+    void workerLoop(unsigned int index) {
+        workerIndex() = static_cast<int>(index);
+        while (true) {
+            if (JobHandle job = findJob(static_cast<int>(index), true)) {
+                execute(job, static_cast<int>(index));
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this]() {
+                return stopping || queuedJobs.load(std::memory_order_acquire) > 0 || queuedBackgroundJobs.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping && queuedJobs.load() == 0 && queuedBackgroundJobs.load() == 0) return;
+        }
+    }
+};
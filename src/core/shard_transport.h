@@ -0,0 +1,262 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Messages between the processes of a sharded render, see sharded_renderer.h.
+// An address is unix:/path for processes on the same host or tcp:host:port for other hosts; a listener binds
+// tcp:port to all interfaces. Both transports carry the same framed messages, so everything that runs over
+// a unix socket locally runs unchanged over tcp.
+// A message is a type and a payload, usually POD structs in host byte order: all processes have to run on the
+// same architecture.
+struct ShardAddress {
+    bool tcp = false;
+    std::string path; // unix
+    std::string host; // tcp, empty to listen on all interfaces
+    std::string port;
+
+    static bool parse(const std::string& address, ShardAddress& parsed) {
+        if (address.rfind("unix:", 0) == 0 && address.size() > 5) {
+            parsed.tcp = false;
+            parsed.path = address.substr(5);
+            return parsed.path.size() < sizeof(sockaddr_un::sun_path);
+        }
+        if (address.rfind("tcp:", 0) == 0) {
+            const std::string rest = address.substr(4);
+            const size_t colon = rest.rfind(':');
+            parsed.tcp = true;
+            parsed.host = colon == std::string::npos ? "" : rest.substr(0, colon);
+            parsed.port = colon == std::string::npos ? rest : rest.substr(colon + 1);
+            return !parsed.port.empty();
+        }
+        return false;
+    }
+};
+
+struct ShardMessageHeader {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+// one connection, owns the socket
+class ShardChannel {
+public:
+    explicit ShardChannel(int fd = -1) : fd(fd) {}
+
+    ~ShardChannel() {
+        if (fd >= 0) close(fd);
+    }
+
+    ShardChannel(ShardChannel&& other) noexcept : fd(other.fd) { other.fd = -1; }
+    ShardChannel& operator=(ShardChannel&& other) noexcept {
+        if (this != &other) {
+            if (fd >= 0) close(fd);
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+    ShardChannel(const ShardChannel&) = delete;
+    ShardChannel& operator=(const ShardChannel&) = delete;
+
+    bool valid() const { return fd >= 0; }
+    int descriptor() const { return fd; }
+
+    // the payload is payload followed by extra, so that a header struct and a large block go out without a copy
+    bool send(uint32_t type, const void* payload, size_t size, const void* extra = nullptr, size_t extraSize = 0) {
+        ShardMessageHeader header = {type, 0, static_cast<uint64_t>(size + extraSize)};
+        return writeAll(&header, sizeof(header)) && writeAll(payload, size) && writeAll(extra, extraSize);
+    }
+
+    // blocks until a whole message arrived, false when the connection closed or failed. The size comes from the
+    // peer, a payload larger than maxSize is refused before anything is allocated for it
+    bool receive(uint32_t& type, std::vector<uint8_t>& payload, size_t maxSize) {
+        ShardMessageHeader header;
+        if (!readAll(&header, sizeof(header))) return false;
+        type = header.type;
+        if (header.size > maxSize) {
+            std::cerr << "Refused a message of " << header.size << " bytes, at most " << maxSize << " are expected" << std::endl;
+            return false;
+        }
+        payload.resize(static_cast<size_t>(header.size));
+        return readAll(payload.data(), payload.size());
+    }
+
+    // retries until the listener is up or timeoutSeconds passed
+    static ShardChannel connect(const std::string& address, float timeoutSeconds) {
+        ShardAddress parsed;
+        if (!ShardAddress::parse(address, parsed)) {
+            std::cerr << "Invalid shard address " << address << ", expected unix:/path or tcp:host:port" << std::endl;
+            return ShardChannel();
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<float>(timeoutSeconds);
+        while (true) {
+            ShardChannel channel(parsed.tcp ? connectTcp(parsed) : connectUnix(parsed));
+            if (channel.valid()) return channel;
+            if (std::chrono::steady_clock::now() > deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::cerr << "Could not connect to " << address << std::endl;
+        return ShardChannel();
+    }
+
+private:
+    int fd;
+
+    bool writeAll(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            // no SIGPIPE when the other side is gone, the caller sees the error
+            const ssize_t written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            const ssize_t received = ::recv(fd, bytes, size, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    static int connectUnix(const ShardAddress& address) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.path.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static int connectTcp(const ShardAddress& address) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(address.host.empty() ? "localhost" : address.host.c_str(), address.port.c_str(), &hints, &result) != 0) return -1;
+
+        int fd = -1;
+        for (addrinfo* info = result; info; info = info->ai_next) {
+            fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            if (fd < 0) continue;
+            if (::connect(fd, info->ai_addr, info->ai_addrlen) == 0) break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+
+        // tasks are small and latency bound
+        if (fd >= 0) {
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+    }
+};
+
+// accepts the connections of the workers
+class ShardListener {
+public:
+    ~ShardListener() {
+        if (fd >= 0) close(fd);
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+    }
+
+    bool open(const std::string& address) {
+        ShardAddress parsed;
+        if (!ShardAddress::parse(address, parsed)) {
+            std::cerr << "Invalid shard address " << address << ", expected unix:/path or tcp:[host:]port" << std::endl;
+            return false;
+        }
+
+        if (parsed.tcp) {
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+            addrinfo* result = nullptr;
+            if (getaddrinfo(parsed.host.empty() ? nullptr : parsed.host.c_str(), parsed.port.c_str(), &hints, &result) != 0) {
+                std::cerr << "Could not resolve " << address << std::endl;
+                return false;
+            }
+            for (addrinfo* info = result; info && fd < 0; info = info->ai_next) {
+                fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+                if (fd < 0) continue;
+                const int one = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                if (bind(fd, info->ai_addr, info->ai_addrlen) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(result);
+        } else {
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd >= 0) {
+                sockaddr_un addr = {};
+                addr.sun_family = AF_UNIX;
+                std::strncpy(addr.sun_path, parsed.path.c_str(), sizeof(addr.sun_path) - 1);
+                // a socket file left behind by a crashed run
+                unlink(parsed.path.c_str());
+                if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0) {
+                    unixPath = parsed.path;
+                } else {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+        }
+
+        if (fd < 0 || listen(fd, 64) != 0) {
+            std::cerr << "Could not listen on " << address << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // the next worker, an invalid channel if none connected within timeoutMs
+    ShardChannel accept(int timeoutMs) {
+        pollfd request = {fd, POLLIN, 0};
+        if (poll(&request, 1, timeoutMs) <= 0) return ShardChannel();
+
+        const int connection = ::accept(fd, nullptr, nullptr);
+        if (connection >= 0) {
+            const int one = 1;
+            setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return ShardChannel(connection);
+    }
+
+private:
+    int fd = -1;
+    std::string unixPath;
+};
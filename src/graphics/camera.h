@@ -131,6 +131,14 @@ public:
         updateCameraVectors();
     }
 
+    // sets the orientation directly, e.g. when replaying a recorded camera path
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "graphics/camera.h"
+
+// Everything that defines the rendered view of a Camera
+struct CameraState {
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float fov;
+
+    static CameraState capture(const Camera& camera) {
+        return CameraState{camera.Position, camera.Yaw, camera.Pitch, camera.Fov};
+    }
+
+    void apply(Camera& camera) const {
+        camera.Position = position;
+        camera.Fov = fov;
+        camera.SetOrientation(yaw, pitch);
+    }
+};
+
+struct CameraKeyframe {
+    float time; // seconds since the start of the recording
+    CameraState state;
+};
+
+// A recorded camera trajectory.
+// Stored as a text file, one keyframe per line: "time x y z yaw pitch fov", lines starting with # are ignored.
+// Replays sample it at fixed timesteps, so every run renders exactly the same views no matter how fast the frames are.
+class CameraPath {
+public:
+    std::vector<CameraKeyframe> keyframes;
+
+    void record(float time, const Camera& camera) {
+        keyframes.push_back(CameraKeyframe{time, CameraState::capture(camera)});
+    }
+
+    bool empty() const { return keyframes.empty(); }
+    float duration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+    // number of frames a replay with the given timestep renders, the last keyframe included
+    uint32_t frameCount(float timestep) const {
+        if (keyframes.empty()) return 0;
+        return static_cast<uint32_t>(duration() / timestep + 1e-4f) + 1;
+    }
+
+    // linear interpolation between the two keyframes around time, clamped to the ends of the path
+    CameraState sample(float time) const {
+        if (time <= keyframes.front().time) return keyframes.front().state;
+        if (time >= keyframes.back().time) return keyframes.back().state;
+
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+            [](float t, const CameraKeyframe& keyframe) { return t < keyframe.time; });
+        const CameraKeyframe& b = *next;
+        const CameraKeyframe& a = *(next - 1);
+
+        float span = b.time - a.time;
+        float f = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+        return CameraState{
+            glm::mix(a.state.position, b.state.position, f),
+            glm::mix(a.state.yaw, b.state.yaw, f),
+            glm::mix(a.state.pitch, b.state.pitch, f),
+            glm::mix(a.state.fov, b.state.fov, f)
+        };
+    }
+
+    bool save(const std::string& file) const {
+        std::ofstream out(file);
+        if (!out) {
+            std::cerr << "Could not write camera path " << file << std::endl;
+            return false;
+        }
+
+        out << "# time x y z yaw pitch fov" << std::endl;
+        out.precision(9);
+        for (const CameraKeyframe& keyframe : keyframes) {
+            const CameraState& s = keyframe.state;
+            out << keyframe.time << " " << s.position.x << " " << s.position.y << " " << s.position.z << " "
+                << s.yaw << " " << s.pitch << " " << s.fov << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& file) {
+        std::ifstream in(file);
+        if (!in) {
+            std::cerr << "Could not open camera path " << file << std::endl;
+            return false;
+        }
+
+        keyframes.clear();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#') continue;
+
+            std::istringstream fields(line);
+            CameraKeyframe keyframe;
+            CameraState& s = keyframe.state;
+            if (!(fields >> keyframe.time >> s.position.x >> s.position.y >> s.position.z >> s.yaw >> s.pitch >> s.fov)) {
+                std::cerr << file << ":" << lineNumber << ": expected 'time x y z yaw pitch fov'" << std::endl;
+                return false;
+            }
+            if (!keyframes.empty() && keyframe.time < keyframes.back().time) {
+                std::cerr << file << ":" << lineNumber << ": keyframe times must not decrease" << std::endl;
+                return false;
+            }
+            keyframes.push_back(keyframe);
+        }
+
+        if (keyframes.empty()) {
+            std::cerr << "Camera path " << file << " has no keyframes" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+
+#include "rendering/splat_renderer.h"
+
+// One view of the cameras.json written by the 3DGS training code: pinhole intrinsics and the camera to world pose
+// in the COLMAP convention (x right, y down, looking along +z)
+struct DatasetCamera {
+    int id;
+    std::string imageName;
+    int width;
+    int height;
+    glm::vec3 position; // camera center in world space
+    glm::mat3 rotation; // camera to world
+    float fx;
+    float fy;
+
+    // tiles rendered for this view, the longer side gets all NUM_TILES_X tiles and the other one keeps the aspect ratio
+    TileGrid tileGrid() const {
+        TileGrid grid;
+        if (width >= height) {
+            grid.x = NUM_TILES_X;
+            grid.y = std::max(1u, static_cast<uint32_t>(std::lround(NUM_TILES_Y * static_cast<float>(height) / width)));
+        } else {
+            grid.x = std::max(1u, static_cast<uint32_t>(std::lround(NUM_TILES_X * static_cast<float>(width) / height)));
+            grid.y = NUM_TILES_Y;
+        }
+        return grid;
+    }
+
+    // flipY has to match the flipY the model was loaded with, it mirrors the scene along y
+    SplatView splatView(bool flipY, float near = 0.01f, float far = 100.0f) const {
+        // world to camera, then COLMAP camera axes to OpenGL camera axes (y up, looking along -z)
+        glm::mat3 worldToCamera = glm::transpose(rotation);
+        glm::vec3 center = position;
+        if (flipY) {
+            const glm::mat3 mirror(1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+            worldToCamera = worldToCamera * mirror;
+            center = mirror * center;
+        }
+        const glm::mat3 toOpenGL(1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+        const glm::mat3 rotationPart = toOpenGL * worldToCamera;
+
+        SplatView splatView;
+        splatView.view = glm::mat4(rotationPart);
+        splatView.view[3] = glm::vec4(-(rotationPart * center), 1.0f);
+
+        // principal point in the image center
+        const float tanHalfFovX = 0.5f * width / fx;
+        const float tanHalfFovY = 0.5f * height / fy;
+
+        glm::mat4 projection(0.0f);
+        projection[0][0] = 1.0f / tanHalfFovX;
+        projection[1][1] = 1.0f / tanHalfFovY;
+        projection[2][2] = -(far + near) / (far - near);
+        projection[2][3] = -1.0f;
+        projection[3][2] = -2.0f * far * near / (far - near);
+        splatView.projection = projection;
+
+        splatView.near = near;
+        splatView.screenRight = tanHalfFovX * near;
+        splatView.screenTop = tanHalfFovY * near;
+        return splatView;
+    }
+};
+
+inline bool loadDatasetCameras(const std::string& file, std::vector<DatasetCamera>& cameras) {
+    std::ifstream in(file);
+    if (!in) {
+        std::cerr << "Could not open " << file << std::endl;
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(in, nullptr, false);
+    if (json.is_discarded() || !json.is_array()) {
+        std::cerr << file << " is not a json array of cameras" << std::endl;
+        return false;
+    }
+
+    // every field is checked before it is read, get<>() throws on a mismatched type
+    auto isVector3 = [](const nlohmann::json& value) {
+        return value.is_array() && value.size() == 3 && value[0].is_number() && value[1].is_number() && value[2].is_number();
+    };
+
+    cameras.clear();
+    cameras.reserve(json.size());
+    for (const nlohmann::json& entry : json) {
+        if (!entry.is_object()) {
+            std::cerr << file << ": camera " << cameras.size() << " is not a json object" << std::endl;
+            return false;
+        }
+        const char* required[] = {"id", "img_name", "width", "height", "position", "rotation", "fx", "fy"};
+        for (const char* key : required) {
+            if (!entry.contains(key)) {
+                std::cerr << file << ": camera " << cameras.size() << " has no '" << key << "'" << std::endl;
+                return false;
+            }
+        }
+        if (!entry["id"].is_number_integer() || !entry["img_name"].is_string() || !entry["width"].is_number_integer() ||
+            !entry["height"].is_number_integer() || !entry["fx"].is_number() || !entry["fy"].is_number()) {
+            std::cerr << file << ": camera " << cameras.size() << " needs an integer id, width and height, a string img_name and numbers fx and fy" << std::endl;
+            return false;
+        }
+
+        DatasetCamera camera;
+        camera.id = entry["id"].get<int>();
+        camera.imageName = entry["img_name"].get<std::string>();
+        camera.width = entry["width"].get<int>();
+        camera.height = entry["height"].get<int>();
+        camera.fx = entry["fx"].get<float>();
+        camera.fy = entry["fy"].get<float>();
+        if (camera.width <= 0 || camera.height <= 0 || !(camera.fx > 0.0f) || !(camera.fy > 0.0f)) {
+            std::cerr << file << ": camera " << camera.id << " needs a positive size and focal length" << std::endl;
+            return false;
+        }
+
+        const nlohmann::json& position = entry["position"];
+        const nlohmann::json& rotation = entry["rotation"];
+        if (!isVector3(position) || !rotation.is_array() || rotation.size() != 3 ||
+            !isVector3(rotation[0]) || !isVector3(rotation[1]) || !isVector3(rotation[2])) {
+            std::cerr << file << ": camera " << camera.id << " needs a 3 vector position and a 3 x 3 rotation" << std::endl;
+            return false;
+        }
+        camera.position = glm::vec3(position[0].get<float>(), position[1].get<float>(), position[2].get<float>());
+        // stored row by row, glm is column major
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                camera.rotation[col][row] = rotation[row][col].get<float>();
+            }
+        }
+
+        cameras.push_back(camera);
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// no X11 types in the EGL headers, their macros (None, Status, ...) break other code
+#ifndef EGL_NO_X11
+#define EGL_NO_X11
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+// OpenGL context without a window or a display server, for the modes that only render offscreen (--cameras,
+// shard workers) on servers and CI machines. The compute passes render into their own texture and never need
+// a default framebuffer, so the context is made current without any surface (EGL_KHR_surfaceless_context).
+//
+// The display is the first of
+//  - Mesa's surfaceless platform (EGL_MESA_platform_surfaceless), which runs on llvmpipe when no GPU is present
+//    or with LIBGL_ALWAYS_SOFTWARE=1,
+//  - the first EGL device (EGL_EXT_platform_device), how the NVIDIA driver renders without X,
+//  - the default display.
+class EglContext {
+public:
+    EglContext(int major = 4, int minor = 3) {
+        display = openDisplay();
+        EGLint eglMajor = 0, eglMinor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+            std::cerr << "Failed to initialize an EGL display" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return;
+        }
+        if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+            std::cerr << "The EGL display does not support surfaceless contexts" << std::endl;
+            return;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cerr << "The EGL display does not support desktop OpenGL" << std::endl;
+            return;
+        }
+
+        // no surface is ever created, any config that renders OpenGL will do
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_DONT_CARE,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config = EGL_NO_CONFIG_KHR;
+        EGLint numConfigs = 0;
+        if ((!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0) &&
+            !hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_no_config_context")) {
+            std::cerr << "No EGL config supports OpenGL" << std::endl;
+            return;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cerr << "Failed to create an OpenGL " << major << "." << minor << " core context with EGL (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return;
+        }
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cerr << "Failed to make the EGL context current (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return;
+        }
+
+        std::cout << "EGL " << eglMajor << "." << eglMinor << " surfaceless context (" << eglQueryString(display, EGL_VENDOR) << ")" << std::endl;
+        current = true;
+    }
+
+    ~EglContext() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    EglContext(const EglContext&) = delete;
+    EglContext& operator=(const EglContext&) = delete;
+
+    // the context is current on the calling thread
+    bool valid() const { return current; }
+
+    // for gladLoadGLLoader. Mesa and NVIDIA return core functions too, EGL_KHR_get_all_proc_addresses
+    static void* getProcAddress(const char* name) {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    bool current = false;
+
+    static bool hasExtension(const char* extensions, const char* name) {
+        if (!extensions) return false;
+        const size_t length = std::strlen(name);
+        for (const char* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name)) {
+            // whole names only, not the prefix of a longer one
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return true;
+        }
+        return false;
+    }
+
+    static EGLDisplay openDisplay() {
+        // client extensions, queried without a display
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (!getPlatformDisplay || !hasExtension(clientExtensions, "EGL_EXT_platform_base")) return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (surfaceless != EGL_NO_DISPLAY) return surfaceless;
+        }
+
+        auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+        if (queryDevices && hasExtension(clientExtensions, "EGL_EXT_platform_device")) {
+            EGLint numDevices = 0;
+            if (queryDevices(0, nullptr, &numDevices) && numDevices > 0) {
+                std::vector<EGLDeviceEXT> devices(numDevices);
+                if (queryDevices(numDevices, devices.data(), &numDevices) && numDevices > 0) {
+                    EGLDisplay device = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[0], nullptr);
+                    if (device != EGL_NO_DISPLAY) return device;
+                }
+            }
+        }
+
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+};
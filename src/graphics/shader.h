@@ -4,9 +4,18 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <utility>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdint>
+
+// #define NAME VALUE lines inserted after the #version line of a shader, in this order
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
 
 class Shader
 {
@@ -14,7 +23,14 @@ public:
     unsigned int ID;
     // constructor for shader program with compute shader
     // --------------------------------------------------
-    Shader(const char* computePath)
+    Shader(const char* computePath) : Shader(computePath, ShaderDefines())
+    {
+    }
+    // constructor for a specialized compute shader program, the defines are injected into the source.
+    // With a binaryDir the linked program is stored there as a program binary and loaded on the next
+    // run instead of being compiled again; the file name hashes the final source and the driver.
+    // ------------------------------------------------------------------------
+    Shader(const char* computePath, const ShaderDefines& defines, const std::string& binaryDir = "")
     {
         // 1. retrieve the compute shader source code from path
         std::string computeCode;
@@ -37,6 +53,14 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        computeCode = injectDefines(computeCode, defines);
+
+        std::string binaryFile;
+        if (!binaryDir.empty()) {
+            binaryFile = (std::filesystem::path(binaryDir) / (std::filesystem::path(computePath).stem().string() + "-" + sourceHash(computeCode) + ".bin")).string();
+            if (loadProgramBinary(binaryFile)) return;
+        }
+
         const char* cShaderCode = computeCode.c_str();
         // 2. compile shader
         unsigned int compute;
@@ -47,12 +71,14 @@ public:
         checkCompileErrors(compute, "COMPUTE");
         // shader Program
         ID = glCreateProgram();
+        if (!binaryFile.empty()) glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, compute);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
         // delete the shader as it's linked into the program now and no longer necessary
         glDeleteShader(compute);
 
+        if (!binaryFile.empty()) saveProgramBinary(binaryFile);
     }
     // constructor for shader program with vertex and fragment shaders
     // ---------------------------------------------------------------
@@ -200,6 +226,11 @@ public:
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
     }
     // ------------------------------------------------------------------------
+    void setUInt(const std::string &name, unsigned int value) const
+    { 
+        glUniform1ui(glGetUniformLocation(ID, name.c_str()), value); 
+    }
+    // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
@@ -214,6 +245,11 @@ public:
         glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
     }
     // ------------------------------------------------------------------------
+    void setIVec2(const std::string &name, int x, int y) const
+    { 
+        glUniform2i(glGetUniformLocation(ID, name.c_str()), x, y); 
+    }
+    // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
@@ -247,7 +283,94 @@ public:
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
 
+    // inserts the defines after the #version line, which has to stay first, and resets the line numbers
+    // so that compile errors point at the lines of the file
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string& source, const ShaderDefines& defines)
+    {
+        if (defines.empty()) return source;
+
+        size_t versionEnd = 0;
+        if (source.compare(0, 8, "#version") == 0) {
+            versionEnd = source.find('\n');
+            versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+        }
+
+        std::string injected = source.substr(0, versionEnd);
+        if (versionEnd > 0 && injected.back() != '\n') injected += '\n';
+        for (const auto& define : defines) {
+            injected += "#define " + define.first + " " + define.second + "\n";
+        }
+        injected += "#line " + std::to_string(versionEnd > 0 ? 2 : 1) + "\n";
+        injected += source.substr(versionEnd);
+        return injected;
+    }
+
 private:
+    // FNV-1a of the source and the driver strings, a driver update invalidates the stored binaries
+    static std::string sourceHash(const std::string& source)
+    {
+        std::string key = source;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const GLubyte* value = glGetString(name);
+            if (value) key += reinterpret_cast<const char*>(value);
+        }
+
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        std::stringstream hex;
+        hex << std::hex << hash;
+        return hex.str();
+    }
+
+    bool loadProgramBinary(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) return false;
+
+        GLenum format = 0;
+        in.read(reinterpret_cast<char*>(&format), sizeof(format));
+        std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (binary.empty()) return false;
+
+        ID = glCreateProgram();
+        glProgramBinary(ID, format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success) {
+            // the driver does not accept it any more, compile instead
+            glDeleteProgram(ID);
+            return false;
+        }
+        return true;
+    }
+
+    void saveProgramBinary(const std::string& file) const
+    {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        GLint length = 0;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (formats == 0 || length == 0) return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(ID, length, nullptr, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(file).parent_path(), error);
+        std::ofstream out(file, std::ios::binary);
+        if (!out) {
+            std::cout << "Could not write the shader binary " << file << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        out.write(binary.data(), binary.size());
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -273,4 +396,40 @@ private:
             }
         }
     }
-};
\ No newline at end of file
+};
+
+// Specialized variants of compute shaders, compiled (or loaded from binaryDir) on first use and kept until
+// the cache is destroyed. Variants are keyed on the shader file and its defines.
+class ShaderVariantCache
+{
+public:
+    ShaderVariantCache(const std::string& binaryDir = "") : binaryDir(binaryDir)
+    {
+    }
+
+    ~ShaderVariantCache()
+    {
+        for (auto& variant : variants) glDeleteProgram(variant.second->ID);
+    }
+
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    Shader& get(const std::string& computePath, const ShaderDefines& defines)
+    {
+        std::string key = computePath;
+        for (const auto& define : defines) key += "|" + define.first + "=" + define.second;
+
+        auto it = variants.find(key);
+        if (it == variants.end()) {
+            it = variants.emplace(key, std::make_unique<Shader>(computePath.c_str(), defines, binaryDir)).first;
+        }
+        return *it->second;
+    }
+
+    size_t size() const { return variants.size(); }
+
+private:
+    std::string binaryDir;
+    std::unordered_map<std::string, std::unique_ptr<Shader>> variants;
+};
@@ -9,13 +9,39 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
 #include <miniply.h>
 
 #include "graphics/shader.h"
 #include "graphics/camera.h"
+#include "graphics/camera_path.h"
+#ifdef SPLAT_EGL
+#include "graphics/egl_context.h"
+#endif
 #include "model_loading/splat_model.h"
+#include "model_loading/splat_loader.h"
+#include "model_loading/splat_bvh.h"
+#include "model_loading/splat_edits.h"
+#include "model_loading/snapshot_watcher.h"
+#include "rendering/splat_buffers.h"
+#include "core/frame_arena.h"
+#include "core/job_system.h"
+#include "rendering/tile_binning.h"
+#include "rendering/tile_stats.h"
+#include "core/frame_stats.h"
+#include "rendering/quality_controller.h"
+#include "rendering/splat_renderer.h"
+#include "rendering/batch_renderer.h"
+#include "rendering/sharded_renderer.h"
+#include "rendering/blend_comparison.h"
+#include "rendering/cpu_projection.h"
+#include "rendering/occlusion_culling.h"
+#include "rendering/image_metrics.h"
+#include "rendering/point_preview.h"
 
 #include <iostream>
 #include <filesystem>
@@ -23,6 +49,15 @@
 #include <vector>
 #include <string>
 #include <bitset>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <cmath>
 
 // prototypes
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -30,16 +65,19 @@ void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+bool parseNumber(const char* text, float& value);
+bool parseNumber(const char* text, int& value);
+int invalidNumber(const std::string& option, const char* value, const char* program);
+void printUsage(const char* program);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 800;
 
-const unsigned int TEXTURE_WIDTH = 800;
-const unsigned int TEXTURE_HEIGHT = 800;
-
 // camera
 Camera camera(glm::vec3(-0.5f, 0.3f, 0.7f));
+// the camera follows a recorded path, live input only closes the window
+bool replaying = false;
 
 //window
 bool cursorIsVisible = false;
@@ -55,44 +93,250 @@ unsigned int curScreenHeight = SCR_HEIGHT;
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f; // time of last frame
 int fCounter = 0;
+// default timestep of camera path replays, in seconds
+const float REPLAY_TIMESTEP = 1.0f / 60.0f;
 
-int main()
+// splats uploaded to the GPU per frame while a model is streaming in
+const uint32_t UPLOAD_BATCH_SIZE = 1 << 16;
+
+int main(int argc, char** argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
+    auto startTime = std::chrono::steady_clock::now();
 
-    // Version 4.3 to allow the usage of compute shaders
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // command line
+    // ------------
+    // std::string plyFile = "resources/models/ramp_clean_baseSH.ply";
+    std::string plyFile = "resources/models/clock_1band.ply";
+    // std::string plyFile = "resources/models/test_1band.ply";
+    // --morton sorts the splats along a Morton curve at load time for better memory locality
+    bool mortonOrder = false;
+    // --record writes the camera trajectory to a file on exit, --replay renders a recorded one at a fixed
+    // timestep and prints a frame time summary, --headless does so without showing a window
+    std::string recordFile;
+    std::string replayFile;
+    bool headless = false;
+    float replayTimestep = REPLAY_TIMESTEP;
+    // --target-ms enables the adaptive quality controller, --quality-log writes its per-frame decisions to a csv file
+    float targetFrameTime = 0.0f;
+    std::string qualityLogFile;
+    // --weighted blends the splats with weighted blended transparency instead of sorting them
+    bool weightedBlending = false;
+    // --occlusion drops splats behind the tiles that saturated in the previous frame, --occlusion-error also
+    // renders every frame without it and reports the difference
+    bool occlusionCulling = false;
+    bool occlusionErrorCheck = false;
+    // --cameras renders all views of a 3DGS cameras.json without a window, --images compares them to the
+    // training images, --output writes them as PNG, --batch-threads sets how many views are processed together
+    BatchOptions batchOptions;
+    // --large-tiles sets how many tiles a splat has to cover to be merged into the tiles at rasterization
+    // instead of being binned into each of them, 0 bins every splat
+    int largeSplatTiles = LARGE_SPLAT_TILES;
+    // --tile-stats writes the workload of every tile of every frame to a csv file
+    std::string tileStatsFile;
+    // --jobs sets the worker threads of the job system, 0 runs every job on the render thread in submission order
+    int numJobWorkers = -1;
+    // --shards renders the --cameras views or the --replay path with that many worker processes at native
+    // resolution (--resolution for camera paths), --shard-remote waits for more workers started elsewhere with
+    // --shard-worker at --shard-address, --shard-scene places the scene file they map. Frames are split into bands
+    // of --shard-band-rows tile rows unless --shard-frames, --shard-scaling reports the scaling from 1 worker on
+    ShardOptions shardOptions;
+    // --egl creates a surfaceless EGL context instead of a window for --cameras and the shard workers, so they
+    // run on machines without a display, on Mesa's llvmpipe when there is no GPU
+    bool useEgl = false;
+    // --motion-preview draws the splats as depth tested point sprites instead of rasterizing the tiles while the
+    // camera moves, and switches back to the full rasterization once it stops
+    bool motionPreview = false;
+    // --watch follows a training run: the newest PLY snapshot below the directory is loaded and every later one is
+    // diffed against it in the background, only splats that changed by more than --watch-tolerance are uploaded
+    std::string watchDirectory;
+    float watchTolerance = 0.01f;
+    int number = 0;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--morton") mortonOrder = true;
+        else if (arg == "--headless") headless = true;
+        else if (arg == "--weighted") weightedBlending = true;
+        else if (arg == "--occlusion") occlusionCulling = true;
+        else if (arg == "--occlusion-error") occlusionCulling = occlusionErrorCheck = true;
+        else if (arg == "--record" && a + 1 < argc) recordFile = argv[++a];
+        else if (arg == "--replay" && a + 1 < argc) replayFile = argv[++a];
+        else if (arg == "--timestep" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], replayTimestep)) return invalidNumber(arg, argv[a], argv[0]);
+        }
+        else if (arg == "--target-ms" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], targetFrameTime)) return invalidNumber(arg, argv[a], argv[0]);
+        }
+        else if (arg == "--quality-log" && a + 1 < argc) qualityLogFile = argv[++a];
+        else if (arg == "--cameras" && a + 1 < argc) batchOptions.camerasFile = argv[++a];
+        else if (arg == "--images" && a + 1 < argc) batchOptions.imagesDir = argv[++a];
+        else if (arg == "--output" && a + 1 < argc) batchOptions.outputDir = argv[++a];
+        else if (arg == "--batch-threads" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], number)) return invalidNumber(arg, argv[a], argv[0]);
+            batchOptions.numThreads = std::max(0, number);
+        }
+        else if (arg == "--large-tiles" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], largeSplatTiles)) return invalidNumber(arg, argv[a], argv[0]);
+            largeSplatTiles = std::max(0, largeSplatTiles);
+        }
+        else if (arg == "--tile-stats" && a + 1 < argc) tileStatsFile = argv[++a];
+        else if (arg == "--jobs" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], numJobWorkers)) return invalidNumber(arg, argv[a], argv[0]);
+        }
+        else if (arg == "--shards" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], number)) return invalidNumber(arg, argv[a], argv[0]);
+            shardOptions.numWorkers = std::max(0, number);
+        }
+        else if (arg == "--shard-remote" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], number)) return invalidNumber(arg, argv[a], argv[0]);
+            shardOptions.remoteWorkers = std::max(0, number);
+        }
+        else if (arg == "--shard-address" && a + 1 < argc) shardOptions.address = argv[++a];
+        else if (arg == "--shard-scene" && a + 1 < argc) shardOptions.sceneFile = argv[++a];
+        else if (arg == "--shard-band-rows" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], number)) return invalidNumber(arg, argv[a], argv[0]);
+            shardOptions.bandRows = std::max(0, number);
+        }
+        else if (arg == "--shard-frames") shardOptions.wholeFrames = true;
+        else if (arg == "--shard-scaling") shardOptions.scaling = true;
+        else if (arg == "--shard-worker" && a + 1 < argc) shardOptions.workerAddress = argv[++a];
+        else if (arg == "--egl") useEgl = true;
+        else if (arg == "--motion-preview") motionPreview = true;
+        else if (arg == "--watch" && a + 1 < argc) watchDirectory = argv[++a];
+        else if (arg == "--watch-tolerance" && a + 1 < argc) {
+            if (!parseNumber(argv[++a], watchTolerance)) return invalidNumber(arg, argv[a], argv[0]);
+            watchTolerance = std::max(0.0f, watchTolerance);
+        }
+        else if (arg == "--resolution" && a + 1 < argc) {
+            if (std::sscanf(argv[++a], "%ux%u", &shardOptions.width, &shardOptions.height) != 2 || shardOptions.width == 0 || shardOptions.height == 0) {
+                std::cout << "--resolution expects WIDTHxHEIGHT" << std::endl;
+                return -1;
+            }
+        }
+        else plyFile = arg;
+    }
+    JobSystem::configureGlobal(numJobWorkers);
+    batchOptions.blendMode = weightedBlending ? BlendMode::WeightedBlended : BlendMode::Sorted;
+
+    CameraPath recordPath;
+    CameraPath replayPath;
+    if (!replayFile.empty()) {
+        if (!replayPath.load(replayFile)) return -1;
+        if (replayTimestep <= 0.0f) {
+            std::cout << "Replay timestep must be positive" << std::endl;
+            return -1;
+        }
+        replaying = true;
+    }
+    if (headless && !replaying) {
+        std::cout << "--headless needs a camera path to --replay" << std::endl;
+        return -1;
+    }
+    if (!watchDirectory.empty() && !std::filesystem::is_directory(watchDirectory)) {
+        std::cout << "--watch expects the directory of a training run" << std::endl;
+        return -1;
+    }
+    if (useEgl) {
+#ifdef SPLAT_EGL
+        if (batchOptions.camerasFile.empty() && shardOptions.workerAddress.empty() && shardOptions.numWorkers == 0 && !headless) {
+            std::cout << "--egl renders the --cameras views, --shards, a --shard-worker or a --headless --replay, the other modes need a window" << std::endl;
+            return -1;
+        }
+#else
+        std::cout << "--egl needs a build with SPLAT_EGL" << std::endl;
+        return -1;
+#endif
+    }
+
+    // sharded offline rendering: this process only coordinates the workers and needs no context
+    // ------------------------
+    if (shardOptions.numWorkers + shardOptions.remoteWorkers > 0) {
+        shardOptions.outputDir = batchOptions.outputDir;
+        shardOptions.flipY = batchOptions.flipY;
+        shardOptions.blendMode = batchOptions.blendMode;
+        shardOptions.egl = useEgl;
+
+        std::vector<ShardFrame> frames;
+        if (!batchOptions.camerasFile.empty()) {
+            std::vector<DatasetCamera> cameras;
+            if (!loadDatasetCameras(batchOptions.camerasFile, cameras)) return -1;
+            for (const DatasetCamera& view : cameras) {
+                frames.push_back(ShardFrame{view.imageName, view.splatView(shardOptions.flipY), static_cast<uint32_t>(view.width), static_cast<uint32_t>(view.height)});
+            }
+        } else if (replaying) {
+            const float aspectRatio = static_cast<float>(shardOptions.width) / shardOptions.height;
+            for (uint32_t f = 0; f < replayPath.frameCount(replayTimestep); f++) {
+                replayPath.sample(f * replayTimestep).apply(camera);
+                char name[32];
+                std::snprintf(name, sizeof(name), "frame_%05u", f);
+                frames.push_back(ShardFrame{name, SplatView::fromCamera(camera, aspectRatio), shardOptions.width, shardOptions.height});
+            }
+        } else {
+            std::cout << "--shards needs the --cameras or the camera path to --replay to render" << std::endl;
+            return -1;
+        }
+
+        // the workers are this executable
+        const std::string executable = std::filesystem::exists("/proc/self/exe") ? std::filesystem::read_symlink("/proc/self/exe").string() : argv[0];
+        return ShardCoordinator(shardOptions, executable).run(plyFile, frames) ? 0 : -1;
+    }
+
+    // without a window the context is EGL's, the window is only created for the modes that show something
+    // ------------------------------------------------------------------------------------------------------
+#ifdef SPLAT_EGL
+    std::unique_ptr<EglContext> eglContext;
+#endif
+    GLFWwindow* window = NULL;
+    GLADloadproc loadProc = (GLADloadproc)glfwGetProcAddress;
+    if (useEgl) {
+#ifdef SPLAT_EGL
+        eglContext = std::make_unique<EglContext>();
+        if (!eglContext->valid()) return -1;
+        loadProc = (GLADloadproc)EglContext::getProcAddress;
+#endif
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+
+        // Version 4.3 to allow the usage of compute shaders
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Splat Renderer", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
+        // headless runs still need a context, render into an invisible window
+        if (headless || !batchOptions.camerasFile.empty() || !shardOptions.workerAddress.empty()) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
-    // set callbacks
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);  
-    glfwSetScrollCallback(window, scroll_callback); 
-    glfwSetKeyCallback(window, key_callback);
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Splat Renderer", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+
+        // set callbacks
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);  
+        glfwSetScrollCallback(window, scroll_callback); 
+        glfwSetKeyCallback(window, key_callback);
 
-    glfwSwapInterval(0); // Disable vsync
+        glfwSwapInterval(0); // Disable vsync
+    }
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader(loadProc))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
@@ -132,27 +376,103 @@ int main()
     Shader quadShader(vQuadShaderPath.c_str(), fQuadShaderPath.c_str());
 
 
-    std::filesystem::path vPointcloudShaderPath = "resources/shaders/pointcloud.vs";
-    std::filesystem::path gPointcloudShaderPath = "resources/shaders/pointcloud.gs";
-    std::filesystem::path fPointcloudShaderPath = "resources/shaders/pointcloud.fs";
-    Shader pointcloudShader(vPointcloudShaderPath.c_str(), gPointcloudShaderPath.c_str(), fPointcloudShaderPath.c_str());
-
     std::filesystem::path gGridShaderPath = "resources/shaders/grid.gs";
     std::filesystem::path fGridShaderPath = "resources/shaders/grid.fs";
     Shader gridShader(vQuadShaderPath.c_str(), gGridShaderPath.c_str(), fGridShaderPath.c_str());
 
-    std::filesystem::path covShaderPath = "resources/shaders/splat_covariances.cs";
-    Shader covShader(covShaderPath.c_str());
+    // projection, gathering and rasterization passes, with the buffers and the texture they render into
+    std::unique_ptr<SplatRenderer> renderer = std::make_unique<SplatRenderer>();
 
-    std::filesystem::path processPixelsShaderPath = "resources/shaders/process_pixels.cs";
-    Shader processPixelsShader(processPixelsShaderPath.c_str());
+    // shard worker: render the tasks of a coordinator until it is done
+    // ------------
+    if (!shardOptions.workerAddress.empty()) {
+        const bool success = ShardWorker(*renderer).run(shardOptions.workerAddress);
+        renderer.reset();
+        glfwTerminate();
+        return success ? 0 : -1;
+    }
+
+    // batch mode: render every view of a cameras.json and exit
+    // ----------
+    if (!batchOptions.camerasFile.empty()) {
+        SplatModel batchModel(plyFile, batchOptions.flipY);
+        if (!batchModel.loaded) {
+            glfwTerminate();
+            return -1;
+        }
+        if (mortonOrder) std::cout << "--morton is ignored in batch mode" << std::endl;
 
-    // Loads splats, transforms values to be physically meaningful and builds the covariance matrices for each splat
+        bool success;
+        {
+            SplatBuffers batchBuffers(batchModel.numPoints);
+            batchBuffers.uploadUntil(batchModel, batchModel.numPoints);
+            success = BatchRenderer(*renderer, batchBuffers, batchOptions).run();
+        }
+        renderer.reset();
+        glfwTerminate();
+        return success ? 0 : -1;
+    }
+
+    // live training run: starts from its newest snapshot, the later ones are applied as deltas
+    std::unique_ptr<SnapshotWatcher> snapshotWatcher;
+    if (!watchDirectory.empty()) {
+        const std::string newest = SnapshotWatcher::newestSnapshot(watchDirectory);
+        if (!newest.empty()) plyFile = newest;
+        else std::cout << "No snapshot in " << watchDirectory << " yet, showing " << plyFile << " until the first one" << std::endl;
+        if (mortonOrder) {
+            std::cout << "--morton is ignored with --watch, the snapshots are compared by index" << std::endl;
+            mortonOrder = false;
+        }
+        snapshotWatcher = std::make_unique<SnapshotWatcher>(watchDirectory, watchTolerance, true);
+        snapshotWatcher->markApplied(plyFile);
+    }
+    // the last applied snapshot, for the UI
+    std::unique_ptr<SnapshotDelta> lastSnapshot;
+    size_t snapshotBytes = 0;
+    float snapshotApplyTime = 0.0f;
+
+    // Loads splats, transforms values to be physically meaningful and builds the covariance matrices for each splat.
+    // This happens on a background thread, the splats are uploaded in batches as they become ready
     // -----------
-    // std::string plyFile = "resources/models/ramp_clean_baseSH.ply";
-    std::string plyFile = "resources/models/clock_1band.ply";
-    // std::string plyFile = "resources/models/test_1band.ply";
-    std::unique_ptr<SplatModel> splatModel = std::make_unique<SplatModel>(SplatModel(plyFile, true, false));
+    std::unique_ptr<SplatLoader> loader = std::make_unique<SplatLoader>(plyFile, true, mortonOrder);
+
+    // model being rendered, and the model being uploaded in the background for a hot swap
+    std::unique_ptr<SplatModel> splatModel;
+    std::unique_ptr<SplatBuffers> activeBuffers;
+    std::unique_ptr<SplatBuffers> pendingBuffers;
+    bool swapping = false;
+    bool firstFrameRendered = false;
+    // BVH over the loaded model for picking and region queries, built by a background job after loading
+    std::unique_ptr<SplatBvh> splatBvh;
+    std::unique_ptr<SplatBvh> pendingBvh;
+    JobHandle bvhJob;
+    std::atomic<bool> bvhCancel{false};
+    std::chrono::steady_clock::time_point bvhStart;
+    auto buildBvh = [&]() {
+        bvhStart = std::chrono::steady_clock::now();
+        bvhCancel = false;
+        bvhJob = JobSystem::global().submitBackground([&pendingBvh, &bvhCancel, model = splatModel.get()]() {
+            pendingBvh = std::make_unique<SplatBvh>(model->covAndPos, model->colorAndOpacity, model->numPoints, &bvhCancel);
+        });
+    };
+    // stops a running build, which returns within a node of the tree, and drops its result
+    auto cancelBvh = [&]() {
+        if (bvhJob) {
+            bvhCancel = true;
+            JobSystem::global().wait(bvhJob);
+        }
+        bvhJob.reset();
+        pendingBvh.reset();
+    };
+    float worstSwapFrameTime = 0.0f;
+
+    // models that can be switched to at runtime
+    std::vector<std::string> modelFiles;
+    for (const auto& entry : std::filesystem::directory_iterator("resources/models")) {
+        if (entry.path().extension() == ".ply") modelFiles.push_back(entry.path().string());
+    }
+    std::sort(modelFiles.begin(), modelFiles.end());
+    std::string selectedModel = plyFile;
 
 
     // Setup Dear ImGui context
@@ -163,102 +483,130 @@ int main()
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true); 
-    ImGui_ImplOpenGL3_Init();
+    // Setup Platform/Renderer backends, an EGL context has no window for them
+    if (window) {
+        ImGui_ImplGlfw_InitForOpenGL(window, true); 
+        ImGui_ImplOpenGL3_Init();
+    }
 
     // SSBOs
-
-    unsigned int inputCovSSBO;
-    glGenBuffers(1, &inputCovSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, inputCovSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, splatModel->covAndPos.size() * sizeof(glm::mat4), splatModel->covAndPos.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, inputCovSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    // Data chunck for outputting data
-    struct OutputData {
-        glm::mat2 covariance;
-        glm::vec4 position;
-        glm::vec4 clipPos;
-        glm::ivec2 topCorner;
-        glm::ivec2 botCorner;
-        glm::vec2 majorEigenVec;
-        glm::vec2 minorEigenVec;
-    };
-
-    unsigned int outputCovSSBO;
-    glGenBuffers(1, &outputCovSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, outputCovSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, splatModel->covAndPos.size() * sizeof(OutputData), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, outputCovSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    unsigned int rangeSSBO;
-    glGenBuffers(1, &rangeSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeSSBO);
-    // TODO: hardcoded size tied to block size
-    glBufferData(GL_SHADER_STORAGE_BUFFER, (50 * 50 + 1) * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW); 
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rangeSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    unsigned int gIndicesSSBO;
-    glGenBuffers(1, &gIndicesSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gIndicesSSBO);
-    // upperlimit estimate == 5, should be dynamically updated if exceeded 
-    glBufferData(GL_SHADER_STORAGE_BUFFER, splatModel->covAndPos.size() * 1000 * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, gIndicesSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    unsigned int colorAndOpacitySSBO;
-    glGenBuffers(1, &colorAndOpacitySSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, colorAndOpacitySSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, splatModel->covAndPos.size() * sizeof(glm::vec4), splatModel->colorAndOpacity.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, colorAndOpacitySSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    struct EigenData {
-        glm::vec2 majorEigVec;
-        glm::vec2 minorEigVec;
-    };
-
-    unsigned int eigenUBO;
-    glGenBuffers(1, &eigenUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, eigenUBO);
-    // hardcoded
-    glBufferData(GL_UNIFORM_BUFFER, 100 * sizeof(EigenData), nullptr, GL_DYNAMIC_DRAW);
-    // glBufferData(GL_UNIFORM_BUFFER, splatModel->covAndPos.size() * sizeof(EigenData), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 5, eigenUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    // create texture to write the final image
-    unsigned int texture;
-
-    glGenTextures(1, &texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // the per-model buffers live in SplatBuffers, the per-frame ones in SplatRenderer
+
+    // GPU timings of the gather and rasterization passes
+    float gatherTime = 0.0f;
+    float rasterTime = 0.0f;
+    float bytesPerTile = 0.0f;
+
+    BinningMode binningMode = BinningMode::CountingSort;
+    bool validateBinning = false;
+    // checks splat_covariances.cs against the CPU projection, which is built for the model on first use
+    bool validateProjection = false;
+    const SplatModel* cpuProjectionModel = nullptr;
+    std::unique_ptr<SplatSoA> cpuSplats;
+    std::unique_ptr<CpuProjector> cpuProjector;
+    float cpuProjectionTime = 0.0f;
+    ProjectionDifference projectionDifference;
+    // weighted blending does not need depth sorted bins
+    BlendMode blendMode = batchOptions.blendMode;
+    bool compareBlending = false;
+    bool debugSplatsPerPixel = false;
+    float binningTime = 0.0f;
+    float duplicationFactor = 0.0f;
+    // splats kept out of the tiles by the large splat list and the tile entries they would have added
+    uint32_t numLargeSplats = 0;
+    size_t largeEntries = 0;
+    double replaySortKeys = 0.0;
+    double replayLargeEntries = 0.0;
+    size_t replayMaxSortKeys = 0;
+    // share of the resident splats that survive culling, and bytes read back and uploaded for binning per frame
+    float visibleFraction = 0.0f;
+    float bytesMoved = 0.0f;
+    double replayVisibleFraction = 0.0;
+    double replayBytesMoved = 0.0;
+    // temporal occlusion culling: share of the tile entries dropped, and the error against unculled frames
+    OcclusionCuller occlusionCuller;
+    std::vector<uint32_t> tileSaturation;
+    float occludedFraction = 0.0f;
+    std::vector<float> culledImage;
+    std::vector<float> unculledImage;
+    double replayOccludedFraction = 0.0;
+    uint32_t occlusionCheckedFrames = 0;
+    uint32_t occlusionDifferentFrames = 0;
+    double occlusionMinPsnr = std::numeric_limits<double>::infinity();
+    double occlusionMaxError = 0.0;
+    // clicking the image with a visible cursor picks the first splat under it; the region queries count the
+    // splats around the picked point and the distance to the previous pick measures the scene
+    float pickMinAlpha = 0.1f;
+    float pickRadius = 0.1f;
+    bool mouseWasDown = false;
+    SplatHit pickedSplat;
+    glm::vec3 pickedPoint(0.0f);
+    glm::vec3 previousPickedPoint(0.0f);
+    bool hasPreviousPick = false;
+    size_t splatsInSphere = 0;
+    size_t splatsInBox = 0;
+    uint32_t nearestToCamera = NO_SPLAT;
+    float nearestToCameraDistance = 0.0f;
+    float pickTime = 0.0f;
+    // edits of the splats within the pick radius: only the changed splats are uploaded again, deleted splats
+    // are compacted away once they are a large share of the model or on request
+    std::unique_ptr<SplatEditor> splatEditor;
+    std::vector<uint32_t> editSelection;
+    glm::vec3 editTranslation(0.0f);
+    float editAngle = 0.0f;
+    float editScale = 1.0f;
+    glm::vec3 editColor(1.0f);
+    bool transformSelection = false;
+    bool recolorSelection = false;
+    bool deleteSelection = false;
+    bool compactSplats = false;
+    float editTime = 0.0f;
+    size_t editRanges = 0;
+    size_t editBytes = 0;
+    // per tile workload of the sorted rasterization, as an overlay over the image and in the --tile-stats log
+    bool showTileHeatmap = false;
+    int tileHeatmapMetric = static_cast<int>(TileMetric::Splats);
+    std::vector<TileStats> tileStats;
+    TileStatsSummary tileStatsSummary;
+    std::vector<uint8_t> tileHeatmapPixels;
+    TileStatsLog tileStatsLog;
+    uint32_t tileStatsFrame = 0;
+    if (!tileStatsFile.empty()) tileStatsLog.open(tileStatsFile);
+    unsigned int tileHeatmapTexture;
+    glGenTextures(1, &tileHeatmapTexture);
+    glBindTexture(GL_TEXTURE_2D, tileHeatmapTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
-
-    // bind texture to image unit (binding point) 0
-    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-    // pointcloud
-
-    unsigned int pcVBO, pcVAO;
-    glGenVertexArrays(1, &pcVAO);
-    glGenBuffers(1, &pcVBO);
-
-    glBindVertexArray(pcVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, pcVBO);
-    glBufferData(GL_ARRAY_BUFFER, splatModel->position.size() * sizeof(float), splatModel->position.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, NUM_TILES_X, NUM_TILES_Y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // camera path replay, starts once the model is completely resident so that every frame renders the same splats
+    uint32_t replayFrame = 0;
+    const uint32_t replayFrames = replayPath.frameCount(replayTimestep);
+    std::vector<float> replayFrameTimes;
+    replayFrameTimes.reserve(replayFrames);
+    float recordStart = -1.0f;
+
+    // lowers the render resolution, raises the alpha cutoff and limits the splats per tile when over the frame budget
+    QualityController qualityController(targetFrameTime > 0.0f ? targetFrameTime : 16.0f);
+    qualityController.enabled = targetFrameTime > 0.0f;
+    if (!qualityLogFile.empty()) qualityController.openLog(qualityLogFile);
+    StageTimings stageTimings;
+
+    // owns all transient per-frame data of the render loop
+    FrameAllocator frameAllocator;
+
+    // point sprites instead of the tile rasterization while the camera moves, with the frame times of both modes
+    PointPreview pointPreview;
+    CameraMotion cameraMotion;
+    RenderModeTimes modeTimes;
+    std::vector<float> replayPreviewFrameTimes;
+    std::vector<float> replayFullFrameTimes;
+    // the per frame replay statistics below are averaged over the rasterized frames, preview frames skip the
+    // projection and binning
+    uint32_t replayRasterFrames = 0;
 
     // Screen quad
     // -----------
@@ -289,174 +637,570 @@ int main()
 
     glBindVertexArray(0);
 
+    // a surfaceless EGL context has no default framebuffer, the headless replay draws into one of the window's size
+    unsigned int headlessFBO = 0;
+    unsigned int headlessRenderbuffers[2] = {0, 0};
+    if (!window) {
+        glGenFramebuffers(1, &headlessFBO);
+        glGenRenderbuffers(2, headlessRenderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, curScreenWidth, curScreenHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, curScreenWidth, curScreenHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, headlessFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRenderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headlessRenderbuffers[1]);
+        glViewport(0, 0, curScreenWidth, curScreenHeight);
+    }
+
     // focus cursor
     // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // render loop
+    // render loop, which the replay ends by setting quit
     // -----------
-    while (!glfwWindowShouldClose(window))
+    bool quit = false;
+    while (!quit && !(window && glfwWindowShouldClose(window)))
     {
         // poll inputs
         // -----------
-        glfwPollEvents();
+        if (window) glfwPollEvents();
+
+        auto frameStart = std::chrono::steady_clock::now();
+        frameAllocator.beginFrame();
 
         //update deltaTime
-        float currentFrame = glfwGetTime();
+        float currentFrame = window ? glfwGetTime() : std::chrono::duration<float>(frameStart - startTime).count();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;  
 
         // Start the Dear ImGui frame
         // --------------------------
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        // imgui setup
-        if (cursorIsVisible) {
-            ImGui::SetNextWindowCollapsed(false, ImGuiCond_Always);
-        } else {
-            ImGui::SetNextWindowCollapsed(true, ImGuiCond_Always);
+        if (!headless) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            // imgui setup
+            if (cursorIsVisible) {
+                ImGui::SetNextWindowCollapsed(false, ImGuiCond_Always);
+            } else {
+                ImGui::SetNextWindowCollapsed(true, ImGuiCond_Always);
+            }
+            ImGui::SetNextWindowPos(ImVec2(0.f, 0.f), ImGuiCond_Once);
+            ImGui::SetNextWindowSize(ImVec2(150.0f, 0.0f), ImGuiCond_Once);
+
+
+            // begin
+            ImGui::Begin("Scene Parameters");
+
+            ImGui::Text("Hello there!");
+            static float testVar = 0.f;
+            ImGui::SliderFloat("Slider", &testVar, 0.0f, 1.0f);
+
+            // model selection, the new model is loaded in the background and swapped in once uploaded
+            if (ImGui::BeginCombo("Model", std::filesystem::path(selectedModel).filename().string().c_str())) {
+                for (const std::string& file : modelFiles) {
+                    if (ImGui::Selectable(std::filesystem::path(file).filename().string().c_str(), file == selectedModel)) {
+                        selectedModel = file;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::Checkbox("Morton order", &mortonOrder);
+            bool countingSort = binningMode == BinningMode::CountingSort;
+            if (ImGui::Checkbox("Counting sort binning", &countingSort)) {
+                binningMode = countingSort ? BinningMode::CountingSort : BinningMode::SortKeys;
+            }
+            ImGui::Checkbox("Validate binning", &validateBinning);
+            ImGui::Checkbox("Validate projection", &validateProjection);
+            if (validateProjection) {
+                ImGui::Text("CPU projection: %.3f ms", cpuProjectionTime);
+                ImGui::Text("Unmatched %u, rects %u, conic %.1e", projectionDifference.unmatched,
+                    projectionDifference.cornerMismatches, projectionDifference.maxConicError);
+            }
+            bool weighted = blendMode == BlendMode::WeightedBlended;
+            if (ImGui::Checkbox("Weighted blending", &weighted)) {
+                blendMode = weighted ? BlendMode::WeightedBlended : BlendMode::Sorted;
+            }
+            if (ImGui::Button("Compare blending")) compareBlending = true;
+            if (ImGui::Checkbox("Debug: splats per pixel", &debugSplatsPerPixel)) renderer->setDebugOutput(debugSplatsPerPixel);
+            ImGui::Checkbox("Tile heatmap", &showTileHeatmap);
+            if (showTileHeatmap || tileStatsLog.isOpen()) {
+                ImGui::Combo("Tile metric", &tileHeatmapMetric, TILE_METRIC_NAMES, IM_ARRAYSIZE(TILE_METRIC_NAMES));
+                ImGui::Text("Truncated: %u tiles, %llu splats", tileStatsSummary.truncatedTiles,
+                    static_cast<unsigned long long>(tileStatsSummary.truncatedSplats));
+                ImGui::Text("Max splats per tile: %u, saturated tiles: %u", tileStatsSummary.maxSplats, tileStatsSummary.saturatedTiles);
+                ImGui::Text("Per pixel: %.1f evaluated, %.1f contributed", tileStatsSummary.meanEvaluated, tileStatsSummary.meanContributed);
+            }
+            if (splatBvh) {
+                ImGui::SliderFloat("Pick alpha", &pickMinAlpha, 0.01f, 1.0f);
+                ImGui::SliderFloat("Pick radius", &pickRadius, 0.001f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                if (pickedSplat.index != NO_SPLAT) {
+                    ImGui::Text("Picked splat %u (alpha %.2f) at %.3f", pickedSplat.index, pickedSplat.alpha, pickedSplat.distance);
+                    ImGui::Text("Point %.3f %.3f %.3f", pickedPoint.x, pickedPoint.y, pickedPoint.z);
+                    ImGui::Text("Within radius: %zu splats, in box: %zu", splatsInSphere, splatsInBox);
+                    if (hasPreviousPick) ImGui::Text("Distance to previous pick: %.3f", glm::length(pickedPoint - previousPickedPoint));
+                }
+                if (nearestToCamera != NO_SPLAT) ImGui::Text("Nearest splat to the camera: %u at %.3f", nearestToCamera, nearestToCameraDistance);
+                ImGui::Text("Queries: %.3f ms", pickTime);
+                if (splatEditor && !loader) {
+                    ImGui::Text("Selection: %zu splats", editSelection.size());
+                    ImGui::DragFloat3("Move", &editTranslation.x, 0.01f);
+                    ImGui::SliderFloat("Rotate", &editAngle, -180.0f, 180.0f);
+                    ImGui::SliderFloat("Scale", &editScale, 0.1f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+                    if (ImGui::Button("Transform")) transformSelection = true;
+                    ImGui::ColorEdit3("Color", &editColor.x);
+                    if (ImGui::Button("Recolor")) recolorSelection = true;
+                    ImGui::SameLine();
+                    if (ImGui::Button("Delete")) deleteSelection = true;
+                    ImGui::SameLine();
+                    if (ImGui::Button("Compact")) compactSplats = true;
+                    ImGui::Text("Deleted: %u splats", splatEditor->deletedCount());
+                    ImGui::Text("Last edit: %.3f ms, %zu ranges, %.1f KB", editTime, editRanges, editBytes / 1024.0f);
+                }
+            } else if (bvhJob) {
+                ImGui::Text("Building BVH");
+            }
+            ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+            if (occlusionCulling) {
+                ImGui::Text("Occluded: %.1f%% of keys, %u tiles", occludedFraction * 100.0f, occlusionCuller.occluderTiles);
+            }
+            ImGui::Text("Binning: %.3f ms", binningTime);
+            ImGui::Text("Tiles per splat: %.2f", duplicationFactor);
+            ImGui::SliderInt("Large splat tiles", &largeSplatTiles, 0, static_cast<int>(NUM_TILES));
+            ImGui::Text("Large splats: %u (%zu keys saved)", numLargeSplats, largeEntries);
+            ImGui::Text("Visible: %.1f%%", visibleFraction * 100.0f);
+            ImGui::Text("Moved: %.2f MB/frame", bytesMoved / (1024.0f * 1024.0f));
+            ImGui::Text("Gather: %.3f ms", gatherTime);
+            ImGui::Text("Raster: %.3f ms", rasterTime);
+            ImGui::Text("Read per tile: %.1f KB", bytesPerTile / 1024.0f);
+            ImGui::Text("Frame allocations: %u (heap %u)", frameAllocator.allocationsLastFrame(), frameAllocator.heapAllocationsLastFrame());
+            ImGui::Text("Frame arena high water: %.1f MB", frameAllocator.highWaterBytes() / (1024.0f * 1024.0f));
+            std::vector<WorkerStats> jobStats = JobSystem::global().stats();
+            for (size_t w = 0; w < jobStats.size(); w++) {
+                if (w + 1 < jobStats.size()) ImGui::Text("Worker %zu: %.0f%%, %llu stolen", w, jobStats[w].utilization * 100.0,
+                    static_cast<unsigned long long>(jobStats[w].steals));
+                else ImGui::Text("Render thread jobs: %.0f%%", jobStats[w].utilization * 100.0);
+            }
+            if (ImGui::Button("Reset job stats")) JobSystem::global().resetStats();
+            ImGui::Checkbox("Motion preview", &motionPreview);
+            if (motionPreview) {
+                ImGui::SliderFloat("Settle s", &cameraMotion.settleSeconds, 0.0f, 1.0f);
+                ImGui::Text("Frame time: %.2f ms rasterized, %.2f ms preview", modeTimes.full, modeTimes.preview);
+            }
+            ImGui::Checkbox("Adaptive quality", &qualityController.enabled);
+            ImGui::SliderFloat("Target ms", &qualityController.targetFrameTime, 4.0f, 50.0f);
+            ImGui::Text("Quality level %d (%.0f%% res), %.2f ms", qualityController.level(),
+                qualityController.settings().renderScale * 100.0f, qualityController.smoothedFrameTime());
+            if (ImGui::Button("Load") && !loader) {
+                loader = std::make_unique<SplatLoader>(selectedModel, true, mortonOrder && !snapshotWatcher);
+                swapping = activeBuffers != nullptr;
+                worstSwapFrameTime = 0.0f;
+            }
+            if (loader) {
+                ImGui::Text("Loading %s", std::filesystem::path(loader->file()).filename().string().c_str());
+                if (loader->headerReady()) {
+                    ImGui::Text("%u / %u splats", loader->processedCount(), loader->model().numPoints);
+                }
+            }
+            if (snapshotWatcher) {
+                ImGui::Text("Watching %s", snapshotWatcher->watchedDirectory().c_str());
+                auto snapshotName = [&](const std::string& file) { return std::filesystem::path(file).lexically_relative(watchDirectory).string(); };
+                if (!snapshotWatcher->pendingFile().empty()) ImGui::Text("Updating from %s", snapshotName(snapshotWatcher->pendingFile()).c_str());
+                if (lastSnapshot) {
+                    ImGui::Text("Snapshot %s", snapshotName(lastSnapshot->file).c_str());
+                    ImGui::Text("Delta: %zu changed, %u appended, %u removed", lastSnapshot->changed.size(), lastSnapshot->appended(), lastSnapshot->removed());
+                    ImGui::Text("%.1f MB uploaded, applied in %.2f ms", snapshotBytes / (1024.0f * 1024.0f), snapshotApplyTime);
+                }
+            }
+            if (replaying) ImGui::Text("Replay frame %u / %u", replayFrame, replayFrames);
+            if (!recordFile.empty()) ImGui::Text("Recording (%zu keyframes)", recordPath.keyframes.size());
+
+            //imgui end
+            ImGui::End();
         }
-        ImGui::SetNextWindowPos(ImVec2(0.f, 0.f), ImGuiCond_Once);
-        ImGui::SetNextWindowSize(ImVec2(150.0f, 0.0f), ImGuiCond_Once);
 
+        // stream the model being loaded to the GPU
+        // ----------------------------------------
+        if (loader && loader->failed()) {
+            std::cerr << "Failed to load " << loader->file() << std::endl;
+            loader.reset();
+            pendingBuffers.reset();
+            swapping = false;
+            // nothing to replay
+            if (replaying && !activeBuffers) quit = true;
+        }
 
-        // begin
-        ImGui::Begin("Scene Parameters");
+        if (loader && loader->headerReady()) {
+            // the first model is drawn while it streams in, later ones are filled in the background
+            // and swapped in between two frames once they are completely resident
+            std::unique_ptr<SplatBuffers>& target = swapping ? pendingBuffers : activeBuffers;
+            // room for the splats that training adds over the next snapshots
+            const uint32_t loadedPoints = loader->model().numPoints;
+            if (!target) target = std::make_unique<SplatBuffers>(loadedPoints, snapshotWatcher ? loadedPoints / 4 : 0);
+
+            // at most one batch per frame to keep the frame time flat
+            target->uploadUntil(loader->model(), std::min(loader->processedCount(), target->residentCount + UPLOAD_BATCH_SIZE));
+
+            if (loader->finished() && target->complete()) {
+                // the BVH and a snapshot diff point into the model they were started for
+                cancelBvh();
+                if (snapshotWatcher) snapshotWatcher->cancel();
+                splatBvh.reset();
+                splatEditor.reset();
+                editSelection.clear();
+                pickedSplat = SplatHit();
+                hasPreviousPick = false;
+
+                splatModel = loader->takeModel();
+                splatEditor = std::make_unique<SplatEditor>(*splatModel);
+                cpuProjectionModel = nullptr;
+                std::cout << "Loaded " << loader->file() << " (" << splatModel->numPoints << " splats) in " << loader->loadSeconds() << " s" << std::endl;
+                loader.reset();
+
+                buildBvh();
+
+                if (swapping) {
+                    activeBuffers = std::move(pendingBuffers);
+                    occlusionCuller.reset();
+                    swapping = false;
+                    std::cout << "Model swapped, worst frame time during the swap: " << worstSwapFrameTime * 1000.0f << " ms" << std::endl;
+                }
+            }
+        }
+        if (swapping) worstSwapFrameTime = std::max(worstSwapFrameTime, deltaTime);
+
+        if (bvhJob && bvhJob->done()) {
+            splatBvh = std::move(pendingBvh);
+            bvhJob.reset();
+            std::cout << "Built the BVH of " << splatModel->numPoints << " splats (" << splatBvh->nodes().size() << " nodes, "
+                << splatBvh->memoryBytes() / (1024.0f * 1024.0f) << " MB) in "
+                << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - bvhStart).count() << " ms" << std::endl;
+        }
 
-        ImGui::Text("Hello there!");
-        static float testVar = 0.f;
-        ImGui::SliderFloat("Slider", &testVar, 0.0f, 1.0f);
+        // snapshots of a watched training run: the newest one is parsed and diffed in the background, then its
+        // changed, appended and removed splats are applied to the resident model and only they are uploaded
+        if (snapshotWatcher && splatModel && !loader) {
+            snapshotWatcher->poll(*splatModel, currentFrame);
+
+            // the BVH build reads the arrays the delta swaps
+            if (snapshotWatcher->ready() && !bvhJob) {
+                const std::string file = snapshotWatcher->pendingFile();
+                std::unique_ptr<SnapshotDelta> delta = snapshotWatcher->takeDelta();
+                if (!delta) {
+                    std::cerr << "Could not read snapshot " << file << std::endl;
+                } else {
+                    auto applyStart = std::chrono::steady_clock::now();
+                    applySnapshotDelta(*splatModel, *delta);
+                    const uint32_t count = splatModel->numPoints;
+                    if (count > activeBuffers->capacity) {
+                        // outgrew the spare capacity: new buffers with room for the next snapshots, uploaded at once
+                        activeBuffers = std::make_unique<SplatBuffers>(count, count / 4);
+                        activeBuffers->uploadUntil(*splatModel, count);
+                        snapshotBytes = static_cast<size_t>(count) * (sizeof(glm::mat4) + sizeof(glm::vec4) + 3 * sizeof(float));
+                        occlusionCuller.reset();
+                    } else {
+                        snapshotBytes = activeBuffers->updateRanges(*splatModel, delta->ranges);
+                        snapshotBytes += activeBuffers->resize(*splatModel);
+                    }
+
+                    // the edits of the previous snapshot are gone; the BVH follows changed splats, new indices need a new one
+                    splatEditor = std::make_unique<SplatEditor>(*splatModel);
+                    editSelection.clear();
+                    cpuProjectionModel = nullptr;
+                    if (delta->previousCount == count && splatBvh) {
+                        splatBvh->refit(delta->changed);
+                    } else {
+                        splatBvh.reset();
+                        pickedSplat = SplatHit();
+                        hasPreviousPick = false;
+                        buildBvh();
+                    }
+                    // the previous arrays
+                    delta->model.reset();
+                    snapshotApplyTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - applyStart).count();
+
+                    std::cout << "Snapshot " << delta->file << ": " << delta->changed.size() << " changed, " << delta->appended() << " appended, "
+                        << delta->removed() << " removed of " << count << " splats, " << snapshotBytes / (1024.0f * 1024.0f) << " MB uploaded; "
+                        << "parsed in " << delta->parseSeconds << " s and diffed in " << delta->diffSeconds * 1000.0f << " ms in the background, "
+                        << "applied in " << snapshotApplyTime << " ms" << std::endl;
+                    lastSnapshot = std::move(delta);
+                }
+            }
+        }
+        // the resident model is read by the snapshot diff until it is applied
+        const bool snapshotPending = snapshotWatcher && snapshotWatcher->busy();
+
+        // lazy compaction of the deleted splats: every index changes, so the model is uploaded again and the
+        // BVH rebuilt in the background
+        if (splatEditor && !loader && !snapshotPending && (compactSplats || splatEditor->needsCompaction())) {
+            compactSplats = false;
+            if (splatEditor->deletedCount() > 0) {
+                cancelBvh();
+                splatBvh.reset();
+                editSelection.clear();
+                pickedSplat = SplatHit();
+                hasPreviousPick = false;
+
+                auto compactStart = std::chrono::steady_clock::now();
+                const uint32_t removed = splatEditor->deletedCount();
+                splatEditor->compact();
+                activeBuffers->reupload(*splatModel);
+                cpuProjectionModel = nullptr;
+                occlusionCuller.reset();
+                std::cout << "Compacted " << removed << " deleted splats, " << splatModel->numPoints << " left, in "
+                    << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - compactStart).count() << " ms" << std::endl;
+
+                buildBvh();
+            }
+        }
 
-        //imgui end
-        ImGui::End();
+        const uint32_t numSplats = activeBuffers ? activeBuffers->residentCount : 0;
 
         // input
         // -----
-        processInput(window);
+        if (window) processInput(window);
+
+        // fixed timestep, independent of how long the frames take
+        const bool replayFrameActive = replaying && activeBuffers && activeBuffers->complete() && !loader;
+        if (replayFrameActive) {
+            replayPath.sample(replayFrame * replayTimestep).apply(camera);
+            deltaTime = replayTimestep;
+        }
+
+        if (!recordFile.empty()) {
+            if (recordStart < 0.0f) recordStart = currentFrame;
+            recordPath.record(currentFrame - recordStart, camera);
+        }
 
-        // model matrix
-        glm::mat4 model = glm::mat4(1.0f);
-        // camera/view transformation
-        glm::mat4 view = camera.GetViewMatrix();
-        // projection matrix
+        // camera/view and projection transformation
         float aspectRatio =  (float)curScreenWidth / (float)curScreenHeight;
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), aspectRatio, camera.Near, camera.Far);
+        SplatView splatView = SplatView::fromCamera(camera, aspectRatio);
+
+        // picking: the ray through the clicked pixel, then the region queries around the point it hit
+        const bool mouseDown = !headless && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (splatBvh && cursorIsVisible && mouseDown && !mouseWasDown && !ImGui::GetIO().WantCaptureMouse) {
+            double cursorX, cursorY;
+            int windowWidth, windowHeight;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            const float ndcX = static_cast<float>(cursorX / std::max(windowWidth, 1)) * 2.0f - 1.0f;
+            const float ndcY = 1.0f - static_cast<float>(cursorY / std::max(windowHeight, 1)) * 2.0f;
+
+            const glm::mat4 toWorld = glm::inverse(splatView.projection * splatView.view);
+            const glm::vec4 nearPoint = toWorld * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+            const glm::vec4 farPoint = toWorld * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+            const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+            const glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+            auto queryStart = std::chrono::steady_clock::now();
+            const SplatHit hit = splatBvh->pick(origin, direction, pickMinAlpha);
+            if (hit.index != NO_SPLAT) {
+                if (pickedSplat.index != NO_SPLAT) {
+                    previousPickedPoint = pickedPoint;
+                    hasPreviousPick = true;
+                }
+                pickedSplat = hit;
+                pickedPoint = origin + hit.distance * direction;
+
+                std::vector<uint32_t> region;
+                splatBvh->querySphere(pickedPoint, pickRadius, region);
+                splatsInSphere = region.size();
+                editSelection.clear();
+                for (uint32_t splat : region) {
+                    if (!splatEditor->isDeleted(splat)) editSelection.push_back(splat);
+                }
+                region.clear();
+                splatBvh->queryBox(pickedPoint - pickRadius, pickedPoint + pickRadius, region);
+                splatsInBox = region.size();
+            }
+            nearestToCamera = splatBvh->nearest(camera.Position, pickMinAlpha, std::numeric_limits<float>::infinity(), &nearestToCameraDistance);
+            pickTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+        }
+        mouseWasDown = mouseDown;
+
+        // edits of the selection, around the picked point: the covariances of the changed splats are rebuilt,
+        // their ranges uploaded and the BVH refitted, independent of the size of the model
+        if (transformSelection || recolorSelection || deleteSelection) {
+            if (splatEditor && splatBvh && !loader && !snapshotPending && !editSelection.empty()) {
+                auto editStart = std::chrono::steady_clock::now();
+                if (transformSelection) {
+                    splatEditor->transform(editSelection, pickedPoint, axisAngleQuaternion(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(editAngle)),
+                        editScale, editTranslation);
+                    pickedPoint += editTranslation;
+                }
+                if (recolorSelection) splatEditor->recolor(editSelection, editColor);
+                if (deleteSelection) {
+                    splatEditor->remove(editSelection);
+                    editSelection.clear();
+                    pickedSplat = SplatHit();
+                }
 
-        glm::mat4 mvp = projection * view * model; 
-        
-        float right = glm::tan(camera.Fov / 2) * camera.Near;
-        float top = right * (1 / aspectRatio);
+                const std::vector<SplatRange> ranges = splatEditor->takeDirtyRanges();
+                editBytes = activeBuffers->updateRanges(*splatModel, ranges);
+                editRanges = ranges.size();
+                splatBvh->refit(splatEditor->lastDirtySplats());
+                cpuProjectionModel = nullptr;
+                editTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - editStart).count();
+            }
+            transformSelection = false;
+            recolorSelection = false;
+            deleteSelection = false;
+        }
 
-        // activate the shader and bind the SSBOs to binding points
-        covShader.use();
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, inputCovSSBO);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, outputCovSSBO);
-        
-        // set frame specific uniforms
-        covShader.setMat4("view", view);
-        covShader.setFloat("near", camera.Near);
-        covShader.setMat4("mvp", mvp);
+        // fast camera motion is drawn as point sprites, the tiles are rasterized again once the camera stopped
+        const bool cameraMoving = cameraMotion.update(splatView.view, replayFrameActive ? replayFrame * replayTimestep : currentFrame);
+        const bool previewFrame = motionPreview && cameraMoving && numSplats > 0;
 
-        covShader.setFloat("screenRightCoord", right);
-        covShader.setFloat("screenTopCoord", top);
-        
-        // start computations
-        glDispatchCompute(splatModel->covAndPos.size(), 1, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        
-        // read the data from GPU
-        std::vector<OutputData> outputData(splatModel->covAndPos.size());
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, outputCovSSBO);
-        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, splatModel->covAndPos.size() * sizeof(OutputData), outputData.data());
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        // rendered tiles and quality settings of this frame
+        const QualityLevel& quality = qualityController.settings();
+        const TileGrid tileGrid = qualityController.tileGrid();
 
-        std::vector<std::tuple<uint32_t, uint32_t>> keyAndIndex;
+        // renders this view with both blend modes and prints the difference, before the frame's own projection
+        // because every project() compacts the visible splats in a new order
+        if (compareBlending) {
+            compareBlending = false;
+            if (numSplats > 0) compareBlendModes(*renderer, *activeBuffers, numSplats, splatView, tileGrid, quality);
+        }
 
-        // for drawing eigen vectors and bounding boxes
-        std::vector<EigenData> eigenData;
+        // the CPU side of the frame is a small job graph: the CPU projection check runs while the GPU projects
+        // and the results are read back
+        JobSystem& jobs = JobSystem::global();
+
+        // the same view projected on the CPU, matched splat by splat; only for the fully resident model
+        JobHandle cpuProjectionJob;
+        const bool checkProjection = validateProjection && numSplats > 0 && !previewFrame && splatModel && numSplats == splatModel->numPoints;
+        if (checkProjection) {
+            if (cpuProjectionModel != splatModel.get()) {
+                cpuProjector.reset();
+                cpuSplats = std::make_unique<SplatSoA>(splatModel->covAndPos, splatModel->colorAndOpacity, splatModel->numPoints);
+                cpuProjector = std::make_unique<CpuProjector>(*cpuSplats);
+                cpuProjectionModel = splatModel.get();
+            }
 
-        // std::cout << std::bitset<16>(0) << std::bitset<16>(0xFFFFFFFF) << std::endl;
-        
+            cpuProjectionJob = jobs.submit([&, numSplats, splatView, tileGrid, alphaCutoff = quality.alphaCutoff]() {
+                auto cpuStart = std::chrono::steady_clock::now();
+                cpuProjector->project(numSplats, splatView, tileGrid, alphaCutoff);
+                cpuProjectionTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+            });
+        }
 
-        for (uint32_t k = 0; k < outputData.size(); k++) {
-            const OutputData& data = outputData[k];
-            if (data.topCorner.x != -1) {
-                for (int j = data.botCorner.y; j <= data.topCorner.y; j++) {
-                    for (int i = data.botCorner.x; i <= data.topCorner.x; i++) {
-                        uint32_t index = static_cast<uint32_t>(j * 50 + i); // hardcoded blocks
-                        
-                        // map to maximum uint range knowing that depth is [0,1]
-                        uint16_t uintDepth = static_cast<uint16_t>(data.position.z * 0xFFFF);
-
-                        uint32_t key = index << 16;
-                        key = key | static_cast<uint32_t>(uintDepth);
-                        keyAndIndex.push_back(std::tuple<uint32_t, uint32_t>(key, k));
-                        // std::cout << std::bitset<32>(key) << std::endl;
+        // only the visible splats come back, compacted by splat_covariances.cs
+        FrameVector<OutputData> outputData = frameAllocator.vector<OutputData>();
+        uint32_t numVisible = 0;
 
-                    }
-                }
+        if (numSplats > 0 && !previewFrame) {
+            auto projectionStart = std::chrono::steady_clock::now();
+            numVisible = renderer->project(*activeBuffers, numSplats, splatView, tileGrid, quality.alphaCutoff);
+            outputData.resize(numVisible);
+            renderer->readOutputData(*activeBuffers, numVisible, outputData.data());
+            stageTimings.projection = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - projectionStart).count();
+        }
+
+        if (checkProjection) {
+            FrameVector<ProjectedSplat> gpuProjected = frameAllocator.vector<ProjectedSplat>();
+            gpuProjected.resize(numVisible);
+            renderer->readProjected(*activeBuffers, numVisible, gpuProjected.data());
+            jobs.wait(cpuProjectionJob);
+            projectionDifference = compareProjections(outputData.data(), gpuProjected.data(), numVisible,
+                cpuProjector->outputData(), cpuProjector->projected(), cpuProjector->visibleCount(), numSplats);
+
+            // splats right at the culling borders may go either way
+            if (projectionDifference.unmatched > numVisible / 1000 || projectionDifference.maxConicError > 1e-2f) {
+                std::cerr << "CPU and GPU projection disagree (" << projectionDifference.countA << " vs " << projectionDifference.countB
+                    << " visible, " << projectionDifference.unmatched << " unmatched, max relative conic error "
+                    << projectionDifference.maxConicError << ")" << std::endl;
+            }
+        }
+
+        // the tile counters cost a few atomics per tile, only the sorted rasterization has them
+        const bool collectTileStats = (showTileHeatmap || tileStatsLog.isOpen()) && blendMode == BlendMode::Sorted;
+        renderer->setTileStats(collectTileStats);
+
+        // gaussian indices sorted firstly by tileID and secondly by z-depth,
+        // ranges tell where the indices of a specified tile start and end
+        const BinningMode frameBinningMode = blendMode == BlendMode::WeightedBlended ? BinningMode::Unsorted : binningMode;
+
+        // the tiles that saturated in the previous frame, reprojected to this view; needs depth sorted blending
+        const bool cullOccluded = occlusionCulling && blendMode == BlendMode::Sorted && numSplats > 0 && !previewFrame;
+        if (!cullOccluded) occlusionCuller.reset();
+        const glm::mat4 viewProjection = splatView.projection * splatView.view;
+
+        auto binningStart = std::chrono::steady_clock::now();
+        const TileOccluders* occluders = cullOccluded ? occlusionCuller.reproject(viewProjection, tileGrid) : nullptr;
+        TileBins bins = binTiles(frameBinningMode, outputData.data(), numVisible, frameAllocator.current(), tileGrid, occluders, largeSplatTiles);
+        binningTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - binningStart).count();
+        stageTimings.binning = binningTime;
+
+        if (validateBinning && frameBinningMode != BinningMode::Unsorted) {
+            TileBins reference = binTiles(
+                binningMode == BinningMode::SortKeys ? BinningMode::CountingSort : BinningMode::SortKeys,
+                outputData.data(), numVisible, frameAllocator.current(), tileGrid, occluders, largeSplatTiles);
+            if (reference.ranges != bins.ranges || reference.sortedIndices != bins.sortedIndices || reference.largeSplats != bins.largeSplats) {
+                std::cerr << "Binning engines disagree (" << bins.sortedIndices.size() << " vs " << reference.sortedIndices.size() << " entries)" << std::endl;
             }
+        }
 
-            //for drawing eigen vectors and bounding boxes
-            eigenData.push_back(EigenData{data.majorEigenVec, data.minorEigenVec});
+        const FrameVector<uint32_t>& ranges = bins.ranges;
+        const FrameVector<uint32_t>& sortedIndices = bins.sortedIndices;
+
+        visibleFraction = numSplats > 0 ? static_cast<float>(numVisible) / numSplats : 0.0f;
+        bytesMoved = static_cast<float>(sizeof(uint32_t) + numVisible * sizeof(OutputData) + (ranges.size() + sortedIndices.size()) * sizeof(uint32_t)
+            + bins.largeSplats.size() * (sizeof(uint32_t) + sizeof(glm::ivec4)));
+        duplicationFactor = numVisible > 0 ? static_cast<float>(sortedIndices.size()) / numVisible : 0.0f;
+        numLargeSplats = static_cast<uint32_t>(bins.largeSplats.size());
+        largeEntries = bins.largeEntries;
+        occludedFraction = bins.occludedEntries > 0 ? static_cast<float>(bins.occludedEntries) / (bins.occludedEntries + sortedIndices.size()) : 0.0f;
+
+        // the same frame without the occlusion culling as the reference, rendered first so that the culled frame
+        // is the one shown and the one whose saturation is kept
+        const bool checkOcclusion = occlusionErrorCheck && occluders;
+        bool unculledRendered = false;
+        if (checkOcclusion) {
+            TileBins unculled = binTiles(frameBinningMode, outputData.data(), numVisible, frameAllocator.current(), tileGrid, nullptr, largeSplatTiles);
+            unculledRendered = renderer->rasterize(*activeBuffers, unculled, tileGrid, quality.alphaCutoff, quality.maxSplatsPerTile, blendMode);
+            if (unculledRendered) renderer->readImage(tileGrid, unculledImage);
         }
-        
 
         // check if any gaussians are visible to the camera
-        if (keyAndIndex.size() != 0) {
-            
-            
-            std::sort(keyAndIndex.begin(), keyAndIndex.end(), 
-            [](std::tuple<uint32_t, int> const &a, std::tuple<uint32_t, int> const &b){
-                return std::get<0>(a) < std::get<0>(b);
+        if (numSplats > 0 && !previewFrame && renderer->rasterize(*activeBuffers, bins, tileGrid, quality.alphaCutoff, quality.maxSplatsPerTile, blendMode)) {
+            gatherTime = renderer->gatherTime;
+            rasterTime = renderer->rasterTime;
+            stageTimings.gather = gatherTime;
+            stageTimings.raster = rasterTime;
+
+            if (cullOccluded) {
+                renderer->readTileSaturation(tileGrid, tileSaturation);
+                occlusionCuller.update(tileSaturation, tileGrid, viewProjection);
+            }
+            if (collectTileStats) {
+                renderer->readTileStats(tileGrid, tileStats);
+                tileStatsSummary = summarizeTileStats(tileStats);
+                tileStatsLog.write(tileStatsFrame++, tileGrid, tileStats);
+                if (showTileHeatmap) {
+                    tileHeatmap(tileStats, static_cast<TileMetric>(tileHeatmapMetric), tileHeatmapPixels);
+                    glBindTexture(GL_TEXTURE_2D, tileHeatmapTexture);
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tileGrid.x, tileGrid.y, GL_RGBA, GL_UNSIGNED_BYTE, tileHeatmapPixels.data());
                 }
-            );
-            
-            // vector where index i tells the starting index of gaussian indices in sortedIndices vector
-            // and i+1 tells the ending index
-            std::vector<uint32_t> ranges(50 * 50 + 1, 0);
-            
-            // a vector of gaussian indices sorted firstly by tileID and secondly by z-depth  
-            // Indices in ranges tell where the indices of a specified tile start and end 
-            std::vector<uint32_t> sortedIndices;
-
-            
-            uint16_t prevTileIdx = std::get<0>(keyAndIndex[0]) >> 16; //
-            for (uint32_t i = 0; i < keyAndIndex.size(); i++) {
-                uint16_t curTileIdx = std::get<0>(keyAndIndex[i]) >> 16;
-                uint32_t gaussianIndex = std::get<1>(keyAndIndex[i]);
-                if (prevTileIdx != curTileIdx) {
-                    for (uint16_t j = prevTileIdx + 1; j <= curTileIdx; j++) {
-                        ranges[j] = i;
-                    }
-                    prevTileIdx = curTileIdx;
+            }
+            if (checkOcclusion) {
+                renderer->readImage(tileGrid, culledImage);
+                if (unculledRendered) {
+                    ImageError error = compareImages(culledImage, unculledImage);
+                    occlusionCheckedFrames++;
+                    if (error.maxAbs > 0.0) occlusionDifferentFrames++;
+                    occlusionMinPsnr = std::min(occlusionMinPsnr, error.psnr);
+                    occlusionMaxError = std::max(occlusionMaxError, error.maxAbs);
                 }
-                sortedIndices.push_back(gaussianIndex);
-            }
-            
-            for (uint16_t j = prevTileIdx + 1; j < ranges.size(); j++) {
-                ranges[j] = keyAndIndex.size();
-            }
-            
-            // load ranges to GPU --> reserve SSBO
-            // load sorted indices to GPU -->
-            // the gaussians themselves are already in the GPU
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeSSBO);
-            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, ranges.size() * sizeof(uint32_t), ranges.data());
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, gIndicesSSBO);
-            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sortedIndices.size() * sizeof(uint32_t), sortedIndices.data());
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-            processPixelsShader.use();
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, outputCovSSBO);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rangeSSBO);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, gIndicesSSBO);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, colorAndOpacitySSBO);
-            
-
-            // start computations
-            glDispatchCompute(50, 50, 1);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT || GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+
+            // every tile reads one ProjectedSplat per entry as a contiguous block
+            // (before: an index plus scattered reads of the covariance, position and color of every entry)
+            uint32_t nonEmptyTiles = 0;
+            for (uint32_t t = 0; t + 1 < ranges.size(); t++) {
+                if (ranges[t + 1] > ranges[t]) nonEmptyTiles++;
+            }
+            bytesPerTile = static_cast<float>(sortedIndices.size() * sizeof(ProjectedSplat)) / std::max(1u, nonEmptyTiles);
 
             // render image to quad
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -464,36 +1208,37 @@ int main()
             glBindVertexArray(quadVAO);
 
             quadShader.setInt("tex", 0);
+            quadShader.setBool("overlay", false);
+            // stretch the rendered part of the texture over the window
+            quadShader.setVec2("texScale", tileGrid.x * 16.0f / TEXTURE_WIDTH, tileGrid.y * 16.0f / TEXTURE_HEIGHT);
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texture);
+            glBindTexture(GL_TEXTURE_2D, renderer->texture);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
-
-        // render pointcloud on top of model
-        // ------------------------------------------------
-
-        glBindBuffer(GL_UNIFORM_BUFFER, eigenUBO);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(eigenData) * eigenData.size(), eigenData.data());
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-        
-        // ------------------------------------------------
 
+            // one texel per tile blended over the image
+            if (showTileHeatmap && collectTileStats) {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                quadShader.setBool("overlay", true);
+                quadShader.setVec2("texScale", static_cast<float>(tileGrid.x) / NUM_TILES_X, static_cast<float>(tileGrid.y) / NUM_TILES_Y);
+                glBindTexture(GL_TEXTURE_2D, tileHeatmapTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glDisable(GL_BLEND);
+            }
 
-        // pointcloudShader.use();
+            if (!firstFrameRendered) {
+                firstFrameRendered = true;
+                float sinceStart = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+                std::cout << "Time to first frame: " << sinceStart * 1000.0f << " ms (" << numSplats << " splats resident)" << std::endl;
+            }
+        }
 
-        // glBindBufferBase(GL_UNIFORM_BUFFER, 0, eigenUBO);
+        // the preview at the resolution of the window; of the quality level only the alpha cutoff applies
+        if (previewFrame) {
+            pointPreview.draw(*activeBuffers, numSplats, splatView, curScreenWidth, curScreenHeight, quality.alphaCutoff);
+        }
 
-        
-        // model = glm::mat4(1.0f);
-        
-        // mvp = projection * view * model; 
-        
-        // pointcloudShader.setMat4("mvp", mvp);
-        
-        // glBindVertexArray(pcVAO);
-        // glDrawArrays(GL_POINTS, 0, splatModel->position.size());
-        
         // draw grid lines------------------------------------------------
         
 
@@ -510,18 +1255,87 @@ int main()
 
         // imgui: render
         // ------------
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (!headless) {
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        if (window) glfwSwapBuffers(window);
+
+        // the preview frames say nothing about the cost of the rasterization the controller tunes
+        const float frameTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        if (!previewFrame) qualityController.update(frameTime, stageTimings);
+        if (motionPreview) modeTimes.add(previewFrame, frameTime);
+
+        if (replayFrameActive) {
+            // wait for the GPU so the frame time covers all of the frame's work
+            glFinish();
+            replayFrameTimes.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            if (motionPreview) (previewFrame ? replayPreviewFrameTimes : replayFullFrameTimes).push_back(replayFrameTimes.back());
+            if (!previewFrame) {
+                replayRasterFrames++;
+                replayVisibleFraction += visibleFraction;
+                replayBytesMoved += bytesMoved;
+                replayOccludedFraction += occludedFraction;
+                replaySortKeys += sortedIndices.size();
+                replayLargeEntries += largeEntries;
+                replayMaxSortKeys = std::max(replayMaxSortKeys, sortedIndices.size());
+            }
+
+            if (++replayFrame >= replayFrames) {
+                std::cout << "Replayed " << replayFile << " at a " << replayTimestep * 1000.0f << " ms timestep" << std::endl;
+                printFrameTimeSummary(summarizeFrameTimes(replayFrameTimes));
+                const uint32_t rasterFrames = std::max(1u, replayRasterFrames);
+                if (motionPreview) {
+                    std::cout << "Point preview while moving (" << replayFrames - replayRasterFrames << " frames):" << std::endl;
+                    printFrameTimeSummary(summarizeFrameTimes(replayPreviewFrameTimes));
+                    std::cout << "Tile rasterization (" << replayRasterFrames << " frames, the statistics below are per rasterized frame):" << std::endl;
+                    printFrameTimeSummary(summarizeFrameTimes(replayFullFrameTimes));
+                }
+                std::cout << "Visible " << replayVisibleFraction / rasterFrames * 100.0 << "% of the splats, "
+                    << replayBytesMoved / rasterFrames / (1024.0 * 1024.0) << " MB read back and uploaded per frame (without compaction "
+                    << static_cast<double>(numSplats) * sizeof(OutputData) / (1024.0 * 1024.0) << " MB of footprints)" << std::endl;
+                std::cout << "Sort keys per frame: mean " << replaySortKeys / rasterFrames << ", max " << replayMaxSortKeys
+                    << "; large splats (over " << largeSplatTiles << " tiles) saved " << replayLargeEntries / rasterFrames << " keys per frame" << std::endl;
+                if (occlusionCulling) {
+                    std::cout << "Occlusion culling dropped " << replayOccludedFraction / rasterFrames * 100.0 << "% of the tile keys" << std::endl;
+                }
+                if (occlusionErrorCheck) {
+                    std::cout << "Against unculled frames (the frame times include them): " << occlusionDifferentFrames << " of "
+                        << occlusionCheckedFrames << " frames differ, min PSNR " << occlusionMinPsnr << " dB, max error "
+                        << occlusionMaxError << std::endl;
+                }
+                JobSystem::global().printStats();
+                quit = true;
+            }
+        }
+    }
+
+    if (!recordFile.empty() && recordPath.save(recordFile)) {
+        std::cout << "Recorded " << recordPath.keyframes.size() << " keyframes (" << recordPath.duration() << " s) to " << recordFile << std::endl;
     }
 
+    cancelBvh();
+
+    // release the GPU resources while the context is still alive
+    glDeleteTextures(1, &tileHeatmapTexture);
+    if (headlessFBO) {
+        glDeleteFramebuffers(1, &headlessFBO);
+        glDeleteRenderbuffers(2, headlessRenderbuffers);
+    }
+    loader.reset();
+    activeBuffers.reset();
+    pendingBuffers.reset();
+    renderer.reset();
+
     // imgui: terminate
     // ----------------
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -542,7 +1356,7 @@ void processInput(GLFWwindow *window)
         glfwSetWindowShouldClose(window, true);
     }
 
-    if (!cursorIsVisible) {
+    if (!cursorIsVisible && !replaying) {
         // move player
         if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
             camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -595,7 +1409,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-    if (!cursorIsVisible) {
+    if (!cursorIsVisible && !replaying) {
         float xpos = static_cast<float>(xposIn);
         float ypos = static_cast<float>(yposIn);
 
@@ -623,4 +1437,67 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     if (!cursorIsVisible) {
         camera.ProcessMouseScroll(static_cast<float>(yoffset));
     }
-}
\ No newline at end of file
+}
+// command line numbers: the whole argument has to be a number in the range of the type
+// -------------------------------------------------------------------------------------
+bool parseNumber(const char* text, float& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    const float parsed = std::strtof(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)) return false;
+    value = parsed;
+    return true;
+}
+
+bool parseNumber(const char* text, int& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    const long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+int invalidNumber(const std::string& option, const char* value, const char* program)
+{
+    std::cout << option << " expects a number, not " << value << std::endl;
+    printUsage(program);
+    return -1;
+}
+
+void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [model.ply] [options]\n"
+        "  --morton                   sort the splats along a Morton curve at load time\n"
+        "  --record file              write the camera path to file on exit\n"
+        "  --replay file              replay a recorded camera path and print the frame times\n"
+        "  --timestep s               timestep of the replay\n"
+        "  --headless                 replay without showing a window\n"
+        "  --target-ms ms             adapt the quality to this frame time\n"
+        "  --quality-log file.csv     write the decisions of the quality controller\n"
+        "  --weighted                 weighted blended transparency instead of sorted blending\n"
+        "  --occlusion                drop the splats behind saturated tiles\n"
+        "  --occlusion-error          also render without culling and report the difference\n"
+        "  --large-tiles n            tiles from which a splat is merged at rasterization, 0 bins every splat\n"
+        "  --tile-stats file.csv      write the workload of every tile\n"
+        "  --jobs n                   worker threads, 0 runs every job on the render thread\n"
+        "  --motion-preview           draw point sprites while the camera moves\n"
+        "  --watch dir                follow the PLY snapshots of a training run\n"
+        "  --watch-tolerance t        change below which a splat is not uploaded again\n"
+        "  --cameras cameras.json     render every view of a 3DGS cameras.json and exit\n"
+        "  --images dir               compare the views to their training images\n"
+        "  --output dir               write the views as PNG\n"
+        "  --batch-threads n          views processed together\n"
+        "  --shards n                 render the views or the replay with n worker processes\n"
+        "  --shard-remote n           also wait for n workers started elsewhere\n"
+        "  --shard-address address    unix:/path or tcp:host:port of the coordinator\n"
+        "  --shard-scene file         where the scene file for the workers is written\n"
+        "  --shard-band-rows n        tile rows per task\n"
+        "  --shard-frames             whole frames as tasks\n"
+        "  --shard-scaling            report the scaling from one worker on\n"
+        "  --shard-worker address     run as a worker of the coordinator at address\n"
+        "  --resolution WxH           frame size of a sharded replay\n"
+        "  --egl                      render without a window, with a surfaceless EGL context" << std::endl;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <cstdint>
+
+#include "core/job_system.h"
+
+// Spreads the lower 21 bits of v so that there are two zero bits between each of them.
+inline uint64_t expandBits21(uint64_t v) {
+    v &= 0x1FFFFF;
+    v = (v | v << 32) & 0x1F00000000FFFFull;
+    v = (v | v << 16) & 0x1F0000FF0000FFull;
+    v = (v | v << 8)  & 0x100F00F00F00F00Full;
+    v = (v | v << 4)  & 0x10C30C30C30C30C3ull;
+    v = (v | v << 2)  & 0x1249249249249249ull;
+    return v;
+}
+
+// 63 bit Morton code of a point quantized to a 2^21 grid in each dimension
+inline uint64_t mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    return expandBits21(x) | (expandBits21(y) << 1) | (expandBits21(z) << 2);
+}
+
+// Returns the permutation that sorts the points (xyz interleaved) along a 3D Morton curve inside
+// their bounding box. Codes are computed and sorted in parallel chunks which are then merged pairwise.
+inline std::vector<uint32_t> mortonOrder(const std::vector<float>& position, uint32_t numPoints) {
+    std::vector<uint32_t> order(numPoints);
+    std::iota(order.begin(), order.end(), 0);
+    if (numPoints < 2) return order;
+
+    float lo[3] = { position[0], position[1], position[2] };
+    float hi[3] = { position[0], position[1], position[2] };
+    for (uint32_t i = 1; i < numPoints; i++) {
+        for (int a = 0; a < 3; a++) {
+            lo[a] = std::min(lo[a], position[3 * i + a]);
+            hi[a] = std::max(hi[a], position[3 * i + a]);
+        }
+    }
+
+    const float gridMax = static_cast<float>((1 << 21) - 1);
+    float toGrid[3];
+    for (int a = 0; a < 3; a++) {
+        toGrid[a] = hi[a] > lo[a] ? gridMax / (hi[a] - lo[a]) : 0.0f;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> codes(numPoints);
+
+    JobSystem& jobs = JobSystem::global();
+    const unsigned int numThreads = std::max(1u, std::min(jobs.concurrency(), numPoints / 4096 + 1));
+    const uint32_t chunk = (numPoints + numThreads - 1) / numThreads;
+
+    // codes, then sort every chunk on its own
+    jobs.parallelChunks(numThreads, [&](size_t t) {
+        uint32_t begin = std::min(numPoints, static_cast<uint32_t>(t) * chunk);
+        uint32_t end = std::min(numPoints, begin + chunk);
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t q[3];
+            for (int a = 0; a < 3; a++) {
+                q[a] = static_cast<uint32_t>((position[3 * i + a] - lo[a]) * toGrid[a]);
+            }
+            codes[i] = { mortonCode(q[0], q[1], q[2]), i };
+        }
+        std::sort(codes.begin() + begin, codes.begin() + end);
+    });
+
+    // merge neighbouring sorted runs until one remains
+    for (uint32_t width = chunk; width < numPoints; width *= 2) {
+        const uint32_t numMerges = (numPoints - width + 2 * width - 1) / (2 * width);
+        jobs.parallelChunks(numMerges, [&](size_t m) {
+            uint32_t begin = static_cast<uint32_t>(m) * 2 * width;
+            uint32_t mid = begin + width;
+            uint32_t end = std::min(numPoints, begin + 2 * width);
+            std::inplace_merge(codes.begin() + begin, codes.begin() + mid, codes.begin() + end);
+        });
+    }
+
+    for (uint32_t i = 0; i < numPoints; i++) order[i] = codes[i].second;
+    return order;
+}
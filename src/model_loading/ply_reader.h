@@ -0,0 +1,284 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/job_system.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Reader for binary_little_endian PLY files.
+// The file is memory mapped and the header is parsed once into a fixed-stride property map
+// (byte offset of every vertex property inside a row). extract() then deinterleaves the rows
+// in parallel ranges straight into the destination arrays, in a single pass over the file.
+// Anything the fast path does not handle (ascii, big endian, list properties in the vertex
+// element, non-float attributes) leaves the reader invalid so that the caller can fall back to miniply.
+class BinaryPlyReader {
+public:
+    // float properties written interleaved to dst, i.e. dst[row * names.size() + component]
+    struct Target {
+        std::vector<std::string> names;
+        float* dst;
+    };
+
+    BinaryPlyReader(const std::string& plyFile) {
+        fd = open(plyFile.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+        mappedSize = static_cast<size_t>(st.st_size);
+
+        void* ptr = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            mappedSize = 0;
+            return;
+        }
+        data = static_cast<const uint8_t*>(ptr);
+        // rows are read by all cores at once, so let the kernel start paging in everything
+        madvise(ptr, mappedSize, MADV_WILLNEED);
+
+        isValid = parseHeader();
+    }
+
+    ~BinaryPlyReader() {
+        if (data) munmap(const_cast<uint8_t*>(data), mappedSize);
+        if (fd >= 0) close(fd);
+    }
+
+    BinaryPlyReader(const BinaryPlyReader&) = delete;
+    BinaryPlyReader& operator=(const BinaryPlyReader&) = delete;
+
+    bool valid() const { return isValid; }
+    uint32_t numRows() const { return vertexCount; }
+    uint32_t rowStride() const { return stride; }
+    size_t fileSize() const { return mappedSize; }
+    // bytes of the vertex element, i.e. what extract() actually streams through
+    size_t vertexBytes() const { return static_cast<size_t>(vertexCount) * stride; }
+
+    bool hasFloatProperty(const std::string& name) const {
+        const Property* prop = findProperty(name);
+        return prop && prop->isFloat;
+    }
+
+    // Deinterleaves all targets in one pass. The rows are split into numThreads contiguous ranges, every job
+    // walks its range in blocks of 8 rows, so a block is pulled into cache once for all targets.
+    // numThreads == 0 uses one range per thread of the job system.
+    bool extract(const std::vector<Target>& targets, unsigned int numThreads = 0) const {
+        if (!isValid) return false;
+
+        std::vector<ResolvedTarget> resolved;
+        for (const Target& target : targets) {
+            ResolvedTarget r;
+            r.dst = target.dst;
+            r.numComponents = static_cast<uint32_t>(target.names.size());
+            if (r.numComponents == 0 || r.numComponents > MAX_COMPONENTS) return false;
+
+            for (uint32_t c = 0; c < r.numComponents; c++) {
+                const Property* prop = findProperty(target.names[c]);
+                if (!prop || !prop->isFloat) return false;
+                r.offsets[c] = prop->offset;
+            }
+            resolved.push_back(r);
+        }
+
+        if (numThreads == 0) numThreads = JobSystem::global().concurrency();
+        // no point in splitting tiny files
+        numThreads = std::min<unsigned int>(numThreads, std::max<uint32_t>(1, vertexCount / 4096));
+
+        const uint32_t rowsPerThread = (vertexCount + numThreads - 1) / numThreads;
+        JobSystem::global().parallelChunks(numThreads, [&](size_t t) {
+            uint32_t begin = std::min(vertexCount, static_cast<uint32_t>(t) * rowsPerThread);
+            uint32_t end = std::min(vertexCount, begin + rowsPerThread);
+            extractRange(resolved, begin, end);
+        });
+
+        return true;
+    }
+
+private:
+    static constexpr uint32_t MAX_COMPONENTS = 16;
+    static constexpr uint32_t BLOCK_ROWS = 8;
+
+    struct Property {
+        std::string name;
+        uint32_t offset;
+        bool isFloat;
+    };
+
+    struct ResolvedTarget {
+        float* dst;
+        uint32_t numComponents;
+        uint32_t offsets[MAX_COMPONENTS];
+    };
+
+    int fd = -1;
+    const uint8_t* data = nullptr;
+    size_t mappedSize = 0;
+    bool isValid = false;
+
+    const uint8_t* vertexData = nullptr;
+    uint32_t vertexCount = 0;
+    uint32_t stride = 0;
+    std::vector<Property> properties;
+
+    const Property* findProperty(const std::string& name) const {
+        for (const Property& prop : properties) {
+            if (prop.name == name) return &prop;
+        }
+        return nullptr;
+    }
+
+    static uint32_t typeSize(const std::string& type) {
+        if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+        if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+        if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32") return 4;
+        if (type == "double" || type == "float64") return 8;
+        return 0;
+    }
+
+    bool parseHeader() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+        return false; // rows are copied as is
+#endif
+        const char* endTag = "end_header\n";
+        const size_t searchLimit = std::min<size_t>(mappedSize, 1 << 16);
+        const char* begin = reinterpret_cast<const char*>(data);
+        const char* end = std::search(begin, begin + searchLimit, endTag, endTag + std::strlen(endTag));
+        if (end == begin + searchLimit) return false;
+
+        std::istringstream header(std::string(begin, end));
+        size_t offset = static_cast<size_t>(end - begin) + std::strlen(endTag);
+
+        std::string line;
+        std::getline(header, line);
+        if (line != "ply") return false;
+
+        // bytes taken by the elements in front of the vertex element
+        size_t skipBytes = 0;
+        size_t curCount = 0;
+        uint32_t curStride = 0;
+        bool curFixedSize = true;
+        bool inVertex = false;
+        bool vertexFound = false;
+        bool binaryLE = false;
+
+        auto closeElement = [&]() {
+            if (inVertex) {
+                stride = curStride;
+                vertexFound = true;
+                inVertex = false;
+            } else if (!vertexFound) {
+                if (!curFixedSize) return false;
+                skipBytes += curCount * curStride;
+            }
+            return true;
+        };
+
+        while (std::getline(header, line)) {
+            std::istringstream tokens(line);
+            std::string keyword;
+            tokens >> keyword;
+
+            if (keyword == "format") {
+                std::string format;
+                tokens >> format;
+                binaryLE = format == "binary_little_endian";
+            } else if (keyword == "element") {
+                if (!closeElement()) return false;
+                std::string name;
+                tokens >> name >> curCount;
+                curStride = 0;
+                curFixedSize = true;
+                inVertex = name == "vertex" && !vertexFound;
+                if (inVertex) vertexCount = static_cast<uint32_t>(curCount);
+            } else if (keyword == "property") {
+                std::string type, name;
+                tokens >> type;
+                if (type == "list") {
+                    if (inVertex) return false;
+                    curFixedSize = false;
+                    continue;
+                }
+                tokens >> name;
+                uint32_t size = typeSize(type);
+                if (size == 0) return false;
+                if (inVertex) {
+                    properties.push_back(Property{name, curStride, type == "float" || type == "float32"});
+                }
+                curStride += size;
+            }
+        }
+        if (!closeElement() || !binaryLE || !vertexFound || stride == 0) return false;
+
+        offset += skipBytes;
+        if (offset + static_cast<size_t>(vertexCount) * stride > mappedSize) return false;
+
+        vertexData = data + offset;
+        return true;
+    }
+
+    void extractRange(const std::vector<ResolvedTarget>& targets, uint32_t begin, uint32_t end) const {
+        uint32_t row = begin;
+
+#ifdef __AVX2__
+        // byte offsets of 8 consecutive rows, the gather then picks one property from each of them
+        const __m256i rowOffsets = _mm256_mullo_epi32(
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+            _mm256_set1_epi32(static_cast<int>(stride)));
+
+        alignas(32) float lanes[MAX_COMPONENTS][BLOCK_ROWS];
+
+        for (; row + BLOCK_ROWS <= end; row += BLOCK_ROWS) {
+            const uint8_t* block = vertexData + static_cast<size_t>(row) * stride;
+
+            for (const ResolvedTarget& target : targets) {
+                const uint32_t n = target.numComponents;
+
+                if (n == 1) {
+                    __m256 v = _mm256_i32gather_ps(reinterpret_cast<const float*>(block + target.offsets[0]), rowOffsets, 1);
+                    _mm256_storeu_ps(target.dst + row, v);
+                    continue;
+                }
+
+                for (uint32_t c = 0; c < n; c++) {
+                    __m256 v = _mm256_i32gather_ps(reinterpret_cast<const float*>(block + target.offsets[c]), rowOffsets, 1);
+                    _mm256_store_ps(lanes[c], v);
+                }
+
+                // transpose the lanes back to the interleaved layout of the destination
+                float* dst = target.dst + static_cast<size_t>(row) * n;
+                for (uint32_t r = 0; r < BLOCK_ROWS; r++) {
+                    for (uint32_t c = 0; c < n; c++) {
+                        dst[r * n + c] = lanes[c][r];
+                    }
+                }
+            }
+        }
+#endif
+
+        // scalar path, also handles the tail of the range
+        for (; row < end; row++) {
+            const uint8_t* src = vertexData + static_cast<size_t>(row) * stride;
+
+            for (const ResolvedTarget& target : targets) {
+                float* dst = target.dst + static_cast<size_t>(row) * target.numComponents;
+                for (uint32_t c = 0; c < target.numComponents; c++) {
+                    std::memcpy(dst + c, src + target.offsets[c], sizeof(float));
+                }
+            }
+        }
+    }
+};
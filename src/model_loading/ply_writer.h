@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+#include "model_loading/splat_model.h"
+
+// Writes the given splats of a model as a binary_little_endian PLY file with the properties loadPLY reads.
+// The model is expected to hold the values as they were read from the file, i.e. it was created with
+// processPoints = false and flipY = false, so that the output can be loaded like any trained capture.
+inline bool writeSplatPLY(const std::string& plyFile, const SplatModel& model, const std::vector<uint32_t>& indices) {
+    std::ofstream file(plyFile, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << plyFile << " for writing" << std::endl;
+        return false;
+    }
+
+    static const char* propertyNames[] = {
+        "x", "y", "z",
+        "f_dc_0", "f_dc_1", "f_dc_2",
+        "opacity",
+        "scale_0", "scale_1", "scale_2",
+        "rot_0", "rot_1", "rot_2", "rot_3"
+    };
+    const uint32_t numProperties = sizeof(propertyNames) / sizeof(propertyNames[0]);
+
+    file << "ply\n";
+    file << "format binary_little_endian 1.0\n";
+    file << "element vertex " << indices.size() << "\n";
+    for (uint32_t p = 0; p < numProperties; p++) {
+        file << "property float " << propertyNames[p] << "\n";
+    }
+    file << "end_header\n";
+
+    std::vector<float> rows;
+    rows.reserve(indices.size() * numProperties);
+    for (uint32_t i : indices) {
+        rows.insert(rows.end(), model.position.begin() + 3 * i, model.position.begin() + 3 * i + 3);
+        rows.insert(rows.end(), model.color.begin() + 3 * i, model.color.begin() + 3 * i + 3);
+        rows.push_back(model.opacity[i]);
+        rows.insert(rows.end(), model.scale.begin() + 3 * i, model.scale.begin() + 3 * i + 3);
+        rows.insert(rows.end(), model.rot.begin() + 4 * i, model.rot.begin() + 4 * i + 4);
+    }
+
+    file.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(float));
+    return static_cast<bool>(file);
+}
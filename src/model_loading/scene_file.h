@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "model_loading/splat_model.h"
+
+// Preprocessed scene for renderers in other processes: the covariances and colors of a loaded SplatModel as the
+// SSBOs expect them, so that a process maps the file and uploads it without parsing a PLY or computing anything.
+// All processes of a host that map the file share one copy of it in the page cache.
+//
+// layout: SceneFileHeader, then numSplats covAndPos (mat4) and numSplats colorAndOpacity (vec4), both aligned
+// to SCENE_FILE_ALIGNMENT. Written in host byte order.
+const char SCENE_FILE_MAGIC[8] = {'S', 'P', 'L', 'A', 'T', 'S', 'C', 'N'};
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint64_t SCENE_FILE_ALIGNMENT = 4096;
+
+struct SceneFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSplats;
+    uint64_t covAndPosOffset;
+    uint64_t colorAndOpacityOffset;
+    uint64_t fileSize;
+};
+
+inline uint64_t alignSceneOffset(uint64_t offset) {
+    return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+}
+
+inline bool writeSceneFile(const SplatModel& model, const std::string& file) {
+    SceneFileHeader header;
+    std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.numSplats = model.numPoints;
+    header.covAndPosOffset = alignSceneOffset(sizeof(SceneFileHeader));
+    header.colorAndOpacityOffset = alignSceneOffset(header.covAndPosOffset + static_cast<uint64_t>(model.numPoints) * sizeof(glm::mat4));
+    header.fileSize = header.colorAndOpacityOffset + static_cast<uint64_t>(model.numPoints) * sizeof(glm::vec4);
+
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Could not write " << file << std::endl;
+        return false;
+    }
+
+    const char padding[SCENE_FILE_ALIGNMENT] = {};
+    auto padTo = [&](uint64_t offset) {
+        out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padTo(header.covAndPosOffset);
+    out.write(reinterpret_cast<const char*>(model.covAndPos.data()), static_cast<std::streamsize>(model.numPoints * sizeof(glm::mat4)));
+    padTo(header.colorAndOpacityOffset);
+    out.write(reinterpret_cast<const char*>(model.colorAndOpacity.data()), static_cast<std::streamsize>(model.numPoints * sizeof(glm::vec4)));
+
+    if (!out) {
+        std::cerr << "Could not write " << file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A scene file mapped read only
+class MappedScene {
+public:
+    MappedScene(const std::string& file) {
+        fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Could not open " << file << std::endl;
+            return;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SceneFileHeader)) {
+            std::cerr << file << " is not a scene file" << std::endl;
+            return;
+        }
+        mappedSize = static_cast<size_t>(st.st_size);
+
+        void* ptr = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            std::cerr << "Could not map " << file << std::endl;
+            mappedSize = 0;
+            return;
+        }
+        data = static_cast<const uint8_t*>(ptr);
+
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_FILE_VERSION ||
+            header.fileSize != mappedSize) {
+            std::cerr << file << " is not a scene file of this version" << std::endl;
+            return;
+        }
+        // read front to back by the upload
+        madvise(ptr, mappedSize, MADV_SEQUENTIAL);
+        isValid = true;
+    }
+
+    ~MappedScene() {
+        if (data) munmap(const_cast<uint8_t*>(data), mappedSize);
+        if (fd >= 0) close(fd);
+    }
+
+    MappedScene(const MappedScene&) = delete;
+    MappedScene& operator=(const MappedScene&) = delete;
+
+    bool valid() const { return isValid; }
+    uint32_t numSplats() const { return header.numSplats; }
+    size_t size() const { return mappedSize; }
+
+    const glm::mat4* covAndPos() const { return reinterpret_cast<const glm::mat4*>(data + header.covAndPosOffset); }
+    const glm::vec4* colorAndOpacity() const { return reinterpret_cast<const glm::vec4*>(data + header.colorAndOpacityOffset); }
+
+private:
+    int fd = -1;
+    const uint8_t* data = nullptr;
+    size_t mappedSize = 0;
+    SceneFileHeader header = {};
+    bool isValid = false;
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "core/job_system.h"
+#include "model_loading/splat_model.h"
+#include "model_loading/splat_edits.h"
+
+// A snapshot compared splat by splat with the resident model, see SnapshotWatcher
+struct SnapshotDelta {
+    std::string file;
+    // the snapshot, with the splats that did not change beyond the tolerance set back to their resident values so
+    // that the model applySnapshotDelta() leaves behind is exactly what is on the GPU
+    std::unique_ptr<SplatModel> model;
+    // changed splats below the smaller of both counts, sorted, and merged into ranges for SplatBuffers::updateRanges
+    std::vector<uint32_t> changed;
+    std::vector<SplatRange> ranges;
+    uint32_t previousCount = 0;
+    uint32_t numSplats = 0;
+    float parseSeconds = 0.0f;
+    float diffSeconds = 0.0f;
+
+    uint32_t appended() const { return numSplats > previousCount ? numSplats - previousCount : 0; }
+    uint32_t removed() const { return previousCount > numSplats ? previousCount - numSplats : 0; }
+};
+
+// Follows a training run that writes a PLY snapshot every few thousand iterations, e.g. the
+// point_cloud/iteration_N/point_cloud.ply files of 3DGS. Instead of loading every snapshot as a new model, the
+// newest one is parsed and compared by index with the resident model in a background job, and only the splats
+// that changed by more than the tolerance, were appended or were removed are applied and uploaded.
+//
+// The directory is scanned at most every POLL_SECONDS. A snapshot is taken once its size and time are the same in
+// two scans, so that files still being written are left alone. Training keeps the order of the splats between
+// snapshots (densification appends, pruning removes), so the models must not be Morton sorted.
+//
+// The job owns its state, so cancel() abandons a job that is still parsing instead of waiting for it; only a job
+// that already compares with the resident model is waited for, and it stops within GRAIN splats.
+class SnapshotWatcher {
+public:
+    static constexpr float POLL_SECONDS = 1.0f;
+    // points per job of the processing and of the diff
+    static const uint32_t GRAIN = 16384;
+
+    // tolerance is relative: to 1 for colors and opacities, to the standard deviation of the resident splat
+    // for positions and to its variance for covariances
+    SnapshotWatcher(const std::string& directory, float tolerance, bool flipY = true) :
+        directory(directory),
+        tolerance(tolerance),
+        flipY(flipY)
+    {}
+
+    ~SnapshotWatcher() { cancel(); }
+
+    SnapshotWatcher(const SnapshotWatcher&) = delete;
+    SnapshotWatcher& operator=(const SnapshotWatcher&) = delete;
+
+    const std::string& watchedDirectory() const { return directory; }
+    // the snapshot being parsed and diffed, empty if none
+    const std::string& pendingFile() const { return pending; }
+
+    // the newest PLY file below directory, empty if there is none
+    static std::string newestSnapshot(const std::string& directory) {
+        Snapshot newest;
+        findNewest(directory, newest);
+        return newest.file;
+    }
+
+    // the resident model was loaded from file, which is not applied again
+    void markApplied(const std::string& file) {
+        std::error_code error;
+        applied.file = file;
+        applied.time = std::filesystem::last_write_time(file, error);
+        applied.size = std::filesystem::file_size(file, error);
+    }
+
+    // call once per frame from the render thread. Starts the background job for a new snapshot against the
+    // resident model, which must not change or go away until takeDelta() or cancel()
+    void poll(const SplatModel& resident, float time) {
+        if (job || time - lastPoll < POLL_SECONDS) return;
+        lastPoll = time;
+
+        Snapshot newest;
+        if (!findNewest(directory, newest) || newest == applied) return;
+        if (!(newest == candidate)) {
+            // seen for the first time, it may still be written
+            candidate = newest;
+            return;
+        }
+
+        applied = newest;
+        pending = newest.file;
+        run = std::make_shared<Run>(resident, newest.file, tolerance, flipY);
+        job = JobSystem::global().submitBackground([run = run]() { execute(*run); });
+    }
+
+    // a job is running or its delta has not been taken yet; the resident model must not change
+    bool busy() const { return job != nullptr; }
+    bool ready() const { return job && job->done(); }
+
+    // the delta of the finished job, null if the snapshot could not be read
+    std::unique_ptr<SnapshotDelta> takeDelta() {
+        JobSystem::global().wait(job);
+        std::unique_ptr<SnapshotDelta> delta = run->failed ? nullptr : std::move(run->delta);
+        job.reset();
+        run.reset();
+        pending.clear();
+        return delta;
+    }
+
+    // drops the running job, e.g. before the resident model is replaced. A job still parsing its snapshot is left
+    // to finish on its own, it no longer touches the resident model
+    void cancel() {
+        if (!job) return;
+        run->cancelled = true;
+        if (run->diffing) JobSystem::global().wait(job);
+        job.reset();
+        run.reset();
+        pending.clear();
+    }
+
+private:
+    struct Snapshot {
+        std::string file;
+        std::filesystem::file_time_type time;
+        uintmax_t size = 0;
+
+        bool operator==(const Snapshot& other) const { return file == other.file && time == other.time && size == other.size; }
+    };
+
+    std::string directory;
+    float tolerance;
+    bool flipY;
+
+    float lastPoll = -1e30f;
+    Snapshot applied;
+    Snapshot candidate;
+    std::string pending;
+
+    // everything the job reads and writes, shared with it so that it can outlive the watcher
+    struct Run {
+        const SplatModel& resident;
+        std::string file;
+        float tolerance;
+        bool flipY;
+
+        // the job sets diffing before it reads the resident model and cancel() sets cancelled before it looks at
+        // diffing, so either the job sees the cancel or cancel() waits for the diff
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> diffing{false};
+        std::atomic<bool> failed{false};
+        std::unique_ptr<SnapshotDelta> delta;
+
+        Run(const SplatModel& resident, const std::string& file, float tolerance, bool flipY) :
+            resident(resident), file(file), tolerance(tolerance), flipY(flipY) {}
+    };
+
+    JobHandle job;
+    std::shared_ptr<Run> run;
+
+    // files may appear and disappear while training writes them, errors only skip entries
+    static bool findNewest(const std::string& directory, Snapshot& newest) {
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator it(directory, error), end;
+        for (; !error && it != end; it.increment(error)) {
+            if (it->path().extension() != ".ply") continue;
+            std::error_code entryError;
+            if (!it->is_regular_file(entryError)) continue;
+            const std::filesystem::file_time_type time = it->last_write_time(entryError);
+            const uintmax_t size = it->file_size(entryError);
+            if (entryError) continue;
+            if (newest.file.empty() || time > newest.time || (time == newest.time && it->path().string() > newest.file)) {
+                newest.file = it->path().string();
+                newest.time = time;
+                newest.size = size;
+            }
+        }
+        return !newest.file.empty();
+    }
+
+    // by what the renderer sees: the covariance, position, color and opacity
+    static bool differs(const SplatModel& resident, const SplatModel& snapshot, uint32_t i, float tolerance) {
+        const glm::vec4 color = glm::abs(resident.colorAndOpacity[i] - snapshot.colorAndOpacity[i]);
+        if (std::max(std::max(color.x, color.y), std::max(color.z, color.w)) > tolerance) return true;
+
+        const glm::mat4& a = resident.covAndPos[i];
+        const glm::mat4& b = snapshot.covAndPos[i];
+        const float variance = std::max(std::max(a[0][0], a[1][1]), a[2][2]);
+        if (glm::length(glm::vec3(a[3]) - glm::vec3(b[3])) > tolerance * std::sqrt(variance)) return true;
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                if (std::abs(a[c][r] - b[c][r]) > tolerance * variance) return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename T>
+    static void copyValues(const std::vector<T>& from, std::vector<T>& to, uint32_t i, uint32_t numComponents) {
+        if (from.size() < static_cast<size_t>(i + 1) * numComponents || to.size() < static_cast<size_t>(i + 1) * numComponents) return;
+        std::copy(from.begin() + static_cast<size_t>(i) * numComponents, from.begin() + static_cast<size_t>(i + 1) * numComponents,
+            to.begin() + static_cast<size_t>(i) * numComponents);
+    }
+
+    static void copySplat(const SplatModel& from, SplatModel& to, uint32_t i) {
+        copyValues(from.position, to.position, i, 3);
+        copyValues(from.opacity, to.opacity, i, 1);
+        copyValues(from.scale, to.scale, i, 3);
+        copyValues(from.color, to.color, i, 3);
+        copyValues(from.colorAndOpacity, to.colorAndOpacity, i, 1);
+        copyValues(from.rot, to.rot, i, 4);
+        copyValues(from.covAndPos, to.covAndPos, i, 1);
+    }
+
+    static void execute(Run& run) {
+        using Clock = std::chrono::steady_clock;
+        auto seconds = [](Clock::time_point start) { return std::chrono::duration<float>(Clock::now() - start).count(); };
+        JobSystem& jobs = JobSystem::global();
+
+        auto parseStart = Clock::now();
+        std::unique_ptr<SnapshotDelta> result = std::make_unique<SnapshotDelta>();
+        result->file = run.file;
+        result->model = std::make_unique<SplatModel>(run.file, run.flipY, false, false);
+        SplatModel& snapshot = *result->model;
+        if (!snapshot.loaded || run.cancelled) {
+            run.failed = true;
+            return;
+        }
+        jobs.parallelFor(0, snapshot.numPoints, GRAIN, [&run, &snapshot](size_t b, size_t e) {
+            if (run.cancelled) return;
+            snapshot.processRange(static_cast<uint32_t>(b), static_cast<uint32_t>(e));
+        });
+        result->parseSeconds = seconds(parseStart);
+
+        run.diffing = true;
+        if (run.cancelled) {
+            run.failed = true;
+            return;
+        }
+
+        const SplatModel& resident = run.resident;
+        auto diffStart = Clock::now();
+        result->previousCount = resident.numPoints;
+        result->numSplats = snapshot.numPoints;
+        const uint32_t common = std::min(resident.numPoints, snapshot.numPoints);
+        std::vector<uint8_t> changed(common, 0);
+        jobs.parallelFor(0, common, GRAIN, [&](size_t b, size_t e) {
+            if (run.cancelled) return;
+            for (uint32_t i = static_cast<uint32_t>(b); i < e; i++) {
+                if (differs(resident, snapshot, i, run.tolerance)) changed[i] = 1;
+                else copySplat(resident, snapshot, i);
+            }
+        });
+        if (run.cancelled) {
+            run.failed = true;
+            return;
+        }
+        for (uint32_t i = 0; i < common; i++) {
+            if (changed[i]) result->changed.push_back(i);
+        }
+        result->ranges = mergeSplatRanges(result->changed, SplatEditor::MERGE_GAP);
+        result->diffSeconds = seconds(diffStart);
+
+        run.delta = std::move(result);
+    }
+};
+
+// replaces the resident model by the snapshot of delta in place, so that everything pointing to the model's
+// arrays (a SplatBvh, a SplatEditor) keeps working; delta.model is left with the previous arrays
+inline void applySnapshotDelta(SplatModel& resident, SnapshotDelta& delta) {
+    SplatModel& snapshot = *delta.model;
+    resident.position.swap(snapshot.position);
+    resident.opacity.swap(snapshot.opacity);
+    resident.scale.swap(snapshot.scale);
+    resident.color.swap(snapshot.color);
+    resident.colorAndOpacity.swap(snapshot.colorAndOpacity);
+    resident.rot.swap(snapshot.rot);
+    resident.covAndPos.swap(snapshot.covAndPos);
+    std::swap(resident.numPoints, snapshot.numPoints);
+}
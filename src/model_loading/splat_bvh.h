@@ -0,0 +1,546 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+
+#include "core/job_system.h"
+
+// extent of a splat in standard deviations, where its density has dropped to 1/100; splat_covariances.cs never
+// draws a splat beyond it
+const float SPLAT_BOUND_SIGMAS = 3.034798181f;
+const uint32_t NO_SPLAT = 0xFFFFFFFF;
+
+// the splat hit by a ray, see SplatBvh::pick()
+struct SplatHit {
+    uint32_t index = NO_SPLAT;
+    float distance = std::numeric_limits<float>::infinity(); // ray parameter of the densest point of the splat
+    float alpha = 0.0f;                                       // opacity times the density at that point
+};
+
+// Bounding volume hierarchy over the splats of a model for picking and spatial queries. Every splat is bounded
+// by the box around its ellipsoid at SPLAT_BOUND_SIGMAS; the region and nearest queries test the splat centers.
+//
+// The build bins the centers of a node into SAH_BINS bins per axis and splits at the bin border with the lowest
+// surface area cost. The top of the tree is split on the calling thread with the binning of the large nodes in
+// parallel, the subtrees of up to SUBTREE_SPLATS splats are built by parallel jobs and spliced into the top in
+// depth first order, so the tree is the same for any number of threads.
+//
+// The BVH keeps pointers to covAndPos and colorAndOpacity of the model, which must outlive it. Queries are const
+// and can run on several threads at once. refit() follows splats that were edited in place. A build started with a
+// cancel flag stops soon after the flag is set and leaves an empty BVH that reports cancelled().
+class SplatBvh {
+public:
+    static const uint32_t MAX_LEAF_SPLATS = 4;
+    static const uint32_t SUBTREE_SPLATS = 1 << 16;
+    static const int SAH_BINS = 16;
+    // splats per job when the bins of a large node are filled in parallel
+    static const uint32_t BIN_GRAIN = 1 << 15;
+
+    struct Node {
+        glm::vec3 lo;
+        uint32_t first;  // leaf: position of its first splat in order, inner node: index of the right child
+        glm::vec3 hi;
+        uint32_t count;  // splats of a leaf, 0 for inner nodes, whose left child is the next node
+    };
+
+    SplatBvh(const std::vector<glm::mat4>& covAndPos, const std::vector<glm::vec4>& colorAndOpacity, uint32_t numSplats,
+             const std::atomic<bool>* cancel = nullptr) :
+        covAndPos(&covAndPos),
+        colorAndOpacity(&colorAndOpacity),
+        numSplats(numSplats),
+        cancel(cancel)
+    {
+        build();
+        if (cancelRequested()) {
+            // the partial tree is useless, nothing may query it
+            buildCancelled = true;
+            tree.clear();
+            order.clear();
+            leafOf.clear();
+            parents.clear();
+        }
+    }
+
+    bool cancelled() const { return buildCancelled; }
+
+    const std::vector<Node>& nodes() const { return tree; }
+    size_t memoryBytes() const {
+        return tree.size() * (sizeof(Node) + sizeof(uint32_t)) + (order.size() + leafOf.size()) * sizeof(uint32_t);
+    }
+    uint32_t depth() const { return tree.empty() ? 0 : nodeDepth(0); }
+
+    // the splat whose densest point along the ray origin + t * direction (t > 0) comes first, among the splats
+    // with an alpha of at least minAlpha there
+    SplatHit pick(const glm::vec3& origin, const glm::vec3& direction, float minAlpha) const {
+        SplatHit hit;
+        const glm::vec3 invDirection = 1.0f / direction;
+        float tRoot;
+        if (tree.empty() || !intersectBox(tree[0], origin, invDirection, hit.distance, tRoot)) return hit;
+
+        // nodes with the ray parameter where the ray enters them
+        std::vector<std::pair<uint32_t, float>> stack;
+        stack.reserve(64);
+        stack.push_back({0, tRoot});
+        while (!stack.empty()) {
+            const uint32_t index = stack.back().first;
+            const float tEntry = stack.back().second;
+            stack.pop_back();
+            // a nearer hit was found since the node was pushed
+            if (tEntry > hit.distance) continue;
+
+            const Node& node = tree[index];
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    float t, alpha;
+                    if (intersectSplat(order[i], origin, direction, t, alpha) && alpha >= minAlpha && t > 0.0f && t < hit.distance) {
+                        hit.index = order[i];
+                        hit.distance = t;
+                        hit.alpha = alpha;
+                    }
+                }
+                continue;
+            }
+
+            // the nearer child is visited first
+            const uint32_t left = index + 1;
+            const uint32_t right = node.first;
+            float tLeft, tRight;
+            const bool hitLeft = intersectBox(tree[left], origin, invDirection, hit.distance, tLeft);
+            const bool hitRight = intersectBox(tree[right], origin, invDirection, hit.distance, tRight);
+            if (hitLeft && hitRight) {
+                const bool leftFirst = tLeft <= tRight;
+                stack.push_back(leftFirst ? std::make_pair(right, tRight) : std::make_pair(left, tLeft));
+                stack.push_back(leftFirst ? std::make_pair(left, tLeft) : std::make_pair(right, tRight));
+            } else if (hitLeft) {
+                stack.push_back({left, tLeft});
+            } else if (hitRight) {
+                stack.push_back({right, tRight});
+            }
+        }
+        return hit;
+    }
+
+    // appends the splats with their center in the box [lo, hi]
+    void queryBox(const glm::vec3& lo, const glm::vec3& hi, std::vector<uint32_t>& splats) const {
+        query(
+            [&](const Node& node) { return glm::all(glm::lessThanEqual(node.lo, hi)) && glm::all(glm::greaterThanEqual(node.hi, lo)); },
+            [&](const glm::vec3& center) { return glm::all(glm::lessThanEqual(lo, center)) && glm::all(glm::lessThanEqual(center, hi)); },
+            splats);
+    }
+
+    // appends the splats with their center in the sphere
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& splats) const {
+        query(
+            [&](const Node& node) { return boxDistance2(node, center) <= radius * radius; },
+            [&](const glm::vec3& c) { return glm::dot(c - center, c - center) <= radius * radius; },
+            splats);
+    }
+
+    // the splat with the center closest to point among the splats with an opacity of at least minOpacity,
+    // NO_SPLAT if there is none within maxDistance
+    uint32_t nearest(const glm::vec3& point, float minOpacity = 0.0f, float maxDistance = std::numeric_limits<float>::infinity(),
+                     float* distance = nullptr) const {
+        uint32_t best = NO_SPLAT;
+        float best2 = maxDistance * maxDistance;
+        if (tree.empty()) return best;
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = tree[index];
+            if (boxDistance2(node, point) > best2) continue;
+
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const uint32_t splat = order[i];
+                    const glm::vec3 d = center(splat) - point;
+                    const float d2 = glm::dot(d, d);
+                    // ties go to the lower index, independent of the tree
+                    if ((d2 < best2 || (d2 == best2 && splat < best)) && (*colorAndOpacity)[splat].w >= minOpacity) {
+                        best = splat;
+                        best2 = d2;
+                    }
+                }
+                continue;
+            }
+
+            const uint32_t left = index + 1;
+            const uint32_t right = node.first;
+            const bool leftFirst = boxDistance2(tree[left], point) <= boxDistance2(tree[right], point);
+            stack.push_back(leftFirst ? right : left);
+            stack.push_back(leftFirst ? left : right);
+        }
+        if (distance && best != NO_SPLAT) *distance = std::sqrt(best2);
+        return best;
+    }
+
+    // updates the bounds of the leaves of the given splats and of their ancestors after the splats changed. The
+    // tree keeps its structure, so it loses quality when splats move far; build a new one after large changes
+    void refit(const std::vector<uint32_t>& splats) {
+        std::vector<uint32_t> changed;
+        for (uint32_t splat : splats) {
+            for (uint32_t node = leafOf[splat]; node != NO_PARENT; node = parents[node]) changed.push_back(node);
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        // children come after their parent in depth first order
+        for (auto it = changed.rbegin(); it != changed.rend(); ++it) {
+            Node& node = tree[*it];
+            Box bounds;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const glm::vec3 c = center(order[i]);
+                    const glm::vec3 extent = splatExtent((*covAndPos)[order[i]]);
+                    bounds.grow(c - extent, c + extent);
+                }
+            } else {
+                bounds.grow(tree[*it + 1].lo, tree[*it + 1].hi);
+                bounds.grow(tree[node.first].lo, tree[node.first].hi);
+            }
+            node.lo = bounds.lo;
+            node.hi = bounds.hi;
+        }
+    }
+
+    // the densest point of a splat along a ray: its ray parameter t and the alpha there. False if the ray
+    // passes the splat outside of SPLAT_BOUND_SIGMAS or the covariance is degenerate
+    bool intersectSplat(uint32_t splat, const glm::vec3& origin, const glm::vec3& direction, float& t, float& alpha) const {
+        // in double precision, the covariances of flat splats are close to singular
+        const glm::mat4& m = (*covAndPos)[splat];
+        const glm::dmat3 cov = glm::dmat3(glm::mat3(m));
+        if (!(glm::determinant(cov) > 0.0)) return false;
+        const glm::dmat3 inverse = glm::inverse(cov);
+
+        // minimizes the mahalanobis distance of origin + t * direction to the center
+        const glm::dvec3 toCenter = glm::dvec3(glm::vec3(m[3]) - origin);
+        const glm::dvec3 inverseDirection = inverse * glm::dvec3(direction);
+        const double dd = glm::dot(glm::dvec3(direction), inverseDirection);
+        if (!(dd > 0.0)) return false;
+        const double tDensest = glm::dot(toCenter, inverseDirection) / dd;
+
+        const glm::dvec3 offset = toCenter - tDensest * glm::dvec3(direction);
+        const double distance2 = glm::dot(offset, inverse * offset);
+        if (!(distance2 <= SPLAT_BOUND_SIGMAS * SPLAT_BOUND_SIGMAS)) return false;
+        t = static_cast<float>(tDensest);
+        alpha = (*colorAndOpacity)[splat].w * static_cast<float>(std::exp(-0.5 * distance2));
+        return true;
+    }
+
+private:
+    const std::vector<glm::mat4>* covAndPos;
+    const std::vector<glm::vec4>* colorAndOpacity;
+    uint32_t numSplats;
+    const std::atomic<bool>* cancel;
+    bool buildCancelled = false;
+
+    std::vector<Node> tree;
+    // splat indices, the splats of a leaf are contiguous
+    std::vector<uint32_t> order;
+    // for refit(): the leaf of every splat and the parent of every node
+    std::vector<uint32_t> leafOf;
+    std::vector<uint32_t> parents;
+    static constexpr uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    // the splats as the build partitions them, in order afterwards
+    struct BuildSplat {
+        glm::vec3 center;
+        uint32_t index;
+        glm::vec3 extent;
+    };
+    std::vector<BuildSplat> buildSplats;
+
+    // marks a node of the top of the tree whose subtree is built by a job, first is the index of the subtree
+    static const uint32_t DEFERRED = 0xFFFFFFFF;
+
+    struct Range {
+        uint32_t begin, end;
+    };
+
+    struct Box {
+        glm::vec3 lo = glm::vec3(std::numeric_limits<float>::infinity());
+        glm::vec3 hi = glm::vec3(-std::numeric_limits<float>::infinity());
+
+        void grow(const glm::vec3& l, const glm::vec3& h) {
+            lo = glm::min(lo, l);
+            hi = glm::max(hi, h);
+        }
+        void grow(const Box& box) { grow(box.lo, box.hi); }
+        float area() const {
+            const glm::vec3 e = glm::max(hi - lo, glm::vec3(0.0f));
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    // the bounds of the splats of a range and of their centers, and the centers binned along every axis
+    struct Bins {
+        Box bounds;
+        Box centers;
+        glm::vec3 binScale = glm::vec3(0.0f); // bins per unit along every axis, 0 if the centers are flat
+        Box binBounds[3][SAH_BINS];
+        uint32_t binCounts[3][SAH_BINS] = {};
+
+        void add(const Bins& other) {
+            bounds.grow(other.bounds);
+            centers.grow(other.centers);
+            for (int axis = 0; axis < 3; axis++) {
+                for (int b = 0; b < SAH_BINS; b++) {
+                    binBounds[axis][b].grow(other.binBounds[axis][b]);
+                    binCounts[axis][b] += other.binCounts[axis][b];
+                }
+            }
+        }
+    };
+
+    glm::vec3 center(uint32_t splat) const { return glm::vec3((*covAndPos)[splat][3]); }
+
+    static glm::vec3 splatExtent(const glm::mat4& m) {
+        return SPLAT_BOUND_SIGMAS * glm::sqrt(glm::max(glm::vec3(m[0][0], m[1][1], m[2][2]), glm::vec3(0.0f)));
+    }
+
+    bool cancelRequested() const { return cancel && cancel->load(std::memory_order_relaxed); }
+
+    void build() {
+        if (numSplats == 0 || cancelRequested()) return;
+        JobSystem& jobs = JobSystem::global();
+
+        buildSplats.resize(numSplats);
+        jobs.parallelFor(0, numSplats, BIN_GRAIN, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const glm::mat4& m = (*covAndPos)[i];
+                buildSplats[i] = BuildSplat{glm::vec3(m[3]), static_cast<uint32_t>(i), splatExtent(m)};
+            }
+        });
+
+        // the top of the tree, then its subtrees in parallel
+        std::vector<Node> top;
+        std::vector<Range> subtrees;
+        buildNode(top, 0, numSplats, &subtrees);
+        if (cancelRequested()) return;
+
+        std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+        jobs.parallelChunks(subtrees.size(), [&](size_t s) {
+            buildNode(subtreeNodes[s], subtrees[s].begin, subtrees[s].end, nullptr);
+        });
+        if (cancelRequested()) return;
+
+        size_t numNodes = top.size();
+        for (const std::vector<Node>& nodes : subtreeNodes) numNodes += nodes.size();
+        tree.reserve(numNodes);
+        splice(top, 0, subtreeNodes);
+
+        order.resize(numSplats);
+        for (uint32_t i = 0; i < numSplats; i++) order[i] = buildSplats[i].index;
+        buildSplats.clear();
+        buildSplats.shrink_to_fit();
+
+        leafOf.resize(numSplats);
+        parents.assign(tree.size(), NO_PARENT);
+        for (uint32_t n = 0; n < tree.size(); n++) {
+            const Node& node = tree[n];
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) leafOf[order[i]] = n;
+            } else {
+                parents[n + 1] = n;
+                parents[node.first] = n;
+            }
+        }
+    }
+
+    // appends the subtree of the splats buildSplats[begin, end) to nodes in depth first order; with deferred, ranges of
+    // up to SUBTREE_SPLATS splats are not built but recorded there. Once the build is cancelled the remaining ranges
+    // become empty leaves, so it unwinds without binning them.
+    void buildNode(std::vector<Node>& nodes, uint32_t begin, uint32_t end, std::vector<Range>* deferred) {
+        const uint32_t index = static_cast<uint32_t>(nodes.size());
+        if (cancelRequested()) {
+            nodes.push_back(Node{glm::vec3(0.0f), begin, glm::vec3(0.0f), end - begin});
+            return;
+        }
+        if (end - begin <= MAX_LEAF_SPLATS) {
+            Box bounds;
+            for (uint32_t i = begin; i < end; i++) bounds.grow(buildSplats[i].center - buildSplats[i].extent, buildSplats[i].center + buildSplats[i].extent);
+            nodes.push_back(Node{bounds.lo, begin, bounds.hi, end - begin});
+            return;
+        }
+
+        const Bins bins = binRange(begin, end);
+        nodes.push_back(Node{bins.bounds.lo, 0, bins.bounds.hi, 0});
+        if (deferred && end - begin <= SUBTREE_SPLATS) {
+            nodes[index].first = static_cast<uint32_t>(deferred->size());
+            nodes[index].count = DEFERRED;
+            deferred->push_back(Range{begin, end});
+            return;
+        }
+
+        const uint32_t middle = split(bins, begin, end);
+        buildNode(nodes, begin, middle, deferred);
+        nodes[index].first = static_cast<uint32_t>(nodes.size());
+        buildNode(nodes, middle, end, deferred);
+    }
+
+    Bins binRange(uint32_t begin, uint32_t end) const {
+        // the center bounds come first, they place the bins
+        Box centers;
+        auto centerBounds = [&](size_t b, size_t e) {
+            Box box;
+            for (size_t i = b; i < e; i++) box.grow(buildSplats[i].center, buildSplats[i].center);
+            return box;
+        };
+        auto grow = [](Box a, const Box& b) { a.grow(b); return a; };
+        if (end - begin > BIN_GRAIN) centers = JobSystem::global().parallelReduce(begin, end, BIN_GRAIN, Box(), centerBounds, grow);
+        else centers = centerBounds(begin, end);
+
+        Bins empty;
+        empty.centers = centers;
+        for (int axis = 0; axis < 3; axis++) {
+            const float extent = centers.hi[axis] - centers.lo[axis];
+            // the largest center lands in the last bin
+            if (extent > 0.0f) empty.binScale[axis] = SAH_BINS * (1.0f - 1e-5f) / extent;
+        }
+
+        auto fill = [&](size_t b, size_t e) {
+            Bins bins = empty;
+            for (size_t i = b; i < e; i++) {
+                const glm::vec3 c = buildSplats[i].center;
+                const glm::vec3 lo = c - buildSplats[i].extent;
+                const glm::vec3 hi = c + buildSplats[i].extent;
+                bins.bounds.grow(lo, hi);
+                for (int axis = 0; axis < 3; axis++) {
+                    const int bin = binIndex(empty, axis, c[axis]);
+                    bins.binBounds[axis][bin].grow(lo, hi);
+                    bins.binCounts[axis][bin]++;
+                }
+            }
+            return bins;
+        };
+        auto combine = [](Bins a, const Bins& b) { a.add(b); return a; };
+        if (end - begin > BIN_GRAIN) return JobSystem::global().parallelReduce(begin, end, BIN_GRAIN, empty, fill, combine);
+        return fill(begin, end);
+    }
+
+    static int binIndex(const Bins& bins, int axis, float value) {
+        const float bin = (value - bins.centers.lo[axis]) * bins.binScale[axis];
+        return static_cast<int>(std::min(std::max(bin, 0.0f), SAH_BINS - 1.0f));
+    }
+
+    // partitions buildSplats[begin, end) at the bin border with the lowest surface area cost, returns the first splat
+    // of the right child
+    uint32_t split(const Bins& bins, uint32_t begin, uint32_t end) {
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1;
+        int bestBin = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (bins.binScale[axis] == 0.0f) continue;
+
+            // the area and count of the bins right of every border
+            float rightArea[SAH_BINS];
+            uint32_t rightCount[SAH_BINS];
+            Box box;
+            uint32_t count = 0;
+            for (int b = SAH_BINS - 1; b > 0; b--) {
+                box.grow(bins.binBounds[axis][b]);
+                count += bins.binCounts[axis][b];
+                rightArea[b] = box.area();
+                rightCount[b] = count;
+            }
+
+            box = Box();
+            count = 0;
+            for (int b = 1; b < SAH_BINS; b++) {
+                box.grow(bins.binBounds[axis][b - 1]);
+                count += bins.binCounts[axis][b - 1];
+                if (count == 0 || rightCount[b] == 0) continue;
+                const float cost = count * box.area() + rightCount[b] * rightArea[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        uint32_t middle = begin;
+        if (bestAxis >= 0) {
+            middle = static_cast<uint32_t>(std::partition(buildSplats.begin() + begin, buildSplats.begin() + end, [&](const BuildSplat& splat) {
+                return binIndex(bins, bestAxis, splat.center[bestAxis]) < bestBin;
+            }) - buildSplats.begin());
+        }
+        // all centers in one place, any split does
+        if (middle == begin || middle == end) middle = begin + (end - begin) / 2;
+        return middle;
+    }
+
+    // appends the nodes of the top of the tree below node with the deferred subtrees in their place
+    void splice(const std::vector<Node>& top, uint32_t node, const std::vector<std::vector<Node>>& subtreeNodes) {
+        const Node& source = top[node];
+        if (source.count == DEFERRED) {
+            const uint32_t base = static_cast<uint32_t>(tree.size());
+            for (Node n : subtreeNodes[source.first]) {
+                if (n.count == 0) n.first += base;
+                tree.push_back(n);
+            }
+            return;
+        }
+        tree.push_back(source);
+        if (source.count > 0) return;
+
+        const uint32_t index = static_cast<uint32_t>(tree.size()) - 1;
+        splice(top, node + 1, subtreeNodes);
+        tree[index].first = static_cast<uint32_t>(tree.size());
+        splice(top, source.first, subtreeNodes);
+    }
+
+    template<typename NodeTest, typename CenterTest>
+    void query(NodeTest&& nodeTest, CenterTest&& centerTest, std::vector<uint32_t>& splats) const {
+        if (tree.empty()) return;
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = tree[index];
+            if (!nodeTest(node)) continue;
+
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (centerTest(center(order[i]))) splats.push_back(order[i]);
+                }
+                continue;
+            }
+            stack.push_back(node.first);
+            stack.push_back(index + 1);
+        }
+    }
+
+    // slab test, tEntry is where the ray enters the box
+    static bool intersectBox(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float tMax, float& tEntry) {
+        const glm::vec3 t0 = (node.lo - origin) * invDirection;
+        const glm::vec3 t1 = (node.hi - origin) * invDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        tEntry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+        return tEntry <= tExit;
+    }
+
+    static float boxDistance2(const Node& node, const glm::vec3& point) {
+        const glm::vec3 d = glm::max(glm::max(node.lo - point, point - node.hi), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    uint32_t nodeDepth(uint32_t node) const {
+        if (tree[node].count > 0) return 1;
+        return 1 + std::max(nodeDepth(node + 1), nodeDepth(tree[node].first));
+    }
+};
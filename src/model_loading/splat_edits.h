@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "model_loading/splat_model.h"
+
+// a range [begin, end) of splats
+struct SplatRange {
+    uint32_t begin, end;
+};
+
+// sorted, unique splats as ranges, merged when fewer than gap other splats lie between them
+inline std::vector<SplatRange> mergeSplatRanges(const std::vector<uint32_t>& splats, uint32_t gap) {
+    std::vector<SplatRange> ranges;
+    for (uint32_t splat : splats) {
+        if (!ranges.empty() && splat <= ranges.back().end + gap) ranges.back().end = splat + 1;
+        else ranges.push_back(SplatRange{splat, splat + 1});
+    }
+    return ranges;
+}
+
+// quaternion (r, i, j, k), in the layout of SplatModel::rot, of a rotation by angle radians around axis
+inline glm::vec4 axisAngleQuaternion(const glm::vec3& axis, float angle) {
+    const glm::vec3 v = glm::normalize(axis) * std::sin(0.5f * angle);
+    return glm::vec4(std::cos(0.5f * angle), v.x, v.y, v.z);
+}
+
+// the rotation a then b, b * a
+inline glm::vec4 composeQuaternions(const glm::vec4& b, const glm::vec4& a) {
+    return glm::vec4(
+        b.x * a.x - b.y * a.y - b.z * a.z - b.w * a.w,
+        b.x * a.y + b.y * a.x + b.z * a.w - b.w * a.z,
+        b.x * a.z - b.y * a.w + b.z * a.x + b.w * a.y,
+        b.x * a.w + b.y * a.z - b.z * a.y + b.w * a.x);
+}
+
+// Interactive edits of a loaded SplatModel: moving, recoloring and deleting selections of splats.
+// An edit only touches the splats it changes and rebuilds only their covariances. The changed splats are
+// collected until takeDirtyRanges(), which merges them into the ranges to upload with SplatBuffers::updateRanges,
+// so the cost of an edit depends on the size of the selection, not of the model.
+//
+// Deleted splats get an opacity of 0, which splat_covariances.cs culls, and stay in the model until compact()
+// removes them. That moves every splat behind them, changes their indices and needs a full upload, so it is left
+// until needsCompaction() or the user asks for it.
+class SplatEditor {
+public:
+    // merge dirty splats into one range when fewer than this many clean splats lie between them, one upload of
+    // a few unchanged splats is cheaper than another glBufferSubData
+    static const uint32_t MERGE_GAP = 32;
+    // share of deleted splats above which needsCompaction()
+    static constexpr float COMPACT_FRACTION = 0.25f;
+
+    explicit SplatEditor(SplatModel& model) :
+        model(model),
+        deleted(model.numPoints, 0)
+    {}
+
+    SplatModel& target() { return model; }
+
+    uint32_t deletedCount() const { return numDeleted; }
+    bool isDeleted(uint32_t splat) const { return deleted[splat] != 0; }
+    bool needsCompaction() const { return numDeleted > model.numPoints * COMPACT_FRACTION; }
+
+    // scales by factor and rotates by the quaternion rotation around pivot, then moves by translation. The
+    // scale is uniform, the splats keep their shape
+    void transform(const std::vector<uint32_t>& selection, const glm::vec3& pivot, const glm::vec4& rotation,
+                   float factor, const glm::vec3& translation) {
+        const glm::mat3 R = SplatModel::rotationMatrix(&rotation.x);
+
+        for (uint32_t splat : selection) {
+            if (deleted[splat]) continue;
+
+            float* p = &model.position[3 * splat];
+            const glm::vec3 position = pivot + factor * (R * (glm::vec3(p[0], p[1], p[2]) - pivot)) + translation;
+            p[0] = position.x;
+            p[1] = position.y;
+            p[2] = position.z;
+
+            for (uint32_t c = 0; c < 3; c++) model.scale[3 * splat + c] *= factor;
+
+            // the stored quaternions need not be normalized, an edited one is, so that the composition is a rotation
+            float* q = &model.rot[4 * splat];
+            glm::vec4 own(q[0], q[1], q[2], q[3]);
+            const float length = glm::length(own);
+            if (length > 0.0f) own /= length;
+            const glm::vec4 rotated = composeQuaternions(rotation, own);
+            q[0] = rotated.x;
+            q[1] = rotated.y;
+            q[2] = rotated.z;
+            q[3] = rotated.w;
+
+            model.updateCovariance(splat);
+            dirty.push_back(splat);
+        }
+    }
+
+    // sets the color the renderer uses, and the band 0 coefficients it comes from
+    void recolor(const std::vector<uint32_t>& selection, const glm::vec3& color) {
+        for (uint32_t splat : selection) {
+            if (deleted[splat]) continue;
+
+            model.colorAndOpacity[splat] = glm::vec4(color, model.colorAndOpacity[splat].w);
+            if (model.color.size() >= 3 * (splat + 1)) {
+                // inverse of SplatModel::transformPoints
+                for (uint32_t c = 0; c < 3; c++) model.color[3 * splat + c] = (color[c] - 0.5f) / 0.282094791773878f;
+            }
+            dirty.push_back(splat);
+        }
+    }
+
+    void remove(const std::vector<uint32_t>& selection) {
+        for (uint32_t splat : selection) {
+            if (deleted[splat]) continue;
+
+            deleted[splat] = 1;
+            numDeleted++;
+            model.colorAndOpacity[splat].w = 0.0f;
+            dirty.push_back(splat);
+        }
+    }
+
+    // the splats changed since the last call, as sorted, merged ranges
+    std::vector<SplatRange> takeDirtyRanges() {
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        std::vector<SplatRange> ranges = mergeSplatRanges(dirty, MERGE_GAP);
+        dirtySplats.swap(dirty);
+        dirty.clear();
+        return ranges;
+    }
+
+    // the splats of the last takeDirtyRanges(), sorted, e.g. to update a SplatBvh
+    const std::vector<uint32_t>& lastDirtySplats() const { return dirtySplats; }
+
+    // removes the deleted splats from the model, the others keep their order. Invalidates every splat index,
+    // the model has to be uploaded again
+    void compact() {
+        if (numDeleted == 0) return;
+
+        compactArray(model.position, 3);
+        compactArray(model.opacity, 1);
+        compactArray(model.scale, 3);
+        compactArray(model.color, 3);
+        compactArray(model.colorAndOpacity, 1);
+        compactArray(model.rot, 4);
+        compactArray(model.covAndPos, 1);
+
+        model.numPoints -= numDeleted;
+        deleted.assign(model.numPoints, 0);
+        numDeleted = 0;
+        dirty.clear();
+        dirtySplats.clear();
+    }
+
+private:
+    SplatModel& model;
+    std::vector<uint8_t> deleted;
+    uint32_t numDeleted = 0;
+    std::vector<uint32_t> dirty;
+    std::vector<uint32_t> dirtySplats;
+
+    template<typename T>
+    void compactArray(std::vector<T>& values, uint32_t numComponents) {
+        if (values.size() < static_cast<size_t>(model.numPoints) * numComponents) return;
+
+        size_t kept = 0;
+        for (uint32_t i = 0; i < model.numPoints; i++) {
+            if (deleted[i]) continue;
+            for (uint32_t c = 0; c < numComponents; c++) values[kept * numComponents + c] = values[i * numComponents + c];
+            kept++;
+        }
+        values.resize(kept * numComponents);
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include "core/job_system.h"
+#include "model_loading/splat_model.h"
+
+// Loads a SplatModel in a background job of the JobSystem.
+// The PLY file is read first, after which the points are transformed and their covariances built
+// in batches, the points of a batch in parallel jobs. Every finished batch is published through processedCount() so the render thread can
+// upload it while the rest of the model is still being processed.
+class SplatLoader {
+public:
+    static const uint32_t DEFAULT_BATCH_SIZE = 1 << 16;
+    // points per job within a batch
+    static const uint32_t PROCESS_GRAIN = 4096;
+
+    // mortonOrder sorts the splats spatially (SplatModel::sortMorton) before they are processed
+    SplatLoader(const std::string& plyFile, bool flipY = false, bool mortonOrder = false, uint32_t batchSize = DEFAULT_BATCH_SIZE) :
+        plyFile(plyFile),
+        batchSize(batchSize),
+        startTime(std::chrono::steady_clock::now())
+    {
+        job = JobSystem::global().submitBackground([this, flipY, mortonOrder]() { run(flipY, mortonOrder); });
+    }
+
+    ~SplatLoader() {
+        cancelled = true;
+        JobSystem::global().wait(job);
+    }
+
+    SplatLoader(const SplatLoader&) = delete;
+    SplatLoader& operator=(const SplatLoader&) = delete;
+
+    const std::string& file() const { return plyFile; }
+
+    // true once the file has been read, model() can then be accessed up to processedCount()
+    bool headerReady() const {
+        State s = state.load(std::memory_order_acquire);
+        return s == State::Processing || s == State::Finished;
+    }
+    bool finished() const { return state.load(std::memory_order_acquire) == State::Finished; }
+    bool failed() const { return state.load(std::memory_order_acquire) == State::Failed; }
+
+    // number of points, counted from the start of the model, that are ready to be uploaded
+    uint32_t processedCount() const { return processed.load(std::memory_order_acquire); }
+
+    const SplatModel& model() const { return *splatModel; }
+
+    // hands the model over once loading has finished
+    std::unique_ptr<SplatModel> takeModel() {
+        JobSystem::global().wait(job);
+        return std::move(splatModel);
+    }
+
+    float loadSeconds() const { return loadTime.load(); }
+
+private:
+    enum class State { Loading, Processing, Finished, Failed };
+
+    std::string plyFile;
+    uint32_t batchSize;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::unique_ptr<SplatModel> splatModel;
+    JobHandle job;
+
+    std::atomic<State> state{State::Loading};
+    std::atomic<uint32_t> processed{0};
+    std::atomic<bool> cancelled{false};
+    std::atomic<float> loadTime{0.0f};
+
+    void run(bool flipY, bool mortonOrder) {
+        splatModel = std::make_unique<SplatModel>(plyFile, flipY, false, false);
+        if (!splatModel->loaded) {
+            state.store(State::Failed, std::memory_order_release);
+            return;
+        }
+        if (mortonOrder) splatModel->sortMorton();
+        state.store(State::Processing, std::memory_order_release);
+
+        const uint32_t numPoints = splatModel->numPoints;
+        for (uint32_t begin = 0; begin < numPoints && !cancelled; begin += batchSize) {
+            uint32_t end = std::min(numPoints, begin + batchSize);
+            JobSystem::global().parallelFor(begin, end, PROCESS_GRAIN, [this](size_t b, size_t e) {
+                splatModel->processRange(static_cast<uint32_t>(b), static_cast<uint32_t>(e));
+            });
+            processed.store(end, std::memory_order_release);
+        }
+
+        loadTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+        state.store(State::Finished, std::memory_order_release);
+    }
+};
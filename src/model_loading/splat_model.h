@@ -12,6 +12,10 @@
 
 #include <miniply.h>
 
+#include "core/job_system.h"
+#include "model_loading/ply_reader.h"
+#include "model_loading/morton_order.h"
+
 class SplatModel {
 public:
     // model data 
@@ -26,9 +30,13 @@ public:
 
     bool flipY;
     bool printToConsole;
+    // false if the PLY file could not be read
+    bool loaded = false;
 
 
-    SplatModel(const std::string& plyFile, bool flipY = false, bool printToConsole = false) : 
+    // processPoints = false only reads the PLY file, the points are then transformed with processRange().
+    // This is used by the progressive loader to publish the model in batches.
+    SplatModel(const std::string& plyFile, bool flipY = false, bool printToConsole = false, bool processPoints = true) : 
         printToConsole(printToConsole),
         flipY(flipY)
     {
@@ -40,6 +48,20 @@ public:
             return;
         }
 
+        // one covariance matrix per point
+        covAndPos.resize(numPoints);
+        loaded = true;
+
+        if (processPoints) {
+            processRange(0, numPoints);
+        }
+
+    };
+
+    ~SplatModel() {};
+
+    void processRange(uint32_t begin, uint32_t end) {
+
         // Transform the data to standard units
         // ------------------------------------
         // opacity = sigmoid(read_opacity)
@@ -47,23 +69,118 @@ public:
         // rot = normalized(rot) for all quaternions
         // color = SH(read_color)
         // ------------------------------------
-        transformPoints();
+        transformPoints(begin, end);
 
 
         // Compute the covariance matrix
         // Sigma = R * S * S * R^T
         // where R and S are constructed from the scale and (quaternion) rotation vectors
-        computeCovariance();
+        computeCovariance(begin, end);
 
-    };
+    }
 
-    ~SplatModel() {};
+
+    // Reorders the splats along a 3D Morton curve so that splats close in space are close in memory.
+    // Improves the locality of the gathers through the sorted indices in process_pixels.cs and of the binning loop.
+    void sortMorton() {
+        std::vector<uint32_t> order = mortonOrder(position, numPoints);
+
+        // every array is gathered by its own job
+        JobSystem& jobs = JobSystem::global();
+        std::vector<JobHandle> permutes;
+        permutes.push_back(jobs.submit([&]() { permute(position, order, 3); }));
+        permutes.push_back(jobs.submit([&]() { permute(opacity, order, 1); }));
+        permutes.push_back(jobs.submit([&]() { permute(scale, order, 3); }));
+        permutes.push_back(jobs.submit([&]() { permute(color, order, 3); }));
+        permutes.push_back(jobs.submit([&]() { permute(colorAndOpacity, order, 1); }));
+        permutes.push_back(jobs.submit([&]() { permute(rot, order, 4); }));
+        permute(covAndPos, order, 1);
+        jobs.wait(permutes);
+    }
+
+    // rebuilds covAndPos[i] from the scale, rotation and position of splat i, e.g. after an edit
+    void updateCovariance(uint32_t i) {
+        glm::mat3 S = glm::mat3(0.0f);
+        S[0][0] = scale.at(3*i);
+        S[1][1] = scale.at(3*i + 1);
+        S[2][2] = scale.at(3*i + 2);
+
+        glm::mat3 R = rotationMatrix(&rot.at(4*i));
+        glm::mat4 cov = glm::mat4(R * S * S * glm::transpose(R));
+
+        cov[3] = glm::vec4(
+            position.at(3*i), 
+            position.at(3*i + 1), 
+            position.at(3*i + 2), 
+            0.0f);
+
+        covAndPos[i] = cov;
+    }
+
+    // the opacity processRange() computes from the value in the PLY file
+    static float activatedOpacity(float value) {
+        return 1.0f / (1.0 + std::exp(value)); // sigmoid
+    }
+
+    // rotation of the quaternion (r, i, j, k) as stored in rot
+    static glm::mat3 rotationMatrix(const float* q) {
+        const float rot_r = q[0];
+        const float rot_i = q[1];
+        const float rot_j = q[2];
+        const float rot_k = q[3];
+
+        float rot_ri = rot_r * rot_i;
+        float rot_rj = rot_r * rot_j;
+        float rot_rk = rot_r * rot_k;
+        float rot_ii = rot_i * rot_i;
+        float rot_ij = rot_i * rot_j;
+        float rot_ik = rot_i * rot_k;
+        float rot_jj = rot_j * rot_j;
+        float rot_jk = rot_j * rot_k;
+        float rot_kk = rot_k * rot_k;            
+        
+        glm::mat3 R = glm::mat3(0.0f);
+        R[0][0] = 1.0f - 2.0f * (rot_jj + rot_kk);
+        R[0][1] = 2.0f * (rot_ij + rot_rk);
+        R[0][2] = 2.0f * (rot_ik - rot_rj);
+        
+        R[1][0] = 2.0f * (rot_ij - rot_rk);
+        R[1][1] = 1.0f - 2.0f * (rot_ii + rot_kk);
+        R[1][2] = 2.0f * (rot_jk + rot_ri);
+        
+        R[2][0] = 2.0f * (rot_ik + rot_rj);
+        R[2][1] = 2.0f * (rot_jk - rot_ri);
+        R[2][2] = 1.0f - 2.0f * (rot_ii + rot_jj);
+        return R;
+    }
 
 private:
 
+    template<typename T>
+    static void permute(std::vector<T>& values, const std::vector<uint32_t>& order, uint32_t numComponents) {
+        if (values.size() < order.size() * numComponents) return;
+
+        std::vector<T> sorted(values.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            for (uint32_t c = 0; c < numComponents; c++) {
+                sorted[i * numComponents + c] = values[order[i] * numComponents + c];
+            }
+        }
+        values.swap(sorted);
+    }
+
     bool loadPLY(const std::string& plyFile) {
         if(printToConsole) std::cout << "\nLoading file " << plyFile << std::endl;
 
+        // fast path for binary little endian files, everything else goes through miniply
+        {
+            BinaryPlyReader binaryReader(plyFile);
+            if (binaryReader.valid()) {
+                if (loadBinaryPLY(binaryReader)) return true;
+                std::cerr << "Binary PLY reader could not extract the splat attributes, falling back to miniply" << std::endl;
+            }
+        }
+
         miniply::PLYReader reader(plyFile.c_str());
 
         if (!reader.valid()) {
@@ -210,96 +327,78 @@ private:
         return false;
     }
 
-    void transformPoints() {
+    bool loadBinaryPLY(const BinaryPlyReader& reader) {
+        numPoints = reader.numRows();
+
+        if (printToConsole) std::cout << "Num points: " << numPoints << std::endl;
+
+        position.resize(numPoints * 3);
+        opacity.resize(numPoints);
+        scale.resize(numPoints * 3);
+        rot.resize(numPoints * 4);
+        color.resize(numPoints * 3);
+        colorAndOpacity.resize(numPoints);
+
+        // all attributes are deinterleaved in a single pass over the mapped file,
+        // colorAndOpacity is filled directly instead of being assembled afterwards
+        std::vector<BinaryPlyReader::Target> targets = {
+            {{"x", "y", "z"}, position.data()},
+            {{"opacity"}, opacity.data()},
+            {{"scale_0", "scale_1", "scale_2"}, scale.data()},
+            {{"rot_0", "rot_1", "rot_2", "rot_3"}, rot.data()},
+            {{"f_dc_0", "f_dc_1", "f_dc_2"}, color.data()},
+            {{"f_dc_0", "f_dc_1", "f_dc_2", "opacity"}, &colorAndOpacity.data()->x},
+        };
+
+        if (!reader.extract(targets)) {
+            position.clear();
+            opacity.clear();
+            scale.clear();
+            rot.clear();
+            color.clear();
+            colorAndOpacity.clear();
+            return false;
+        }
 
-        std::for_each(scale.begin(), scale.end(), [](float &value){ 
+        std::cout << "Ply file loaded succcesfully\n" << std::endl;
+        return true;
+    }
+
+    void transformPoints(uint32_t begin, uint32_t end) {
+
+        std::for_each(scale.begin() + 3 * begin, scale.begin() + 3 * end, [](float &value){ 
             value = std::exp(value); 
         });
 
-        std::for_each(opacity.begin(), opacity.end(), [](float &value){
-            value = 1.0f / (1.0 + std::exp(value)); // sigmoid
+        std::for_each(opacity.begin() + begin, opacity.begin() + end, [](float &value){
+            value = activatedOpacity(value);
         });
         
         // TODO normalize quaternions (appears to be normalized by default but never know)
         
-        std::for_each(colorAndOpacity.begin(), colorAndOpacity.end(), [](glm::vec4 &vec){
+        std::for_each(colorAndOpacity.begin() + begin, colorAndOpacity.begin() + end, [](glm::vec4 &vec){
             // 0.282094791773878 = 0.5 * sqrt(1/pi) = Spherical harmonic basis function Y_0^0
             // not sure why need to 0.5f
             vec.x = 0.5f + vec.x * 0.282094791773878f; 
             vec.y = 0.5f + vec.y * 0.282094791773878f; 
             vec.z = 0.5f + vec.z * 0.282094791773878f;
-            vec.w = 1.0f / (1.0 + std::exp(vec.w)); // sigmoid
+            vec.w = activatedOpacity(vec.w);
         });
 
     }
 
-    void computeCovariance() {
-        
-        // one covariance matrix per point
-        covAndPos.resize(numPoints);
-
-        for (int i = 0; i < numPoints; i++) {
-
-            float& scale_x = scale.at(3*i);
-            float& scale_y = scale.at(3*i + 1);
-            float& scale_z = scale.at(3*i + 2);
-            
-            glm::mat3 S = glm::mat3(0.0f);
-            S[0][0] = scale_x;
-            S[1][1] = scale_y;
-            S[2][2] = scale_z;
-            
-            float& rot_r = rot.at(4*i);
-            float& rot_i = rot.at(4*i + 1);
-            float& rot_j = rot.at(4*i + 2);
-            float& rot_k = rot.at(4*i + 3);
+    void computeCovariance(uint32_t begin, uint32_t end) {
 
+        for (uint32_t i = begin; i < end; i++) {
 
             // https://stackoverflow.com/questions/32438252/efficient-way-to-apply-mirror-effect-on-quaternion-rotation
             if (flipY) {
-                rot_i = -rot_i;
-                rot_k = -rot_k;
-            }
-
-            float rot_ri = rot_r * rot_i;
-            float rot_rj = rot_r * rot_j;
-            float rot_rk = rot_r * rot_k;
-            float rot_ii = rot_i * rot_i;
-            float rot_ij = rot_i * rot_j;
-            float rot_ik = rot_i * rot_k;
-            float rot_jj = rot_j * rot_j;
-            float rot_jk = rot_j * rot_k;
-            float rot_kk = rot_k * rot_k;            
-            
-            glm::mat3 R = glm::mat3(0.0f);
-            R[0][0] = 1.0f - 2.0f * (rot_jj + rot_kk);
-            R[0][1] = 2.0f * (rot_ij + rot_rk);
-            R[0][2] = 2.0f * (rot_ik - rot_rj);
-            
-            R[1][0] = 2.0f * (rot_ij - rot_rk);
-            R[1][1] = 1.0f - 2.0f * (rot_ii + rot_kk);
-            R[1][2] = 2.0f * (rot_jk + rot_ri);
-            
-            R[2][0] = 2.0f * (rot_ik + rot_rj);
-            R[2][1] = 2.0f * (rot_jk + rot_ri);
-            R[2][2] = 1.0f - 2.0f * (rot_ii + rot_jj);
-            
-            glm::mat4 cov = glm::mat4(R * S * S * glm::transpose(R));
-
-
-
-
-            if (flipY) {
-                position.at(3*i + 1) =-position.at(3*i + 1); 
+                rot.at(4*i + 1) = -rot.at(4*i + 1);
+                rot.at(4*i + 3) = -rot.at(4*i + 3);
+                position.at(3*i + 1) = -position.at(3*i + 1);
             }
 
-            cov[3] = glm::vec4(
-                position.at(3*i), 
-                position.at(3*i + 1), 
-                position.at(3*i + 2), 
-                0.0f);
-
-            covAndPos[i] = cov;
+            updateCovariance(i);
         }
 
     }
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "core/frame_arena.h"
+#include "core/job_system.h"
+#include "graphics/dataset_cameras.h"
+#include "rendering/splat_renderer.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/tile_binning.h"
+#include "rendering/quality_controller.h"
+#include "rendering/image_metrics.h"
+
+struct BatchOptions {
+    std::string camerasFile;
+    std::string imagesDir; // reference images named after img_name, optional
+    std::string outputDir; // the rendered views are written here as PNG, optional
+    bool flipY = true;     // has to match how the model was loaded
+    BinningMode binningMode = BinningMode::CountingSort; // ignored with BlendMode::WeightedBlended, which bins unsorted
+    BlendMode blendMode = BlendMode::Sorted;
+    unsigned int numThreads = 0; // views binned and evaluated at the same time, 0 = JobSystem::concurrency()
+};
+
+// Renders every view of a 3DGS cameras.json with one loaded model.
+// The model, its 3D covariances and the GPU buffers are shared by all views. Views are processed in
+// batches of numThreads: the GPU projects the whole batch, the CPU bins all views of the batch in parallel,
+// the GPU rasterizes them, and the PSNR and PNG output of a batch run as background jobs while the next
+// batch is being rendered. Every projection overwrites projectedSSBO, which the rasterization reads, so each
+// view copies its projected splats into a buffer of its slot and back before it is rasterized.
+class BatchRenderer {
+public:
+    BatchRenderer(SplatRenderer& renderer, const SplatBuffers& buffers, const BatchOptions& options) :
+        renderer(renderer),
+        buffers(buffers),
+        options(options)
+    {}
+
+    bool run() {
+        std::vector<DatasetCamera> cameras;
+        if (!loadDatasetCameras(options.camerasFile, cameras)) return false;
+        if (cameras.empty()) {
+            std::cerr << options.camerasFile << " has no cameras" << std::endl;
+            return false;
+        }
+        if (!options.outputDir.empty()) std::filesystem::create_directories(options.outputDir);
+
+        JobSystem& jobs = JobSystem::global();
+        const unsigned int batchSize = options.numThreads > 0 ? options.numThreads : jobs.concurrency();
+        const uint32_t numViews = static_cast<uint32_t>(cameras.size());
+        const QualityLevel& quality = QUALITY_LEVELS[0];
+
+        std::vector<Slot> slots(batchSize);
+        std::vector<JobHandle> evaluators[2];
+        results.assign(numViews, ViewResult());
+
+        using Clock = std::chrono::steady_clock;
+        auto milliseconds = [](Clock::time_point start) { return std::chrono::duration<float, std::milli>(Clock::now() - start).count(); };
+        float projectionTime = 0.0f;
+        float binningTime = 0.0f;
+        float rasterTime = 0.0f;
+        double visibleSum = 0.0;
+        auto start = Clock::now();
+
+        for (uint32_t first = 0, batch = 0; first < numViews; first += batchSize, batch++) {
+            const uint32_t count = std::min<uint32_t>(batchSize, numViews - first);
+            const int set = batch % 2;
+
+            // GPU: project all views of the batch
+            auto stageStart = Clock::now();
+            for (uint32_t v = 0; v < count; v++) {
+                const DatasetCamera& camera = cameras[first + v];
+                Slot& slot = slots[v];
+                const uint32_t numVisible = renderer.project(buffers, buffers.residentCount, camera.splatView(options.flipY), camera.tileGrid(),
+                    quality.alphaCutoff);
+                slot.outputData.resize(numVisible);
+                renderer.readOutputData(buffers, numVisible, slot.outputData.data());
+                slot.saveProjected(buffers, numVisible);
+                visibleSum += static_cast<double>(numVisible) / buffers.residentCount;
+            }
+            projectionTime += milliseconds(stageStart);
+
+            // CPU: bin the views in parallel, one job per view
+            stageStart = Clock::now();
+            std::vector<JobHandle> binners;
+            for (uint32_t v = 0; v < count; v++) {
+                binners.push_back(jobs.submit([this, &slot = slots[v], &camera = cameras[first + v]]() {
+                    slot.bins.reset();
+                    slot.arena.reset();
+                    if (options.blendMode == BlendMode::WeightedBlended) {
+                        slot.bins = std::make_unique<TileBins>(binTilesUnsorted(slot.outputData.data(), slot.outputData.size(), slot.arena, camera.tileGrid(), 1));
+                    } else if (options.binningMode == BinningMode::CountingSort) {
+                        slot.bins = std::make_unique<TileBins>(binTilesCounting(slot.outputData.data(), slot.outputData.size(), slot.arena, camera.tileGrid(), 1));
+                    } else {
+                        slot.bins = std::make_unique<TileBins>(binTilesSortKeys(slot.outputData.data(), slot.outputData.size(), slot.arena, camera.tileGrid()));
+                    }
+                }));
+            }
+            jobs.wait(binners);
+            binningTime += milliseconds(stageStart);
+
+            // the images of this set are still being evaluated by the batch before the last one
+            jobs.wait(evaluators[set]);
+            evaluators[set].clear();
+
+            // GPU: rasterize and read back
+            stageStart = Clock::now();
+            for (uint32_t v = 0; v < count; v++) {
+                const TileGrid grid = cameras[first + v].tileGrid();
+                std::vector<float>& image = slots[v].image[set];
+                slots[v].restoreProjected(buffers);
+                if (renderer.rasterize(buffers, *slots[v].bins, grid, quality.alphaCutoff, quality.maxSplatsPerTile, options.blendMode)) {
+                    renderer.readImage(grid, image);
+                } else {
+                    // nothing visible, only the background
+                    image.assign(static_cast<size_t>(grid.x) * grid.y * TILE_SIZE * TILE_SIZE * 3, 0.5f);
+                }
+            }
+            rasterTime += milliseconds(stageStart);
+
+            // CPU: compare and write while the next batch renders
+            for (uint32_t v = 0; v < count; v++) {
+                evaluators[set].push_back(jobs.submitBackground([this, &camera = cameras[first + v], &image = slots[v].image[set], index = first + v]() {
+                    evaluate(camera, image, results[index]);
+                }));
+            }
+        }
+        for (auto& set : evaluators) jobs.wait(set);
+
+        const float seconds = milliseconds(start) / 1000.0f;
+
+        // report
+        double psnrSum = 0.0;
+        uint32_t numCompared = 0;
+        for (uint32_t i = 0; i < numViews; i++) {
+            if (!results[i].compared) continue;
+            std::cout << "view " << cameras[i].id << " " << cameras[i].imageName << ": PSNR " << results[i].psnr << " dB" << std::endl;
+            psnrSum += results[i].psnr;
+            numCompared++;
+        }
+
+        std::cout << "Rendered " << numViews << " views in " << seconds << " s (" << numViews / seconds << " views/s, "
+            << batchSize << " views per batch)" << std::endl;
+        std::cout << "Per view: projection " << projectionTime / numViews << " ms, binning " << binningTime / numViews
+            << " ms, raster + readback " << rasterTime / numViews << " ms, " << visibleSum / numViews * 100.0 << "% of the splats visible" << std::endl;
+        if (numCompared > 0) {
+            std::cout << "Mean PSNR " << psnrSum / numCompared << " dB over " << numCompared << " views" << std::endl;
+        } else if (!options.imagesDir.empty()) {
+            std::cerr << "No reference images found in " << options.imagesDir << std::endl;
+        }
+        return true;
+    }
+
+private:
+    // per view state of a batch, reused by the following batches
+    struct Slot {
+        std::vector<OutputData> outputData; // visible splats only
+        FrameArena arena;
+        std::unique_ptr<TileBins> bins;
+        std::vector<float> image[2]; // alternating batches, one set is rendered while the other is evaluated
+        // the projected splats of the view, on the GPU
+        unsigned int projectedSSBO = 0;
+        size_t projectedCapacity = 0;
+        size_t projectedBytes = 0;
+
+        Slot() = default;
+        ~Slot() {
+            if (projectedSSBO) glDeleteBuffers(1, &projectedSSBO);
+        }
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+        // copies the first numVisible splats of projectedSSBO, as the last project() left them
+        void saveProjected(const SplatBuffers& buffers, uint32_t numVisible) {
+            projectedBytes = static_cast<size_t>(numVisible) * sizeof(ProjectedSplat);
+            if (projectedBytes == 0) return;
+            if (!projectedSSBO) glGenBuffers(1, &projectedSSBO);
+            if (projectedBytes > projectedCapacity) {
+                projectedCapacity = projectedBytes + projectedBytes / 2;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, projectedSSBO);
+                glBufferData(GL_COPY_WRITE_BUFFER, projectedCapacity, nullptr, GL_DYNAMIC_COPY);
+            }
+            // written by the projection shader
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffers.projectedSSBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, projectedSSBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, projectedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        // puts the splats of saveProjected() back where rasterize() reads them
+        void restoreProjected(const SplatBuffers& buffers) const {
+            if (projectedBytes == 0) return;
+            glBindBuffer(GL_COPY_READ_BUFFER, projectedSSBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.projectedSSBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, projectedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+    };
+
+    struct ViewResult {
+        bool compared = false;
+        double psnr = 0.0;
+    };
+
+    SplatRenderer& renderer;
+    const SplatBuffers& buffers;
+    BatchOptions options;
+    std::vector<ViewResult> results;
+
+    void evaluate(const DatasetCamera& camera, const std::vector<float>& image, ViewResult& result) const {
+        const TileGrid grid = camera.tileGrid();
+        const uint32_t width = grid.x * TILE_SIZE;
+        const uint32_t height = grid.y * TILE_SIZE;
+
+        if (!options.outputDir.empty()) {
+            std::vector<unsigned char> pixels = toImage8(image, width, height);
+            std::string file = (std::filesystem::path(options.outputDir) / (camera.imageName + ".png")).string();
+            if (!stbi_write_png(file.c_str(), width, height, 3, pixels.data(), width * 3)) {
+                std::cerr << "Could not write " << file << std::endl;
+            }
+        }
+
+        if (options.imagesDir.empty()) return;
+
+        // img_name usually comes without an extension
+        for (const char* extension : {"", ".png", ".jpg", ".JPG", ".jpeg"}) {
+            std::filesystem::path file = std::filesystem::path(options.imagesDir) / (camera.imageName + extension);
+            if (!std::filesystem::is_regular_file(file)) continue;
+
+            int refWidth, refHeight, channels;
+            unsigned char* reference = stbi_load(file.string().c_str(), &refWidth, &refHeight, &channels, 3);
+            if (!reference) {
+                std::cerr << "Could not read " << file.string() << std::endl;
+                return;
+            }
+            result.psnr = psnr(image, width, height, reference, refWidth, refHeight, 3);
+            result.compared = true;
+            stbi_image_free(reference);
+            return;
+        }
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include "core/frame_arena.h"
+#include "rendering/splat_renderer.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/tile_binning.h"
+#include "rendering/quality_controller.h"
+#include "rendering/cpu_rasterizer.h"
+#include "rendering/image_metrics.h"
+
+// Renders one view with BlendMode::Sorted (counting sort bins, process_pixels.cs) and BlendMode::WeightedBlended
+// (unsorted bins, process_pixels_weighted.cs), on the GPU and with the CPU rasterizers, and prints the time of
+// every stage and the error of the weighted images against the sorted GPU reference.
+inline void compareBlendModes(SplatRenderer& renderer, const SplatBuffers& buffers, uint32_t numSplats, const SplatView& splatView,
+                              const TileGrid& grid, const QualityLevel& quality, int runs = 10)
+{
+    if (numSplats == 0) return;
+
+    using Clock = std::chrono::steady_clock;
+    auto milliseconds = [](Clock::time_point start) { return std::chrono::duration<float, std::milli>(Clock::now() - start).count(); };
+
+    const uint32_t numVisible = renderer.project(buffers, numSplats, splatView, grid, quality.alphaCutoff);
+    if (numVisible == 0) return;
+    std::vector<OutputData> outputData(numVisible);
+    std::vector<ProjectedSplat> projected(numVisible);
+    renderer.readOutputData(buffers, numVisible, outputData.data());
+    renderer.readProjected(buffers, numVisible, projected.data());
+
+    struct Result {
+        float binning = 0.0f; // ms, mean over the runs
+        float gpuRaster = 0.0f;
+        float cpuRaster = 0.0f;
+        std::vector<float> gpuImage;
+        std::vector<float> cpuImage;
+    };
+    Result results[2];
+    const BlendMode blendModes[2] = {BlendMode::Sorted, BlendMode::WeightedBlended};
+    const BinningMode binningModes[2] = {BinningMode::CountingSort, BinningMode::Unsorted};
+
+    FrameArena arena;
+    for (int m = 0; m < 2; m++) {
+        Result& result = results[m];
+        for (int run = 0; run < runs; run++) {
+            arena.reset();
+            auto start = Clock::now();
+            TileBins bins = binTiles(binningModes[m], outputData.data(), numVisible, arena, grid);
+            result.binning += milliseconds(start) / runs;
+
+            if (renderer.rasterize(buffers, bins, grid, quality.alphaCutoff, quality.maxSplatsPerTile, blendModes[m])) {
+                renderer.waitForTimings();
+                result.gpuRaster += (renderer.gatherTime + renderer.rasterTime) / runs;
+            }
+
+            start = Clock::now();
+            rasterizeCPU(blendModes[m], projected.data(), bins, grid, quality.alphaCutoff, quality.maxSplatsPerTile, result.cpuImage);
+            result.cpuRaster += milliseconds(start) / runs;
+        }
+        renderer.readImage(grid, result.gpuImage);
+    }
+
+    const Result& sorted = results[0];
+    const Result& weighted = results[1];
+    ImageError gpuError = compareImages(weighted.gpuImage, sorted.gpuImage);
+    ImageError cpuError = compareImages(weighted.cpuImage, sorted.cpuImage);
+    ImageError cpuSortedError = compareImages(sorted.cpuImage, sorted.gpuImage);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Blend modes, " << numVisible << " of " << numSplats << " splats visible, " << grid.x * TILE_SIZE << " x " << grid.y * TILE_SIZE
+        << ", mean of " << runs << " runs (ms)" << std::endl;
+    std::cout << "                  binning   GPU gather + raster   CPU raster" << std::endl;
+    for (int m = 0; m < 2; m++) {
+        std::cout << (m == 0 ? "  sorted          " : "  weighted        ") << std::setw(7) << results[m].binning
+            << std::setw(22) << results[m].gpuRaster << std::setw(13) << results[m].cpuRaster << std::endl;
+    }
+    std::cout << std::setprecision(2);
+    std::cout << "  speedup         " << std::setw(6) << sorted.binning / weighted.binning << "x"
+        << std::setw(21) << sorted.gpuRaster / weighted.gpuRaster << "x"
+        << std::setw(12) << sorted.cpuRaster / weighted.cpuRaster << "x" << std::endl;
+    std::cout << "  binning + GPU raster " << (sorted.binning + sorted.gpuRaster) / (weighted.binning + weighted.gpuRaster)
+        << "x faster with weighted blending" << std::endl;
+    std::cout << std::setprecision(4);
+    std::cout << "Weighted vs sorted: GPU PSNR " << gpuError.psnr << " dB, mean error " << gpuError.meanAbs
+        << ", max error " << gpuError.maxAbs << std::endl;
+    std::cout << "                    CPU PSNR " << cpuError.psnr << " dB, mean error " << cpuError.meanAbs
+        << ", max error " << cpuError.maxAbs << std::endl;
+    std::cout << "CPU vs GPU sorted: max error " << cpuSortedError.maxAbs << std::endl;
+    std::cout << std::defaultfloat;
+}
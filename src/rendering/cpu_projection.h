@@ -0,0 +1,455 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "rendering/splat_buffers.h"
+#include "rendering/splat_renderer.h"
+#include "core/job_system.h"
+#include "rendering/tile_binning.h"
+
+// CPU version of splat_covariances.cs: EWA projection of the 3D covariances, eigen decomposition of the 2D
+// covariances, tile rectangles and culling, for hosts without a GPU and as a numerical reference for the shader.
+// The output is the same as the shader's, compacted OutputData and ProjectedSplat records of the visible splats,
+// except that the CPU keeps them in splat order. conic.w holds the splat index on both sides.
+
+const uint32_t CPU_PROJECTION_LANES = 8;
+
+// the six unique entries of the 3D covariances, the positions and opacities as separate arrays, so that
+// CPU_PROJECTION_LANES splats are loaded with one instruction per value
+struct SplatSoA {
+    std::vector<float> xx, xy, xz, yy, yz, zz;
+    std::vector<float> x, y, z;
+    std::vector<float> opacity;
+    std::vector<glm::vec4> colorAndOpacity;
+    uint32_t count = 0;
+
+    SplatSoA(const std::vector<glm::mat4>& covAndPos, const std::vector<glm::vec4>& colorAndOpacity, uint32_t count) :
+        colorAndOpacity(colorAndOpacity.begin(), colorAndOpacity.begin() + count),
+        count(count)
+    {
+        for (std::vector<float>* values : {&xx, &xy, &xz, &yy, &yz, &zz, &x, &y, &z, &opacity}) values->resize(count);
+
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::mat4& m = covAndPos[i];
+            xx[i] = m[0][0]; xy[i] = m[0][1]; xz[i] = m[0][2];
+            yy[i] = m[1][1]; yz[i] = m[1][2]; zz[i] = m[2][2];
+            x[i] = m[3][0]; y[i] = m[3][1]; z[i] = m[3][2];
+            opacity[i] = colorAndOpacity[i].w;
+        }
+    }
+};
+
+namespace cpu_projection_detail {
+
+// the uniforms of splat_covariances.cs, reduced to what the math below uses
+struct Constants {
+    glm::mat4 mvp;
+    glm::vec4 viewZ;    // row of view that gives the view space z
+    glm::vec3 viewRow0; // first two rows of mat3(view)
+    glm::vec3 viewRow1;
+    float scaleX;       // -near / screenRightCoord
+    float scaleY;       // -near / screenTopCoord
+    int gridX;
+    int gridY;
+    float alphaCutoff;
+
+    Constants(const SplatView& splatView, const TileGrid& grid, float alphaCutoff) :
+        mvp(splatView.projection * splatView.view),
+        viewZ(splatView.view[0][2], splatView.view[1][2], splatView.view[2][2], splatView.view[3][2]),
+        viewRow0(splatView.view[0][0], splatView.view[1][0], splatView.view[2][0]),
+        viewRow1(splatView.view[0][1], splatView.view[1][1], splatView.view[2][1]),
+        scaleX(-splatView.near / splatView.screenRight),
+        scaleY(-splatView.near / splatView.screenTop),
+        gridX(static_cast<int>(grid.x)),
+        gridY(static_cast<int>(grid.y)),
+        alphaCutoff(alphaCutoff)
+    {}
+};
+
+const float MAX_CONTOUR_RADIUS = 3.034798181f;
+
+inline float indexBits(uint32_t index) {
+    float bits;
+    std::memcpy(&bits, &index, sizeof(float));
+    return bits;
+}
+
+// One splat, written like the shader. Only the first two rows of J reach the 2D covariance, so
+// JW * cov * transpose(JW) reduces to the quadratic forms of the first two rows of mat3(view).
+inline bool projectSplat(const SplatSoA& s, uint32_t i, const Constants& k, OutputData& out, ProjectedSplat& projected) {
+    const float opacity = s.opacity[i];
+    if (opacity < k.alphaCutoff) return false;
+
+    const glm::vec4 worldPos(s.x[i], s.y[i], s.z[i], 1.0f);
+    const glm::vec4 clipPos = k.mvp * worldPos;
+    if (std::abs(clipPos.z) > clipPos.w) return false;
+
+    const float viewZ = glm::dot(k.viewZ, worldPos);
+    const float a = k.scaleX / viewZ;
+    const float b = k.scaleY / viewZ;
+
+    const glm::mat3 cov(s.xx[i], s.xy[i], s.xz[i], s.xy[i], s.yy[i], s.yz[i], s.xz[i], s.yz[i], s.zz[i]);
+    const glm::vec3 u = cov * k.viewRow0;
+    const glm::vec3 v = cov * k.viewRow1;
+    const float var_x = a * a * glm::dot(k.viewRow0, u);
+    const float cov_xy = a * b * glm::dot(k.viewRow1, u);
+    const float var_y = b * b * glm::dot(k.viewRow1, v);
+
+    const glm::vec4 ndcPos = clipPos / clipPos.w;
+
+    const float varxMinusVary = var_x - var_y;
+    const float root = std::sqrt(varxMinusVary * varxMinusVary + 4.0f * cov_xy * cov_xy);
+    const float greaterEig = ((var_x + var_y) + root) * 0.5f;
+    const float lesserEig = ((var_x + var_y) - root) * 0.5f;
+
+    const float contourRadius = std::min(MAX_CONTOUR_RADIUS, std::sqrt(2.0f * std::log(opacity / k.alphaCutoff)));
+    const float majorAxisLength = contourRadius * std::sqrt(greaterEig);
+    const float minorAxisLength = contourRadius * std::sqrt(lesserEig);
+
+    glm::ivec2 top(static_cast<int>(((ndcPos.x + majorAxisLength) * 0.5f + 0.5f) * k.gridX),
+                   static_cast<int>(((ndcPos.y + majorAxisLength) * 0.5f + 0.5f) * k.gridY));
+    glm::ivec2 bot(static_cast<int>(((ndcPos.x - majorAxisLength) * 0.5f + 0.5f) * k.gridX),
+                   static_cast<int>(((ndcPos.y - majorAxisLength) * 0.5f + 0.5f) * k.gridY));
+
+    if ((top.x < 0 && bot.x < 0) || (top.y < 0 && bot.y < 0) ||
+        (top.x >= k.gridX && bot.x >= k.gridX) || (top.y >= k.gridY && bot.y >= k.gridY)) {
+        return false;
+    }
+
+    out.covariance = glm::mat2(var_x, cov_xy, cov_xy, var_y);
+    out.position = ndcPos;
+    out.clipPos = clipPos;
+    out.topCorner = glm::ivec2(std::min(std::max(top.x, 0), k.gridX - 1), std::min(std::max(top.y, 0), k.gridY - 1));
+    out.botCorner = glm::ivec2(std::min(std::max(bot.x, 0), k.gridX - 1), std::min(std::max(bot.y, 0), k.gridY - 1));
+
+    glm::vec2 major(-cov_xy, var_x - greaterEig);
+    glm::vec2 minor(-cov_xy, var_x - lesserEig);
+    out.majorEigenVec = major * (majorAxisLength / glm::length(major));
+    out.minorEigenVec = minor * (minorAxisLength / glm::length(minor));
+
+    const float invDet = 1.0f / (var_x * var_y - cov_xy * cov_xy);
+    projected.position = ndcPos;
+    projected.conic = glm::vec4(var_y * invDet, -cov_xy * invDet, var_x * invDet, indexBits(i));
+    projected.colorAndOpacity = s.colorAndOpacity[i];
+    return true;
+}
+
+#ifdef __AVX2__
+
+inline __m256 madd(__m256 a, __m256 b, __m256 c) {
+#ifdef __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// natural logarithm of positive normal floats, the single precision polynomial of the Cephes library
+inline __m256 log256(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    // mantissa in [0.5, 1)
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000)));
+
+    __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+    m = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(m, small));
+
+    __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+    for (float c : {-1.1514610310E-1f, 1.1676998740E-1f, -1.2420140846E-1f, 1.4249322787E-1f,
+                    -1.6668057665E-1f, 2.0000714765E-1f, -2.4999993993E-1f, 3.3333331174E-1f}) {
+        y = madd(y, m, _mm256_set1_ps(c));
+    }
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = madd(e, _mm256_set1_ps(-2.12194440E-4f), y);
+    y = madd(z, _mm256_set1_ps(-0.5f), y);
+    return madd(e, _mm256_set1_ps(0.693359375f), _mm256_add_ps(m, y));
+}
+
+// CPU_PROJECTION_LANES splats starting at i, the visible ones are appended to out and projected
+inline uint32_t projectBlock(const SplatSoA& s, uint32_t i, const Constants& k, OutputData* out, ProjectedSplat* projected) {
+    const __m256 opacity = _mm256_loadu_ps(&s.opacity[i]);
+    const __m256 cutoff = _mm256_set1_ps(k.alphaCutoff);
+    __m256 visible = _mm256_cmp_ps(opacity, cutoff, _CMP_GE_OQ);
+    if (_mm256_movemask_ps(visible) == 0) return 0;
+
+    const __m256 x = _mm256_loadu_ps(&s.x[i]);
+    const __m256 y = _mm256_loadu_ps(&s.y[i]);
+    const __m256 z = _mm256_loadu_ps(&s.z[i]);
+
+    auto transform = [&](int row) {
+        return madd(_mm256_set1_ps(k.mvp[0][row]), x, madd(_mm256_set1_ps(k.mvp[1][row]), y,
+            madd(_mm256_set1_ps(k.mvp[2][row]), z, _mm256_set1_ps(k.mvp[3][row]))));
+    };
+    const __m256 clipX = transform(0);
+    const __m256 clipY = transform(1);
+    const __m256 clipZ = transform(2);
+    const __m256 clipW = transform(3);
+
+    // frustum culling (only z)
+    const __m256 absZ = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), clipZ);
+    visible = _mm256_and_ps(visible, _mm256_cmp_ps(absZ, clipW, _CMP_LE_OQ));
+    if (_mm256_movemask_ps(visible) == 0) return 0;
+
+    const __m256 viewZ = madd(_mm256_set1_ps(k.viewZ.x), x, madd(_mm256_set1_ps(k.viewZ.y), y,
+        madd(_mm256_set1_ps(k.viewZ.z), z, _mm256_set1_ps(k.viewZ.w))));
+    const __m256 a = _mm256_div_ps(_mm256_set1_ps(k.scaleX), viewZ);
+    const __m256 b = _mm256_div_ps(_mm256_set1_ps(k.scaleY), viewZ);
+
+    const __m256 xx = _mm256_loadu_ps(&s.xx[i]);
+    const __m256 xy = _mm256_loadu_ps(&s.xy[i]);
+    const __m256 xz = _mm256_loadu_ps(&s.xz[i]);
+    const __m256 yy = _mm256_loadu_ps(&s.yy[i]);
+    const __m256 yz = _mm256_loadu_ps(&s.yz[i]);
+    const __m256 zz = _mm256_loadu_ps(&s.zz[i]);
+
+    // u = cov * viewRow0, v = cov * viewRow1
+    auto covTimes = [&](const glm::vec3& r, __m256& c0, __m256& c1, __m256& c2) {
+        const __m256 r0 = _mm256_set1_ps(r.x), r1 = _mm256_set1_ps(r.y), r2 = _mm256_set1_ps(r.z);
+        c0 = madd(xx, r0, madd(xy, r1, _mm256_mul_ps(xz, r2)));
+        c1 = madd(xy, r0, madd(yy, r1, _mm256_mul_ps(yz, r2)));
+        c2 = madd(xz, r0, madd(yz, r1, _mm256_mul_ps(zz, r2)));
+    };
+    auto dotRow = [](const glm::vec3& r, __m256 c0, __m256 c1, __m256 c2) {
+        return madd(_mm256_set1_ps(r.x), c0, madd(_mm256_set1_ps(r.y), c1, _mm256_mul_ps(_mm256_set1_ps(r.z), c2)));
+    };
+    __m256 u0, u1, u2, v0, v1, v2;
+    covTimes(k.viewRow0, u0, u1, u2);
+    covTimes(k.viewRow1, v0, v1, v2);
+    const __m256 varX = _mm256_mul_ps(_mm256_mul_ps(a, a), dotRow(k.viewRow0, u0, u1, u2));
+    const __m256 covXY = _mm256_mul_ps(_mm256_mul_ps(a, b), dotRow(k.viewRow1, u0, u1, u2));
+    const __m256 varY = _mm256_mul_ps(_mm256_mul_ps(b, b), dotRow(k.viewRow1, v0, v1, v2));
+
+    const __m256 ndcX = _mm256_div_ps(clipX, clipW);
+    const __m256 ndcY = _mm256_div_ps(clipY, clipW);
+    const __m256 ndcZ = _mm256_div_ps(clipZ, clipW);
+
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 diff = _mm256_sub_ps(varX, varY);
+    const __m256 root = _mm256_sqrt_ps(madd(diff, diff, _mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_mul_ps(covXY, covXY))));
+    const __m256 sum = _mm256_add_ps(varX, varY);
+    const __m256 greaterEig = _mm256_mul_ps(_mm256_add_ps(sum, root), half);
+    const __m256 lesserEig = _mm256_mul_ps(_mm256_sub_ps(sum, root), half);
+
+    // the log is only used where the opacity reaches the cutoff, clamp the others to keep it finite
+    const __m256 ratio = _mm256_max_ps(_mm256_div_ps(opacity, cutoff), _mm256_set1_ps(1.0f));
+    const __m256 contourRadius = _mm256_min_ps(_mm256_set1_ps(MAX_CONTOUR_RADIUS),
+        _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), log256(ratio))));
+    const __m256 majorLength = _mm256_mul_ps(contourRadius, _mm256_sqrt_ps(greaterEig));
+    const __m256 minorLength = _mm256_mul_ps(contourRadius, _mm256_sqrt_ps(lesserEig));
+
+    auto tile = [&](__m256 ndc, int gridSize) {
+        return _mm256_cvttps_epi32(_mm256_mul_ps(madd(ndc, half, half), _mm256_set1_ps(static_cast<float>(gridSize))));
+    };
+    const __m256i topX = tile(_mm256_add_ps(ndcX, majorLength), k.gridX);
+    const __m256i topY = tile(_mm256_add_ps(ndcY, majorLength), k.gridY);
+    const __m256i botX = tile(_mm256_sub_ps(ndcX, majorLength), k.gridX);
+    const __m256i botY = tile(_mm256_sub_ps(ndcY, majorLength), k.gridY);
+
+    // completely outside the screen
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lastX = _mm256_set1_epi32(k.gridX - 1);
+    const __m256i lastY = _mm256_set1_epi32(k.gridY - 1);
+    __m256i outside = _mm256_and_si256(_mm256_cmpgt_epi32(zero, topX), _mm256_cmpgt_epi32(zero, botX));
+    outside = _mm256_or_si256(outside, _mm256_and_si256(_mm256_cmpgt_epi32(zero, topY), _mm256_cmpgt_epi32(zero, botY)));
+    outside = _mm256_or_si256(outside, _mm256_and_si256(_mm256_cmpgt_epi32(topX, lastX), _mm256_cmpgt_epi32(botX, lastX)));
+    outside = _mm256_or_si256(outside, _mm256_and_si256(_mm256_cmpgt_epi32(topY, lastY), _mm256_cmpgt_epi32(botY, lastY)));
+    visible = _mm256_andnot_ps(_mm256_castsi256_ps(outside), visible);
+
+    const int mask = _mm256_movemask_ps(visible);
+    if (mask == 0) return 0;
+
+    auto clampTile = [&](__m256i t, __m256i last) { return _mm256_max_epi32(zero, _mm256_min_epi32(t, last)); };
+
+    // eigen vectors scaled to the axis lengths
+    const __m256 negCov = _mm256_sub_ps(_mm256_setzero_ps(), covXY);
+    const __m256 majorY = _mm256_sub_ps(varX, greaterEig);
+    const __m256 minorY = _mm256_sub_ps(varX, lesserEig);
+    const __m256 majorScale = _mm256_div_ps(majorLength, _mm256_sqrt_ps(madd(negCov, negCov, _mm256_mul_ps(majorY, majorY))));
+    const __m256 minorScale = _mm256_div_ps(minorLength, _mm256_sqrt_ps(madd(negCov, negCov, _mm256_mul_ps(minorY, minorY))));
+
+    const __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sub_ps(_mm256_mul_ps(varX, varY), _mm256_mul_ps(covXY, covXY)));
+
+    alignas(32) float lanes[17][CPU_PROJECTION_LANES];
+    alignas(32) int tiles[4][CPU_PROJECTION_LANES];
+    const __m256 values[17] = {
+        varX, covXY, varY, ndcX, ndcY, ndcZ, clipX, clipY, clipZ, clipW,
+        _mm256_mul_ps(negCov, majorScale), _mm256_mul_ps(majorY, majorScale),
+        _mm256_mul_ps(negCov, minorScale), _mm256_mul_ps(minorY, minorScale),
+        _mm256_mul_ps(varY, invDet), _mm256_mul_ps(negCov, invDet), _mm256_mul_ps(varX, invDet)
+    };
+    for (int v = 0; v < 17; v++) _mm256_store_ps(lanes[v], values[v]);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(tiles[0]), clampTile(topX, lastX));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(tiles[1]), clampTile(topY, lastY));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(tiles[2]), clampTile(botX, lastX));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(tiles[3]), clampTile(botY, lastY));
+
+    uint32_t count = 0;
+    for (uint32_t lane = 0; lane < CPU_PROJECTION_LANES; lane++) {
+        if (!(mask & (1 << lane))) continue;
+
+        OutputData& o = out[count];
+        o.covariance = glm::mat2(lanes[0][lane], lanes[1][lane], lanes[1][lane], lanes[2][lane]);
+        o.position = glm::vec4(lanes[3][lane], lanes[4][lane], lanes[5][lane], 1.0f);
+        o.clipPos = glm::vec4(lanes[6][lane], lanes[7][lane], lanes[8][lane], lanes[9][lane]);
+        o.topCorner = glm::ivec2(tiles[0][lane], tiles[1][lane]);
+        o.botCorner = glm::ivec2(tiles[2][lane], tiles[3][lane]);
+        o.majorEigenVec = glm::vec2(lanes[10][lane], lanes[11][lane]);
+        o.minorEigenVec = glm::vec2(lanes[12][lane], lanes[13][lane]);
+
+        ProjectedSplat& p = projected[count];
+        p.position = o.position;
+        p.conic = glm::vec4(lanes[14][lane], lanes[15][lane], lanes[16][lane], indexBits(i + lane));
+        p.colorAndOpacity = s.colorAndOpacity[i + lane];
+        count++;
+    }
+    return count;
+}
+
+#endif
+
+} // namespace cpu_projection_detail
+
+// Projects the splats of a SplatSoA on the job system. The splats are split into numThreads contiguous chunks,
+// every job compacts its visible splats in place and the chunks are then moved together, so the
+// result is in splat order and does not depend on the number of chunks.
+class CpuProjector {
+public:
+    explicit CpuProjector(const SplatSoA& splats) :
+        splats(splats),
+        outputs(splats.count),
+        projections(splats.count)
+    {}
+
+    // the first numSplats splats, returns the number of visible ones. useSimd = false runs the scalar code
+    // for every splat, which is what the vector path is checked against.
+    uint32_t project(uint32_t numSplats, const SplatView& splatView, const TileGrid& grid, float alphaCutoff,
+                     unsigned int numThreads = 0, bool useSimd = true)
+    {
+        numSplats = std::min(numSplats, splats.count);
+        if (numSplats == 0) return numVisible = 0;
+
+        const cpu_projection_detail::Constants constants(splatView, grid, alphaCutoff);
+
+        if (numThreads == 0) numThreads = JobSystem::global().concurrency();
+        // chunks start at multiples of the vector width
+        const uint32_t numBlocks = (numSplats + CPU_PROJECTION_LANES - 1) / CPU_PROJECTION_LANES;
+        numThreads = std::min(numThreads, numBlocks);
+        const uint32_t blocksPerThread = (numBlocks + numThreads - 1) / numThreads;
+
+        std::vector<uint32_t> chunkBegin(numThreads + 1);
+        for (unsigned int t = 0; t <= numThreads; t++) {
+            chunkBegin[t] = std::min(numSplats, t * blocksPerThread * CPU_PROJECTION_LANES);
+        }
+        std::vector<uint32_t> chunkVisible(numThreads, 0);
+
+        auto worker = [&](unsigned int t) {
+            const uint32_t begin = chunkBegin[t];
+            const uint32_t end = chunkBegin[t + 1];
+            OutputData* out = outputs.data() + begin;
+            ProjectedSplat* projected = projections.data() + begin;
+            uint32_t count = 0;
+            uint32_t i = begin;
+
+#ifdef __AVX2__
+            if (useSimd) {
+                for (; i + CPU_PROJECTION_LANES <= end; i += CPU_PROJECTION_LANES) {
+                    count += cpu_projection_detail::projectBlock(splats, i, constants, out + count, projected + count);
+                }
+            }
+#endif
+            for (; i < end; i++) {
+                if (cpu_projection_detail::projectSplat(splats, i, constants, out[count], projected[count])) count++;
+            }
+            chunkVisible[t] = count;
+        };
+
+        JobSystem::global().parallelChunks(numThreads, [&](size_t t) { worker(static_cast<unsigned int>(t)); });
+
+        // close the gaps between the chunks
+        numVisible = chunkVisible[0];
+        for (unsigned int t = 1; t < numThreads; t++) {
+            std::memmove(outputs.data() + numVisible, outputs.data() + chunkBegin[t], chunkVisible[t] * sizeof(OutputData));
+            std::memmove(projections.data() + numVisible, projections.data() + chunkBegin[t], chunkVisible[t] * sizeof(ProjectedSplat));
+            numVisible += chunkVisible[t];
+        }
+        return numVisible;
+    }
+
+    const OutputData* outputData() const { return outputs.data(); }
+    const ProjectedSplat* projected() const { return projections.data(); }
+    uint32_t visibleCount() const { return numVisible; }
+
+private:
+    const SplatSoA& splats;
+    std::vector<OutputData> outputs;
+    std::vector<ProjectedSplat> projections;
+    uint32_t numVisible = 0;
+};
+
+// difference between two projections of the same view, matched by the splat index in conic.w
+struct ProjectionDifference {
+    uint32_t countA = 0;
+    uint32_t countB = 0;
+    uint32_t unmatched = 0;        // visible in one projection only
+    uint32_t cornerMismatches = 0; // tile rectangles that differ, from rounding at tile borders
+    float maxPositionError = 0.0f; // ndc
+    float maxConicError = 0.0f;    // relative to the largest conic entry of the splat
+};
+
+inline ProjectionDifference compareProjections(const OutputData* outputA, const ProjectedSplat* projectedA, uint32_t countA,
+                                               const OutputData* outputB, const ProjectedSplat* projectedB, uint32_t countB,
+                                               uint32_t numSplats)
+{
+    auto index = [](const ProjectedSplat& p) {
+        uint32_t i;
+        std::memcpy(&i, &p.conic.w, sizeof(uint32_t));
+        return i;
+    };
+
+    ProjectionDifference difference;
+    difference.countA = countA;
+    difference.countB = countB;
+
+    std::vector<uint32_t> slotB(numSplats, UINT32_MAX);
+    for (uint32_t j = 0; j < countB; j++) {
+        uint32_t i = index(projectedB[j]);
+        if (i < numSplats) slotB[i] = j;
+    }
+
+    uint32_t matched = 0;
+    for (uint32_t j = 0; j < countA; j++) {
+        uint32_t i = index(projectedA[j]);
+        if (i >= numSplats || slotB[i] == UINT32_MAX) {
+            difference.unmatched++;
+            continue;
+        }
+        matched++;
+        const OutputData& a = outputA[j];
+        const OutputData& b = outputB[slotB[i]];
+        if (a.topCorner != b.topCorner || a.botCorner != b.botCorner) difference.cornerMismatches++;
+
+        difference.maxPositionError = std::max({difference.maxPositionError,
+            std::abs(a.position.x - b.position.x), std::abs(a.position.y - b.position.y), std::abs(a.position.z - b.position.z)});
+
+        const glm::vec4& ca = projectedA[j].conic;
+        const glm::vec4& cb = projectedB[slotB[i]].conic;
+        const float scale = std::max({std::abs(cb.x), std::abs(cb.y), std::abs(cb.z), 1e-20f});
+        difference.maxConicError = std::max({difference.maxConicError,
+            std::abs(ca.x - cb.x) / scale, std::abs(ca.y - cb.y) / scale, std::abs(ca.z - cb.z) / scale});
+    }
+    difference.unmatched += countB - matched;
+    return difference;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "core/job_system.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/tile_binning.h"
+
+// CPU versions of the rasterization passes, pixel for pixel the same math as the compute shaders.
+// Splats are read through the bins (splats[bins.sortedIndices[i]]) instead of the gathered tile lists,
+// the large splats of the bins are merged into the tiles by depth like in the shaders.
+// The image has grid.x * 16 by grid.y * 16 RGB pixels with the bottom row first, like SplatRenderer::readImage.
+
+const float CPU_SATURATION_THRESHOLD = 0.01f;
+const float CPU_BACKGROUND_COLOR = 0.5f;
+
+namespace cpu_rasterizer_detail {
+
+// tiles per job, the cost of a tile varies a lot so the jobs are small and get stolen by idle workers
+const uint32_t TILES_PER_JOB = 8;
+
+// calls shade(tile, x, y, ndc) for every pixel
+template<typename Shade>
+void forEachPixel(const TileGrid& grid, Shade&& shade) {
+    const float width = static_cast<float>(grid.x * 16);
+    const float height = static_cast<float>(grid.y * 16);
+
+    JobSystem::global().parallelFor(0, grid.count(), TILES_PER_JOB, [&](size_t begin, size_t end) {
+        for (uint32_t tile = static_cast<uint32_t>(begin); tile < end; tile++) {
+            const uint32_t tileX = tile % grid.x;
+            const uint32_t tileY = tile / grid.x;
+            for (uint32_t py = 0; py < 16; py++) {
+                for (uint32_t px = 0; px < 16; px++) {
+                    const uint32_t x = tileX * 16 + px;
+                    const uint32_t y = tileY * 16 + py;
+                    glm::vec2 ndc(x / width * 2.0f - 1.0f, y / height * 2.0f - 1.0f);
+                    shade(tile, x, y, ndc);
+                }
+            }
+        }
+    });
+}
+
+inline float splatAlpha(const ProjectedSplat& splat, const glm::vec2& ndc) {
+    glm::vec2 diff = ndc - glm::vec2(splat.position);
+    float shape = splat.conic.x * diff.x * diff.x + 2.0f * splat.conic.y * diff.x * diff.y + splat.conic.z * diff.y * diff.y;
+    return std::min(splat.colorAndOpacity.w * std::exp(-0.5f * shape), 0.99f);
+}
+
+// the first large splat from index on whose rect contains the tile, or the number of large splats
+inline uint32_t nextLargeSplat(const TileBins& bins, uint32_t index, uint32_t tile, const TileGrid& grid) {
+    const int tileX = static_cast<int>(tile % grid.x);
+    const int tileY = static_cast<int>(tile / grid.x);
+    const uint32_t numLarge = static_cast<uint32_t>(bins.largeSplats.size());
+    for (; index < numLarge; index++) {
+        const glm::ivec4& rect = bins.largeRects[index];
+        if (tileX >= rect.x && tileY >= rect.y && tileX <= rect.z && tileY <= rect.w) break;
+    }
+    return index;
+}
+
+} // namespace cpu_rasterizer_detail
+
+// process_pixels.cs: front to back compositing of depth sorted bins
+inline void rasterizeSortedCPU(const ProjectedSplat* splats, const TileBins& bins, const TileGrid& grid, float alphaCutoff,
+                               uint32_t maxSplatsPerTile, std::vector<float>& rgb)
+{
+    const uint32_t width = grid.x * 16;
+    rgb.assign(static_cast<size_t>(width) * grid.y * 16 * 3, 0.0f);
+    cpu_rasterizer_detail::forEachPixel(grid, [&](uint32_t tile, uint32_t x, uint32_t y, const glm::vec2& ndc) {
+        const uint32_t begin = bins.ranges[tile];
+        const uint32_t count = std::min(bins.ranges[tile + 1] - begin, maxSplatsPerTile);
+
+        glm::vec3 L(0.0f);
+        float T_i = 1.0f;
+        float T_next = 1.0f;
+        // true once the pixel is saturated
+        auto blend = [&](const ProjectedSplat& splat) {
+            float alpha = cpu_rasterizer_detail::splatAlpha(splat, ndc);
+            if (alpha < alphaCutoff) return false;
+
+            T_next = T_i * (1.0f - alpha);
+            if (T_next < CPU_SATURATION_THRESHOLD) return true;
+
+            L += glm::vec3(splat.colorAndOpacity) * alpha * T_i;
+            T_i = T_next;
+            return false;
+        };
+
+        const uint32_t numLarge = static_cast<uint32_t>(bins.largeSplats.size());
+        uint32_t large = cpu_rasterizer_detail::nextLargeSplat(bins, 0, tile, grid);
+        bool done = false;
+        for (uint32_t i = 0; !done && i < count; i++) {
+            const ProjectedSplat& splat = splats[bins.sortedIndices[begin + i]];
+            // the large splats in front of this one first
+            for (; !done && large < numLarge && splats[bins.largeSplats[large]].position.z < splat.position.z;
+                 large = cpu_rasterizer_detail::nextLargeSplat(bins, large + 1, tile, grid)) {
+                done = blend(splats[bins.largeSplats[large]]);
+            }
+            if (!done) done = blend(splat);
+        }
+        for (; !done && large < numLarge; large = cpu_rasterizer_detail::nextLargeSplat(bins, large + 1, tile, grid)) {
+            done = blend(splats[bins.largeSplats[large]]);
+        }
+        // as in the shader, the background gets the transmittance of the last visited splat
+        L += glm::vec3(CPU_BACKGROUND_COLOR) * T_next;
+
+        float* pixel = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+        pixel[0] = L.x;
+        pixel[1] = L.y;
+        pixel[2] = L.z;
+    });
+}
+
+// process_pixels_weighted.cs and resolve_weighted.cs: weighted blended order independent transparency, any bin order.
+// Like the shader it blends every splat of a tile, the splat limit only applies to depth sorted bins
+inline void rasterizeWeightedCPU(const ProjectedSplat* splats, const TileBins& bins, const TileGrid& grid, float alphaCutoff,
+                                 std::vector<float>& rgb)
+{
+    const uint32_t width = grid.x * 16;
+    rgb.assign(static_cast<size_t>(width) * grid.y * 16 * 3, 0.0f);
+
+    cpu_rasterizer_detail::forEachPixel(grid, [&](uint32_t tile, uint32_t x, uint32_t y, const glm::vec2& ndc) {
+        const uint32_t begin = bins.ranges[tile];
+        const uint32_t count = bins.ranges[tile + 1] - begin;
+
+        glm::vec4 accum(0.0f);
+        float revealage = 1.0f;
+        auto accumulate = [&](const ProjectedSplat& splat) {
+            float alpha = cpu_rasterizer_detail::splatAlpha(splat, ndc);
+            if (alpha < alphaCutoff) return;
+
+            float d = 1.0f - std::min(1.0f, std::max(0.0f, splat.position.z * 0.5f + 0.5f));
+            float weight = alpha * std::min(3e3f, std::max(1e-2f, 3e3f * d * d * d));
+
+            accum += glm::vec4(glm::vec3(splat.colorAndOpacity) * weight, weight);
+            revealage *= 1.0f - alpha;
+        };
+
+        for (uint32_t i = 0; i < count; i++) accumulate(splats[bins.sortedIndices[begin + i]]);
+        // the large splats after the tile's own, as in the shader
+        const uint32_t numLarge = static_cast<uint32_t>(bins.largeSplats.size());
+        for (uint32_t large = cpu_rasterizer_detail::nextLargeSplat(bins, 0, tile, grid); large < numLarge;
+             large = cpu_rasterizer_detail::nextLargeSplat(bins, large + 1, tile, grid)) {
+            accumulate(splats[bins.largeSplats[large]]);
+        }
+
+        // resolve
+        glm::vec3 color = glm::vec3(accum) / std::max(accum.w, 1e-5f);
+        glm::vec3 L = color * (1.0f - revealage) + glm::vec3(CPU_BACKGROUND_COLOR) * revealage;
+
+        float* pixel = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+        pixel[0] = L.x;
+        pixel[1] = L.y;
+        pixel[2] = L.z;
+    });
+}
+
+inline void rasterizeCPU(BlendMode blendMode, const ProjectedSplat* splats, const TileBins& bins, const TileGrid& grid, float alphaCutoff,
+                         uint32_t maxSplatsPerTile, std::vector<float>& rgb)
+{
+    if (blendMode == BlendMode::Sorted) rasterizeSortedCPU(splats, bins, grid, alphaCutoff, maxSplatsPerTile, rgb);
+    else rasterizeWeightedCPU(splats, bins, grid, alphaCutoff, rgb);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+// Peak signal to noise ratio (dB) of a rendered image against a reference photo.
+// rendered holds width x height RGB values in [0, 1] with the bottom row first, as read from the render texture.
+// reference is an 8 bit image with the top row first and at least 3 channels; it is box filtered down
+// (or point sampled up) to the rendered size, so both images should have about the same aspect ratio.
+inline double psnr(const std::vector<float>& rendered, uint32_t width, uint32_t height,
+                   const unsigned char* reference, int refWidth, int refHeight, int channels)
+{
+    double squaredError = 0.0;
+
+    for (uint32_t y = 0; y < height; y++) {
+        // reference rows covered by rendered row y, counted from the top
+        const uint32_t row = height - 1 - y;
+        const int y0 = static_cast<int>(static_cast<uint64_t>(row) * refHeight / height);
+        const int y1 = std::max(y0 + 1, static_cast<int>(static_cast<uint64_t>(row + 1) * refHeight / height));
+
+        for (uint32_t x = 0; x < width; x++) {
+            const int x0 = static_cast<int>(static_cast<uint64_t>(x) * refWidth / width);
+            const int x1 = std::max(x0 + 1, static_cast<int>(static_cast<uint64_t>(x + 1) * refWidth / width));
+
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            for (int ry = y0; ry < y1; ry++) {
+                const unsigned char* pixel = reference + (static_cast<size_t>(ry) * refWidth + x0) * channels;
+                for (int rx = x0; rx < x1; rx++, pixel += channels) {
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                }
+            }
+            const float norm = 1.0f / (255.0f * (y1 - y0) * (x1 - x0));
+
+            const float* value = &rendered[(static_cast<size_t>(y) * width + x) * 3];
+            for (int c = 0; c < 3; c++) {
+                double diff = std::min(1.0f, std::max(0.0f, value[c])) - sum[c] * norm;
+                squaredError += diff * diff;
+            }
+        }
+    }
+
+    const double mse = squaredError / (static_cast<double>(width) * height * 3);
+    if (mse == 0.0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(1.0 / mse);
+}
+
+// rendered image as 8 bit RGB with the top row first, for writing to disk
+inline std::vector<unsigned char> toImage8(const std::vector<float>& rendered, uint32_t width, uint32_t height) {
+    std::vector<unsigned char> image(static_cast<size_t>(width) * height * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        const float* src = &rendered[static_cast<size_t>(y) * width * 3];
+        unsigned char* dst = &image[static_cast<size_t>(height - 1 - y) * width * 3];
+        for (uint32_t i = 0; i < width * 3; i++) {
+            dst[i] = static_cast<unsigned char>(std::lround(std::min(1.0f, std::max(0.0f, src[i])) * 255.0f));
+        }
+    }
+    return image;
+}
+
+struct ImageError {
+    double psnr;    // dB, infinite for identical images
+    double meanAbs; // mean absolute difference per channel
+    double maxAbs;
+};
+
+// difference of two rendered images of the same size, values clamped to [0, 1] as they would be displayed
+inline ImageError compareImages(const std::vector<float>& image, const std::vector<float>& reference) {
+    ImageError error = {std::numeric_limits<double>::infinity(), 0.0, 0.0};
+    const size_t count = std::min(image.size(), reference.size());
+    if (count == 0) return error;
+
+    double squaredError = 0.0;
+    double absError = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double diff = std::abs(std::min(1.0f, std::max(0.0f, image[i])) - std::min(1.0f, std::max(0.0f, reference[i])));
+        squaredError += diff * diff;
+        absError += diff;
+        error.maxAbs = std::max(error.maxAbs, diff);
+    }
+
+    const double mse = squaredError / count;
+    if (mse > 0.0) error.psnr = 10.0 * std::log10(1.0 / mse);
+    error.meanAbs = absError / count;
+    return error;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "rendering/tile_binning.h"
+
+// Temporal occlusion culling. process_pixels.cs records per tile the farthest depth at which its pixels
+// saturated (SplatRenderer::readTileSaturation); nothing behind it contributed to the tile. The next frame
+// reprojects these occluders to its own tiles and the binning drops the entries behind them before the depth sort.
+//
+// The reprojection is conservative only up to the parallax between two frames: every saturated tile is
+// unprojected at its saturation depth and its footprint in the new view gives the tiles it covers the farthest
+// of its reprojected depths. A new tile gets an occluder only if it and its 8 neighbours are covered by saturated
+// tiles alone, which keeps a margin of one tile to everything that was not saturated, off screen or disoccluded.
+// The coverage has a ring of tiles around the screen for the part of the view that was off screen before.
+// A tile that no longer saturates after a wrong cull records no occluder, so errors last one frame.
+class OcclusionCuller {
+public:
+    // tiles with an occluder after the last reproject()
+    uint32_t occluderTiles = 0;
+
+    // call after a BlendMode::Sorted rasterize() with the saturation of its tiles and the view it was rendered with
+    void update(const std::vector<uint32_t>& saturation, const TileGrid& grid, const glm::mat4& viewProjection) {
+        previousSaturation = saturation;
+        previousGrid = grid;
+        previousViewProjection = viewProjection;
+        valid = true;
+    }
+
+    // forgets the previous frame, e.g. when the model changes or the frames are not rendered with BlendMode::Sorted
+    void reset() {
+        valid = false;
+        occluderTiles = 0;
+    }
+
+    // the occluders of the previous frame in the tiles of a new view, nullptr if there is no previous frame
+    const TileOccluders* reproject(const glm::mat4& viewProjection, const TileGrid& grid) {
+        occluderTiles = 0;
+        if (!valid) return nullptr;
+
+        // with the ring around the screen, tile (x, y) is at (x + 1, y + 1)
+        const uint32_t width = grid.x + 2;
+        std::vector<float> farthest(width * (grid.y + 2), -1.0f);
+        std::vector<uint8_t> coverage(width * (grid.y + 2), 0);
+        const glm::mat4 toWorld = glm::inverse(previousViewProjection);
+
+        for (uint32_t ty = 0; ty < previousGrid.y; ty++) {
+            for (uint32_t tx = 0; tx < previousGrid.x; tx++) {
+                const uint32_t tile = ty * previousGrid.x + tx;
+                const float depth = saturationDepth(previousSaturation[tile]);
+
+                if (depth < 1.0f) {
+                    Footprint footprint = reprojectTile(toWorld, viewProjection, tx, ty, &depth, 1, grid);
+                    if (!footprint.valid) continue;
+                    for (uint32_t y = footprint.y0; y <= footprint.y1; y++) {
+                        for (uint32_t x = footprint.x0; x <= footprint.x1; x++) {
+                            coverage[y * width + x] |= COVERED;
+                            farthest[y * width + x] = std::max(farthest[y * width + x], footprint.farthest);
+                        }
+                    }
+                } else {
+                    // the content of an open tile may be at any depth, its footprint spans from the far plane
+                    // to the nearest saturated neighbour, which moves the most with parallax
+                    const float depths[2] = {1.0f, nearestNeighbourDepth(tx, ty)};
+                    Footprint footprint = reprojectTile(toWorld, viewProjection, tx, ty, depths, depths[1] < 1.0f ? 2 : 1, grid);
+                    if (!footprint.valid) {
+                        // partly behind the new camera, nothing is known
+                        if (footprint.behind) return nullptr;
+                        continue;
+                    }
+                    for (uint32_t y = footprint.y0; y <= footprint.y1; y++) {
+                        for (uint32_t x = footprint.x0; x <= footprint.x1; x++) {
+                            coverage[y * width + x] |= OPEN;
+                        }
+                    }
+                }
+            }
+        }
+
+        occluders.depthKeys.assign(grid.count(), NO_OCCLUDER);
+        for (uint32_t y = 0; y < grid.y; y++) {
+            for (uint32_t x = 0; x < grid.x; x++) {
+                if (!occludedNeighbourhood(coverage, width, x + 1, y + 1)) continue;
+
+                // at or in front of the near plane the depth keys wrap around, see process_pixels.cs
+                const float depth = farthest[(y + 1) * width + x + 1];
+                if (depth <= 0.0f || depth >= 1.0f) continue;
+                occluders.depthKeys[y * grid.x + x] = static_cast<uint32_t>(depth * 0xFFFF);
+                occluderTiles++;
+            }
+        }
+        return &occluders;
+    }
+
+private:
+    enum : uint8_t {
+        COVERED = 1, // touched by a reprojected saturated tile
+        OPEN = 2     // touched by a reprojected tile that did not saturate
+    };
+
+    struct Footprint {
+        bool valid = false;
+        bool behind = false;   // a corner is behind the new camera
+        uint32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0; // inclusive bounds in the new grid with the ring, tile x is at x + 1
+        float farthest = -1.0f; // ndc depth
+    };
+
+    // ndc depth of a saturated tile, 1 (the far plane, no occlusion) otherwise
+    static float saturationDepth(uint32_t saturation) {
+        if (saturation == NO_SATURATION) return 1.0f;
+        float depth;
+        std::memcpy(&depth, &saturation, sizeof(depth));
+        return std::min(depth, 1.0f);
+    }
+
+    float nearestNeighbourDepth(uint32_t tx, uint32_t ty) const {
+        float nearest = 1.0f;
+        for (uint32_t y = ty > 0 ? ty - 1 : 0; y <= std::min(ty + 1, previousGrid.y - 1); y++) {
+            for (uint32_t x = tx > 0 ? tx - 1 : 0; x <= std::min(tx + 1, previousGrid.x - 1); x++) {
+                nearest = std::min(nearest, saturationDepth(previousSaturation[y * previousGrid.x + x]));
+            }
+        }
+        return nearest;
+    }
+
+    // the tiles of the new grid (and of the ring around it) touched by the corners of previous tile (tx, ty)
+    // unprojected at the given depths
+    Footprint reprojectTile(const glm::mat4& toWorld, const glm::mat4& viewProjection, uint32_t tx, uint32_t ty,
+                            const float* depths, int numDepths, const TileGrid& grid) const {
+        Footprint footprint;
+        glm::vec2 lo(1e30f), hi(-1e30f);
+
+        for (int d = 0; d < numDepths; d++) {
+            for (int corner = 0; corner < 4; corner++) {
+                const float x = static_cast<float>(tx + (corner & 1)) / previousGrid.x * 2.0f - 1.0f;
+                const float y = static_cast<float>(ty + (corner >> 1)) / previousGrid.y * 2.0f - 1.0f;
+
+                glm::vec4 world = toWorld * glm::vec4(x, y, depths[d], 1.0f);
+                glm::vec4 clip = viewProjection * glm::vec4(glm::vec3(world) / world.w, 1.0f);
+                if (clip.w <= 1e-6f) {
+                    footprint.behind = true;
+                    return footprint;
+                }
+
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                lo.x = std::min(lo.x, ndc.x);
+                lo.y = std::min(lo.y, ndc.y);
+                hi.x = std::max(hi.x, ndc.x);
+                hi.y = std::max(hi.y, ndc.y);
+                footprint.farthest = std::max(footprint.farthest, ndc.z);
+            }
+        }
+
+        // tile indices as computed by splat_covariances.cs, a footprint that reaches the edge of the screen
+        // covers the ring so that the border tiles keep their occluders while the camera stands still
+        const float edge = 1.0f - 1e-4f;
+        const float x0 = lo.x <= -edge ? -1.0f : std::floor((lo.x * 0.5f + 0.5f) * grid.x);
+        const float y0 = lo.y <= -edge ? -1.0f : std::floor((lo.y * 0.5f + 0.5f) * grid.y);
+        const float x1 = hi.x >= edge ? static_cast<float>(grid.x) : std::floor((hi.x * 0.5f + 0.5f) * grid.x);
+        const float y1 = hi.y >= edge ? static_cast<float>(grid.y) : std::floor((hi.y * 0.5f + 0.5f) * grid.y);
+        if (x1 < -1.0f || y1 < -1.0f || x0 > grid.x || y0 > grid.y) return footprint;
+
+        footprint.valid = true;
+        footprint.x0 = static_cast<uint32_t>(std::max(x0, -1.0f) + 1.0f);
+        footprint.y0 = static_cast<uint32_t>(std::max(y0, -1.0f) + 1.0f);
+        footprint.x1 = static_cast<uint32_t>(std::min(x1, static_cast<float>(grid.x)) + 1.0f);
+        footprint.y1 = static_cast<uint32_t>(std::min(y1, static_cast<float>(grid.y)) + 1.0f);
+        return footprint;
+    }
+
+    // the tile at (x, y) of the coverage and its 8 neighbours are covered by saturated tiles only
+    static bool occludedNeighbourhood(const std::vector<uint8_t>& coverage, uint32_t width, uint32_t x, uint32_t y) {
+        for (uint32_t j = y - 1; j <= y + 1; j++) {
+            for (uint32_t i = x - 1; i <= x + 1; i++) {
+                if (coverage[j * width + i] != COVERED) return false;
+            }
+        }
+        return true;
+    }
+
+    bool valid = false;
+    std::vector<uint32_t> previousSaturation;
+    TileGrid previousGrid;
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+    TileOccluders occluders;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "graphics/shader.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/splat_renderer.h"
+
+// Cheap stand-in for the tile rasterization while the camera moves: every resident splat is one depth tested point
+// sprite with the area of its projected footprint and the splat's color (pointcloud.vs, pointcloud.fs), drawn
+// straight from the splat buffers. There is no projection readback, no binning and no sort; the transparency of
+// a splat becomes a screen door pattern, so the nearest opaque splats win the depth test.
+class PointPreview {
+public:
+    PointPreview() : shader("resources/shaders/pointcloud.vs", "resources/shaders/pointcloud.fs") {
+        // sprites of large splats close to the camera are clamped to what the driver rasterizes
+        GLfloat range[2] = {1.0f, 64.0f};
+        glGetFloatv(GL_POINT_SIZE_RANGE, range);
+        maxPointSize = std::max(range[1], 1.0f);
+    }
+
+    // into the bound framebuffer, which is cleared, with a viewport of width x height pixels
+    void draw(const SplatBuffers& buffers, uint32_t numSplats, const SplatView& splatView, uint32_t width, uint32_t height, float alphaCutoff) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers.inputCovSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, buffers.colorAndOpacitySSBO);
+
+        shader.use();
+        shader.setMat4("view", splatView.view);
+        shader.setMat4("mvp", splatView.projection * splatView.view);
+        shader.setFloat("near", splatView.near);
+        shader.setFloat("screenRightCoord", splatView.screenRight);
+        shader.setFloat("screenTopCoord", splatView.screenTop);
+        shader.setVec2("viewportSize", static_cast<float>(width), static_cast<float>(height));
+        shader.setFloat("alphaCutoff", alphaCutoff);
+        shader.setFloat("maxPointSize", maxPointSize);
+
+        // the BACKGROUND_COLOR of the rasterization passes
+        glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+
+        glBindVertexArray(buffers.pcVAO);
+        glDrawArrays(GL_POINTS, 0, numSplats);
+        glBindVertexArray(0);
+
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+private:
+    Shader shader;
+    float maxPointSize = 1.0f;
+};
+
+// Whether the camera is moving: the view changed in the last settleSeconds. The hold keeps the preview through
+// the short pauses between the input events of one motion instead of flickering back to full quality.
+class CameraMotion {
+public:
+    float settleSeconds;
+
+    CameraMotion(float settleSeconds = 0.2f) : settleSeconds(settleSeconds) {}
+
+    // call once per frame with the frame's view and time in seconds
+    bool update(const glm::mat4& view, float time) {
+        bool changed = !hasView;
+        for (int c = 0; c < 4 && !changed; c++) {
+            for (int r = 0; r < 4 && !changed; r++) {
+                changed = std::abs(view[c][r] - lastView[c][r]) > EPSILON;
+            }
+        }
+        if (changed && hasView) lastChange = time;
+        lastView = view;
+        hasView = true;
+        return moving(time);
+    }
+
+    bool moving(float time) const { return hasView && time - lastChange < settleSeconds; }
+
+private:
+    static constexpr float EPSILON = 1e-6f;
+
+    glm::mat4 lastView = glm::mat4(1.0f);
+    float lastChange = -1e30f;
+    bool hasView = false;
+};
+
+// Smoothed frame times of the full tile rasterization and of the point preview, each only from its own frames
+struct RenderModeTimes {
+    float full = 0.0f;    // ms
+    float preview = 0.0f; // ms
+
+    void add(bool previewFrame, float frameTime) {
+        float& smoothed = previewFrame ? preview : full;
+        smoothed = smoothed == 0.0f ? frameTime : smoothed + SMOOTHING * (frameTime - smoothed);
+    }
+
+private:
+    static constexpr float SMOOTHING = 0.1f;
+};
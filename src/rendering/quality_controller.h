@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "rendering/tile_binning.h"
+
+// Settings that trade image quality for frame time
+struct QualityLevel {
+    float renderScale;         // fraction of the 800 x 800 texture that is rendered, upscaled by the quad pass
+    float alphaCutoff;         // splats are skipped where their alpha is below this, it also shrinks their tile footprint
+    uint32_t maxSplatsPerTile; // the farthest splats of a tile beyond this are dropped; only for depth sorted bins,
+                               // weighted blending keeps every splat
+};
+
+// from full quality to cheapest
+const QualityLevel QUALITY_LEVELS[] = {
+    {1.00f, 1.0f / 255.0f, 800},
+    {1.00f, 2.0f / 255.0f, 640},
+    {0.76f, 2.0f / 255.0f, 512},
+    {0.76f, 4.0f / 255.0f, 384},
+    {0.50f, 4.0f / 255.0f, 256},
+    {0.50f, 8.0f / 255.0f, 192},
+};
+const int NUM_QUALITY_LEVELS = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+// CPU and GPU time of the stages of one frame, in milliseconds
+struct StageTimings {
+    float projection = 0.0f;
+    float binning = 0.0f;
+    float gather = 0.0f;
+    float raster = 0.0f;
+};
+
+// Closed loop controller that picks the QualityLevel holding a target frame time.
+// The frame time is smoothed, and the level only drops after a few frames over budget and only rises
+// after a long stretch well under budget. If a raised level has to be dropped again soon, the next
+// attempt waits twice as long, so the controller settles instead of oscillating between two levels.
+class QualityController {
+public:
+    bool enabled = false;
+    float targetFrameTime; // ms
+
+    QualityController(float targetFrameTime = 16.0f) : targetFrameTime(targetFrameTime) {}
+
+    // writes one csv line per frame: frame, level, frame time and the stage timings
+    bool openLog(const std::string& file) {
+        log.open(file);
+        if (!log) {
+            std::cerr << "Could not write quality log " << file << std::endl;
+            return false;
+        }
+        log << "frame,level,render_scale,alpha_cutoff,max_splats_per_tile,frame_ms,smoothed_ms,projection_ms,binning_ms,gather_ms,raster_ms" << std::endl;
+        return true;
+    }
+
+    // call once per frame with the measured timings, returns true if the level changed
+    bool update(float frameTime, const StageTimings& stages) {
+        frame++;
+        smoothed = smoothed == 0.0f ? frameTime : smoothed + SMOOTHING * (frameTime - smoothed);
+
+        if (log) {
+            const QualityLevel& q = settings();
+            log << frame << "," << currentLevel << "," << q.renderScale << "," << q.alphaCutoff << "," << q.maxSplatsPerTile << ","
+                << frameTime << "," << smoothed << "," << stages.projection << "," << stages.binning << ","
+                << stages.gather << "," << stages.raster << "\n";
+        }
+
+        if (!enabled) return setLevel(0, stages);
+
+        sinceChange++;
+        if (sinceChange < SETTLE_FRAMES) return false;
+
+        overBudget = smoothed > targetFrameTime ? overBudget + 1 : 0;
+        underBudget = smoothed < UPGRADE_FRACTION * targetFrameTime ? underBudget + 1 : 0;
+
+        if (overBudget >= DEGRADE_FRAMES && currentLevel + 1 < NUM_QUALITY_LEVELS) {
+            // the last upgrade did not hold, be more patient with the next one
+            if (lastChangeWasUpgrade && sinceChange < upgradeFrames) {
+                upgradeFrames = std::min(upgradeFrames * 2, MAX_UPGRADE_FRAMES);
+            }
+            return setLevel(currentLevel + 1, stages);
+        }
+        if (underBudget >= upgradeFrames && currentLevel > 0) {
+            return setLevel(currentLevel - 1, stages);
+        }
+
+        // stable for a long time, allow quick upgrades again
+        if (sinceChange > 4 * MAX_UPGRADE_FRAMES) upgradeFrames = MIN_UPGRADE_FRAMES;
+        return false;
+    }
+
+    int level() const { return currentLevel; }
+    const QualityLevel& settings() const { return QUALITY_LEVELS[currentLevel]; }
+    float smoothedFrameTime() const { return smoothed; }
+
+    TileGrid tileGrid() const {
+        TileGrid grid;
+        grid.x = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(NUM_TILES_X * settings().renderScale)));
+        grid.y = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(NUM_TILES_Y * settings().renderScale)));
+        return grid;
+    }
+
+private:
+    static constexpr float SMOOTHING = 0.2f;
+    static constexpr float UPGRADE_FRACTION = 0.7f;
+    static constexpr int DEGRADE_FRAMES = 3;
+    static constexpr int SETTLE_FRAMES = 10;
+    static constexpr int MIN_UPGRADE_FRAMES = 60;
+    static constexpr int MAX_UPGRADE_FRAMES = 960;
+
+    int currentLevel = 0;
+    float smoothed = 0.0f;
+    uint64_t frame = 0;
+    int sinceChange = 0;
+    int overBudget = 0;
+    int underBudget = 0;
+    int upgradeFrames = MIN_UPGRADE_FRAMES;
+    bool lastChangeWasUpgrade = false;
+    std::ofstream log;
+
+    bool setLevel(int newLevel, const StageTimings& stages) {
+        if (newLevel == currentLevel) return false;
+
+        const QualityLevel& q = QUALITY_LEVELS[newLevel];
+        std::cout << "Quality level " << currentLevel << " -> " << newLevel
+            << " (scale " << q.renderScale << ", alpha cutoff " << q.alphaCutoff << ", max " << q.maxSplatsPerTile << " splats/tile)"
+            << " frame " << smoothed << " ms, target " << targetFrameTime << " ms"
+            << " [projection " << stages.projection << ", binning " << stages.binning
+            << ", gather " << stages.gather << ", raster " << stages.raster << "]" << std::endl;
+
+        lastChangeWasUpgrade = newLevel < currentLevel;
+        currentLevel = newLevel;
+        sinceChange = 0;
+        overBudget = 0;
+        underBudget = 0;
+        return true;
+    }
+};
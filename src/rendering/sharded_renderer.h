@@ -0,0 +1,569 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stb_image_write.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <csignal>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/frame_arena.h"
+#include "core/job_system.h"
+#include "core/shard_transport.h"
+#include "model_loading/splat_model.h"
+#include "model_loading/scene_file.h"
+#include "rendering/splat_renderer.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/tile_binning.h"
+#include "rendering/quality_controller.h"
+
+// Offline rendering of frames larger than the tile grid, or of many frames, split over several processes.
+// The coordinator loads the model once, writes it as a scene file (scene_file.h) that every worker maps, and hands
+// out tasks: rectangles of frame tiles, either bands of tile rows of every frame or whole frames. A worker renders
+// its rectangle at the native resolution of the frame in pieces of at most NUM_TILES_X x NUM_TILES_Y tiles,
+// each a crop of the frame's view (SplatView::crop), and sends the 8 bit pixels back; the coordinator
+// reassembles the frames and writes them as PNG.
+//
+// Local workers are started by the coordinator and connect over a unix socket; workers on other hosts run
+// --shard-worker tcp:host:port themselves and map the scene file from shared storage.
+enum class ShardMessage : uint32_t {
+    Scene = 1, // coordinator to worker: path of the scene file
+    Ready,     // worker to coordinator: ShardReady, the scene is uploaded
+    Task,      // coordinator to worker: ShardTask
+    Result,    // worker to coordinator: ShardResult followed by the pixels of the task
+    Quit       // coordinator to worker
+};
+
+struct ShardReady {
+    uint32_t numSplats;
+    float mapTime;    // ms
+    float uploadTime; // ms, reading the mapped scene into the SSBOs
+};
+
+struct ShardTask {
+    uint32_t id;
+    uint32_t frameWidth; // pixels of the whole frame
+    uint32_t frameHeight;
+    uint32_t x0, y0, x1, y1; // tiles [x0, x1) x [y0, y1) of the frame, tile row 0 at the bottom
+    uint32_t blendMode;
+    float alphaCutoff;
+    uint32_t maxSplatsPerTile;
+    SplatView view; // of the whole frame
+};
+
+// followed by width x height RGB pixels, bottom row first
+struct ShardResult {
+    uint32_t id;
+    uint32_t width;
+    uint32_t height;
+    float renderTime; // ms spent by the worker
+};
+
+// one frame of a sharded job
+struct ShardFrame {
+    std::string name; // output file without extension
+    SplatView view;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct ShardOptions {
+    std::string workerAddress;  // --shard-worker: run as a worker of the coordinator at this address
+    unsigned int numWorkers = 0; // local worker processes, 0 disables sharding
+    unsigned int remoteWorkers = 0; // workers started elsewhere, waited for at address
+    std::string address;        // empty for a unix socket in the temp directory
+    std::string sceneFile;      // empty for a temporary file, removed at the end
+    bool wholeFrames = false;   // frames rather than bands of tile rows as tasks
+    uint32_t bandRows = 0;      // tile rows per band, 0 gives every worker two bands of each frame
+    bool scaling = false;       // renders the job with 1, 2, 4 .. all workers and reports the efficiency
+    uint32_t width = 7680;      // frames of a camera path
+    uint32_t height = 4320;
+    std::string outputDir;
+    bool flipY = true;          // has to match the views, see BatchOptions
+    BlendMode blendMode = BlendMode::Sorted;
+    bool egl = false;           // local workers render with an EGL surfaceless context, see EglContext
+};
+
+// renders the tasks of a coordinator until it sends Quit
+class ShardWorker {
+public:
+    ShardWorker(SplatRenderer& renderer) : renderer(renderer) {}
+
+    bool run(const std::string& address) {
+        ShardChannel channel = ShardChannel::connect(address, 30.0f);
+        if (!channel.valid()) return false;
+
+        uint32_t type;
+        std::vector<uint8_t> message;
+        if (!channel.receive(type, message, PATH_MAX) || type != static_cast<uint32_t>(ShardMessage::Scene)) {
+            std::cerr << "Expected the scene from the coordinator" << std::endl;
+            return false;
+        }
+        const std::string sceneFile(message.begin(), message.end());
+
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+        MappedScene scene(sceneFile);
+        if (!scene.valid()) return false;
+        ShardReady ready;
+        ready.numSplats = scene.numSplats();
+        ready.mapTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        SplatBuffers buffers(scene.numSplats());
+        buffers.uploadUntil(scene.covAndPos(), scene.colorAndOpacity(), nullptr, scene.numSplats());
+        glFinish();
+        ready.uploadTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        if (!channel.send(static_cast<uint32_t>(ShardMessage::Ready), &ready, sizeof(ready))) return false;
+
+        while (channel.receive(type, message, sizeof(ShardTask))) {
+            if (type == static_cast<uint32_t>(ShardMessage::Quit)) return true;
+            if (type != static_cast<uint32_t>(ShardMessage::Task) || message.size() != sizeof(ShardTask)) {
+                std::cerr << "Unexpected message " << type << " from the coordinator" << std::endl;
+                return false;
+            }
+
+            ShardTask task;
+            std::memcpy(&task, message.data(), sizeof(task));
+            start = Clock::now();
+            render(buffers, task);
+
+            ShardResult result;
+            result.id = task.id;
+            result.width = (task.x1 - task.x0) * TILE_SIZE;
+            result.height = (task.y1 - task.y0) * TILE_SIZE;
+            result.renderTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            if (!channel.send(static_cast<uint32_t>(ShardMessage::Result), &result, sizeof(result), pixels.data(), pixels.size())) return false;
+        }
+        std::cerr << "Lost the connection to the coordinator" << std::endl;
+        return false;
+    }
+
+private:
+    SplatRenderer& renderer;
+    std::vector<OutputData> outputData;
+    FrameArena arena;
+    std::vector<float> image;
+    std::vector<uint8_t> pixels;
+
+    // the tiles of the task in pieces that fit the tile grid, into pixels
+    void render(const SplatBuffers& buffers, const ShardTask& task) {
+        const uint32_t width = (task.x1 - task.x0) * TILE_SIZE;
+        const uint32_t height = (task.y1 - task.y0) * TILE_SIZE;
+        const BlendMode blendMode = static_cast<BlendMode>(task.blendMode);
+        // the background where nothing is visible, see BatchRenderer
+        pixels.assign(static_cast<size_t>(width) * height * 3, 128);
+
+        const glm::vec2 frameSize(static_cast<float>(task.frameWidth), static_cast<float>(task.frameHeight));
+        for (uint32_t ty = task.y0; ty < task.y1; ty += NUM_TILES_Y) {
+            for (uint32_t tx = task.x0; tx < task.x1; tx += NUM_TILES_X) {
+                TileGrid grid;
+                grid.x = std::min(NUM_TILES_X, task.x1 - tx);
+                grid.y = std::min(NUM_TILES_Y, task.y1 - ty);
+
+                const glm::vec2 ndcMin = glm::vec2(static_cast<float>(tx * TILE_SIZE), static_cast<float>(ty * TILE_SIZE)) / frameSize * 2.0f - 1.0f;
+                const glm::vec2 ndcMax = glm::vec2(static_cast<float>((tx + grid.x) * TILE_SIZE), static_cast<float>((ty + grid.y) * TILE_SIZE)) / frameSize * 2.0f - 1.0f;
+                const SplatView view = task.view.crop(ndcMin, ndcMax);
+
+                const uint32_t numVisible = renderer.project(buffers, buffers.residentCount, view, grid, task.alphaCutoff);
+                outputData.resize(numVisible);
+                renderer.readOutputData(buffers, numVisible, outputData.data());
+
+                arena.reset();
+                const TileBins bins = blendMode == BlendMode::WeightedBlended
+                    ? binTilesUnsorted(outputData.data(), numVisible, arena, grid)
+                    : binTilesCounting(outputData.data(), numVisible, arena, grid);
+                if (!renderer.rasterize(buffers, bins, grid, task.alphaCutoff, task.maxSplatsPerTile, blendMode)) continue;
+                renderer.readImage(grid, image);
+
+                const uint32_t pieceWidth = grid.x * TILE_SIZE;
+                for (uint32_t y = 0; y < grid.y * TILE_SIZE; y++) {
+                    const float* src = &image[static_cast<size_t>(y) * pieceWidth * 3];
+                    uint8_t* dst = &pixels[((static_cast<size_t>(ty - task.y0) * TILE_SIZE + y) * width + (tx - task.x0) * TILE_SIZE) * 3];
+                    for (uint32_t i = 0; i < pieceWidth * 3; i++) {
+                        dst[i] = static_cast<uint8_t>(std::lround(std::min(1.0f, std::max(0.0f, src[i])) * 255.0f));
+                    }
+                }
+            }
+        }
+    }
+};
+
+// starts the workers, hands out the tasks of all frames and reassembles the frames
+class ShardCoordinator {
+public:
+    // executable is started with --shard-worker for the local workers
+    ShardCoordinator(const ShardOptions& options, const std::string& executable) :
+        options(options),
+        executable(executable)
+    {}
+
+    ~ShardCoordinator() {
+        stopWorkers();
+        if (removeSceneFile) std::filesystem::remove(sceneFile);
+    }
+
+    bool run(const std::string& plyFile, const std::vector<ShardFrame>& frames) {
+        if (frames.empty()) {
+            std::cerr << "Nothing to render" << std::endl;
+            return false;
+        }
+        if (!prepareScene(plyFile) || !startWorkers()) return false;
+        if (!options.outputDir.empty()) std::filesystem::create_directories(options.outputDir);
+
+        const uint32_t numWorkers = static_cast<uint32_t>(workers.size());
+        std::vector<ShardTask> tasks = makeTasks(frames, numWorkers);
+
+        // 1, 2, 4 .. workers, and all of them
+        std::vector<uint32_t> counts;
+        if (options.scaling) {
+            for (uint32_t count = 1; count < numWorkers; count *= 2) counts.push_back(count);
+        }
+        counts.push_back(numWorkers);
+
+        std::vector<RunStats> runs;
+        for (uint32_t count : counts) {
+            // the sweep does not write the images, which would only measure the disk
+            const bool write = !options.outputDir.empty() && !options.scaling;
+            RunStats stats;
+            if (!render(frames, tasks, count, write, stats)) return false;
+            runs.push_back(stats);
+        }
+        if (options.scaling && !options.outputDir.empty()) {
+            RunStats stats;
+            if (!render(frames, tasks, numWorkers, true, stats)) return false;
+        }
+
+        // report
+        uint64_t pixels = 0;
+        for (const ShardFrame& frame : frames) pixels += static_cast<uint64_t>(frame.width) * frame.height;
+        std::cout << "Sharded " << frames.size() << " frames (" << pixels / 1e6 << " MP) into " << tasks.size() << " "
+            << (options.wholeFrames ? "frame" : "band") << " tasks" << std::endl;
+        for (const RunStats& run : runs) {
+            const double speedup = runs.front().seconds / run.seconds;
+            std::cout << std::fixed << std::setprecision(3)
+                << "  " << run.workers << (run.workers == 1 ? " worker: " : " workers: ") << run.seconds << " s, " << frames.size() / run.seconds << " frames/s, "
+                << pixels / run.seconds / 1e6 << " MP/s, speedup " << speedup << " over " << runs.front().workers
+                << ", efficiency " << speedup * runs.front().workers / run.workers * 100.0 << "%, workers busy "
+                << run.busyMs / 1000.0 / (run.seconds * run.workers) * 100.0 << "%, " << run.bytes / (1024.0 * 1024.0) << " MB received"
+                << std::defaultfloat << std::endl;
+        }
+        return true;
+    }
+
+private:
+    struct Worker {
+        ShardChannel channel;
+        ShardReady ready = {};
+        uint32_t inFlight = 0;
+    };
+
+    struct RunStats {
+        uint32_t workers = 0;
+        double seconds = 0.0;
+        double busyMs = 0.0; // render time reported by the workers
+        uint64_t bytes = 0;
+    };
+
+    // a frame whose tasks are not all back yet
+    struct PendingFrame {
+        std::vector<uint8_t> pixels; // top row first, as written
+        uint32_t remaining = 0;
+    };
+
+    // tasks a worker holds at once, so that it starts the next one while the result of the last is on its way
+    static const uint32_t TASKS_IN_FLIGHT = 2;
+
+    ShardOptions options;
+    std::string executable;
+    std::string sceneFile;
+    bool removeSceneFile = false;
+    std::string address;
+    ShardListener listener;
+    std::vector<Worker> workers;
+    std::vector<pid_t> localWorkers;
+    // frame of every task
+    std::vector<uint32_t> taskFrames;
+
+    bool prepareScene(const std::string& plyFile) {
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+        SplatModel model(plyFile, options.flipY);
+        if (!model.loaded) return false;
+        const float loadTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+        // tmpfs when there is one, the workers map it from memory
+        sceneFile = options.sceneFile;
+        if (sceneFile.empty()) {
+            const std::filesystem::path directory = std::filesystem::is_directory("/dev/shm") ? "/dev/shm" : std::filesystem::temp_directory_path();
+            sceneFile = (directory / ("splat_scene_" + std::to_string(getpid()) + ".bin")).string();
+            removeSceneFile = true;
+        }
+
+        start = Clock::now();
+        if (!writeSceneFile(model, sceneFile)) return false;
+        const float writeTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        std::cout << "Loaded " << plyFile << " (" << model.numPoints << " splats) in " << loadTime << " ms, wrote the scene file "
+            << sceneFile << " (" << std::filesystem::file_size(sceneFile) / (1024.0 * 1024.0) << " MB) in " << writeTime << " ms" << std::endl;
+        return true;
+    }
+
+    bool startWorkers() {
+        address = options.address;
+        if (address.empty()) {
+            address = "unix:" + (std::filesystem::temp_directory_path() / ("splat_shard_" + std::to_string(getpid()) + ".sock")).string();
+        }
+        if (!listener.open(address)) return false;
+
+        // the local workers share the cores of the host
+        const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        const std::string jobs = std::to_string(std::max(1u, cores / std::max(1u, options.numWorkers)) - 1);
+        for (unsigned int w = 0; w < options.numWorkers; w++) {
+            // the arguments are built before the fork, the child only execs
+            std::vector<std::string> args = {executable, "--shard-worker", address, "--jobs", jobs};
+            if (options.egl) args.push_back("--egl");
+            std::vector<char*> argv;
+            for (std::string& arg : args) argv.push_back(arg.data());
+            argv.push_back(nullptr);
+
+            const pid_t pid = fork();
+            if (pid == 0) {
+                execv(executable.c_str(), argv.data());
+                _exit(127);
+            }
+            if (pid < 0) {
+                std::cerr << "Could not start a worker: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            localWorkers.push_back(pid);
+        }
+        if (options.remoteWorkers > 0) {
+            std::cout << "Waiting for " << options.remoteWorkers << " workers to connect to " << address << std::endl;
+        }
+
+        // local and remote workers connect in any order
+        const unsigned int total = options.numWorkers + options.remoteWorkers;
+        const int timeoutMs = options.remoteWorkers > 0 ? 600000 : 60000;
+        while (workers.size() < total) {
+            ShardChannel channel = listener.accept(timeoutMs);
+            if (!channel.valid()) {
+                std::cerr << "Only " << workers.size() << " of " << total << " workers connected" << std::endl;
+                return false;
+            }
+            Worker worker;
+            worker.channel = std::move(channel);
+            workers.push_back(std::move(worker));
+        }
+
+        // every worker maps the scene and uploads it, in parallel
+        for (Worker& worker : workers) {
+            if (!worker.channel.send(static_cast<uint32_t>(ShardMessage::Scene), sceneFile.data(), sceneFile.size())) return false;
+        }
+        float mapTime = 0.0f;
+        float uploadTime = 0.0f;
+        float slowestUpload = 0.0f;
+        for (Worker& worker : workers) {
+            uint32_t type;
+            std::vector<uint8_t> message;
+            if (!worker.channel.receive(type, message, sizeof(ShardReady)) || type != static_cast<uint32_t>(ShardMessage::Ready) || message.size() != sizeof(ShardReady)) {
+                std::cerr << "A worker could not load " << sceneFile << std::endl;
+                return false;
+            }
+            std::memcpy(&worker.ready, message.data(), sizeof(ShardReady));
+            mapTime += worker.ready.mapTime;
+            uploadTime += worker.ready.uploadTime;
+            slowestUpload = std::max(slowestUpload, worker.ready.uploadTime);
+        }
+        std::cout << workers.size() << " workers mapped the scene in " << mapTime / workers.size() << " ms and uploaded it in "
+            << uploadTime / workers.size() << " ms on average (slowest " << slowestUpload << " ms)" << std::endl;
+        return true;
+    }
+
+    void stopWorkers() {
+        for (Worker& worker : workers) {
+            if (worker.channel.valid()) worker.channel.send(static_cast<uint32_t>(ShardMessage::Quit), nullptr, 0);
+        }
+        workers.clear();
+
+        // a local worker that does not quit within two seconds, e.g. one that never connected, is terminated
+        for (pid_t pid : localWorkers) {
+            int status;
+            bool exited = false;
+            for (int i = 0; i < 100 && !exited; i++) {
+                exited = waitpid(pid, &status, WNOHANG) == pid;
+                if (!exited) usleep(20000);
+            }
+            if (!exited) {
+                kill(pid, SIGTERM);
+                waitpid(pid, &status, 0);
+            }
+        }
+        localWorkers.clear();
+    }
+
+    std::vector<ShardTask> makeTasks(const std::vector<ShardFrame>& frames, uint32_t numWorkers) {
+        const QualityLevel& quality = QUALITY_LEVELS[0];
+        std::vector<ShardTask> tasks;
+        for (uint32_t f = 0; f < frames.size(); f++) {
+            const ShardFrame& frame = frames[f];
+            const uint32_t tilesX = (frame.width + TILE_SIZE - 1) / TILE_SIZE;
+            const uint32_t tilesY = (frame.height + TILE_SIZE - 1) / TILE_SIZE;
+
+            // every band projects all splats again, by default there are just enough to keep the workers busy:
+            // two per worker and frame, the same for every worker count of a scaling run
+            uint32_t bandRows = options.bandRows;
+            if (bandRows == 0) bandRows = (tilesY + 2 * numWorkers - 1) / (2 * numWorkers);
+            if (options.wholeFrames) bandRows = tilesY;
+            bandRows = std::max(1u, bandRows);
+
+            for (uint32_t y = 0; y < tilesY; y += bandRows) {
+                ShardTask task;
+                task.id = static_cast<uint32_t>(tasks.size());
+                task.frameWidth = frame.width;
+                task.frameHeight = frame.height;
+                task.x0 = 0;
+                task.x1 = tilesX;
+                task.y0 = y;
+                task.y1 = std::min(tilesY, y + bandRows);
+                task.blendMode = static_cast<uint32_t>(options.blendMode);
+                task.alphaCutoff = quality.alphaCutoff;
+                task.maxSplatsPerTile = quality.maxSplatsPerTile;
+                task.view = frame.view;
+                tasks.push_back(task);
+                taskFrames.push_back(f);
+            }
+        }
+        return tasks;
+    }
+
+    // renders all tasks with the first numWorkers workers
+    bool render(const std::vector<ShardFrame>& frames, const std::vector<ShardTask>& tasks, uint32_t numWorkers, bool write, RunStats& stats) {
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+
+        // the PNG writers read the frames, they have to finish before any return
+        std::vector<JobHandle> writers;
+        const bool success = renderTasks(frames, tasks, numWorkers, write, stats, writers);
+        JobSystem::global().wait(writers);
+        if (!success) return false;
+
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return true;
+    }
+
+    // sends the tasks and collects the results into frames, whose PNG writers are appended to writers
+    bool renderTasks(const std::vector<ShardFrame>& frames, const std::vector<ShardTask>& tasks, uint32_t numWorkers, bool write, RunStats& stats,
+                     std::vector<JobHandle>& writers) {
+        JobSystem& jobs = JobSystem::global();
+        std::vector<PendingFrame> pending(frames.size());
+        for (uint32_t frame : taskFrames) pending[frame].remaining++;
+
+        stats.workers = numWorkers;
+        size_t nextTask = 0;
+        size_t finished = 0;
+        auto sendTask = [&](Worker& worker) {
+            if (nextTask >= tasks.size()) return true;
+            const ShardTask& task = tasks[nextTask++];
+            worker.inFlight++;
+            return worker.channel.send(static_cast<uint32_t>(ShardMessage::Task), &task, sizeof(task));
+        };
+
+        for (uint32_t w = 0; w < numWorkers; w++) {
+            workers[w].inFlight = 0;
+            for (uint32_t i = 0; i < TASKS_IN_FLIGHT; i++) {
+                if (!sendTask(workers[w])) return lostWorker(w);
+            }
+        }
+
+        // no result is larger than the pixels of the largest task
+        size_t maxResultSize = 0;
+        for (const ShardTask& task : tasks) {
+            maxResultSize = std::max(maxResultSize, static_cast<size_t>(task.x1 - task.x0) * (task.y1 - task.y0) * TILE_SIZE * TILE_SIZE * 3);
+        }
+        maxResultSize += sizeof(ShardResult);
+
+        std::vector<pollfd> requests(numWorkers);
+        std::vector<uint8_t> message;
+        while (finished < tasks.size()) {
+            for (uint32_t w = 0; w < numWorkers; w++) requests[w] = {workers[w].channel.descriptor(), POLLIN, 0};
+            if (poll(requests.data(), numWorkers, -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+
+            for (uint32_t w = 0; w < numWorkers; w++) {
+                if (requests[w].revents == 0) continue;
+                Worker& worker = workers[w];
+
+                uint32_t type;
+                if (!worker.channel.receive(type, message, maxResultSize) || type != static_cast<uint32_t>(ShardMessage::Result) || message.size() < sizeof(ShardResult)) {
+                    return lostWorker(w);
+                }
+                ShardResult result;
+                std::memcpy(&result, message.data(), sizeof(result));
+                if (result.id >= tasks.size() || result.width != (tasks[result.id].x1 - tasks[result.id].x0) * TILE_SIZE ||
+                    result.height != (tasks[result.id].y1 - tasks[result.id].y0) * TILE_SIZE ||
+                    message.size() != sizeof(ShardResult) + static_cast<size_t>(result.width) * result.height * 3) {
+                    std::cerr << "Malformed result from worker " << w << std::endl;
+                    return false;
+                }
+                stats.busyMs += result.renderTime;
+                stats.bytes += message.size();
+                worker.inFlight--;
+                finished++;
+
+                // into the frame, the pixels beyond its edge are dropped
+                const ShardTask& task = tasks[result.id];
+                const uint32_t f = taskFrames[result.id];
+                const ShardFrame& frame = frames[f];
+                PendingFrame& target = pending[f];
+                if (target.pixels.empty()) target.pixels.resize(static_cast<size_t>(frame.width) * frame.height * 3);
+                const uint8_t* pixels = message.data() + sizeof(ShardResult);
+                const uint32_t left = task.x0 * TILE_SIZE;
+                const uint32_t columns = std::min(frame.width, task.x1 * TILE_SIZE) - left;
+                for (uint32_t y = 0; y < result.height; y++) {
+                    const uint32_t frameY = task.y0 * TILE_SIZE + y;
+                    if (frameY >= frame.height) break;
+                    std::memcpy(&target.pixels[(static_cast<size_t>(frame.height - 1 - frameY) * frame.width + left) * 3],
+                        &pixels[static_cast<size_t>(y) * result.width * 3], static_cast<size_t>(columns) * 3);
+                }
+
+                if (--target.remaining == 0) {
+                    if (write) {
+                        writers.push_back(jobs.submitBackground([this, &frame, image = std::move(target.pixels)]() {
+                            const std::string file = (std::filesystem::path(options.outputDir) / (frame.name + ".png")).string();
+                            if (!stbi_write_png(file.c_str(), frame.width, frame.height, 3, image.data(), frame.width * 3)) {
+                                std::cerr << "Could not write " << file << std::endl;
+                            }
+                        }));
+                    }
+                    target.pixels = std::vector<uint8_t>();
+                }
+
+                if (!sendTask(worker)) return lostWorker(w);
+            }
+        }
+        return true;
+    }
+
+    bool lostWorker(uint32_t w) {
+        std::cerr << "Lost worker " << w << std::endl;
+        return false;
+    }
+};
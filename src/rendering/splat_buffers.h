@@ -0,0 +1,178 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "model_loading/splat_model.h"
+#include "model_loading/splat_edits.h"
+
+// Data chunck for outputting data, matches the OutputBuffer of splat_covariances.cs
+struct OutputData {
+    glm::mat2 covariance;
+    glm::vec4 position;
+    glm::vec4 clipPos;
+    glm::ivec2 topCorner;
+    glm::ivec2 botCorner;
+    glm::vec2 majorEigenVec;
+    glm::vec2 minorEigenVec;
+};
+
+// Per splat data for the rasterizer, matches ProjectedSplat in splat_covariances.cs,
+// gather_tiles.cs and process_pixels.cs
+struct ProjectedSplat {
+    glm::vec4 position;
+    glm::vec4 conic;
+    glm::vec4 colorAndOpacity;
+};
+
+// GPU resources of one model.
+// The buffers are allocated for the whole model up front and filled range by range, so that a
+// model can already be rendered while it is being uploaded: only the first residentCount splats are used.
+// Edited splats are uploaded again with updateRanges(), only the ranges that changed.
+class SplatBuffers {
+public:
+    unsigned int inputCovSSBO;
+    unsigned int outputCovSSBO;
+    unsigned int colorAndOpacitySSBO;
+    unsigned int projectedSSBO;
+    unsigned int pcVBO;
+    unsigned int pcVAO;
+
+    uint32_t numPoints;
+    uint32_t residentCount = 0;
+    // splats the buffers were allocated for, numPoints shrinks when a compacted model is uploaded again and
+    // grows up to it when a model gains splats, see resize()
+    const uint32_t capacity;
+
+    // spareCapacity is room for splats added later, e.g. by the snapshots of a training run
+    SplatBuffers(uint32_t numPoints, uint32_t spareCapacity = 0) : numPoints(numPoints), capacity(numPoints + spareCapacity) {
+        glGenBuffers(1, &inputCovSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, inputCovSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STATIC_DRAW);
+
+        glGenBuffers(1, &outputCovSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, outputCovSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(OutputData), nullptr, GL_DYNAMIC_DRAW);
+
+        glGenBuffers(1, &colorAndOpacitySSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, colorAndOpacitySSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+
+        glGenBuffers(1, &projectedSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, projectedSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(ProjectedSplat), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // pointcloud
+        glGenVertexArrays(1, &pcVAO);
+        glGenBuffers(1, &pcVBO);
+
+        glBindVertexArray(pcVAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, pcVBO);
+        glBufferData(GL_ARRAY_BUFFER, capacity * 3 * sizeof(float), nullptr, GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~SplatBuffers() {
+        glDeleteBuffers(1, &inputCovSSBO);
+        glDeleteBuffers(1, &outputCovSSBO);
+        glDeleteBuffers(1, &colorAndOpacitySSBO);
+        glDeleteBuffers(1, &projectedSSBO);
+        glDeleteBuffers(1, &pcVBO);
+        glDeleteVertexArrays(1, &pcVAO);
+    }
+
+    SplatBuffers(const SplatBuffers&) = delete;
+    SplatBuffers& operator=(const SplatBuffers&) = delete;
+
+    bool complete() const { return residentCount == numPoints; }
+
+    // uploads the splats [residentCount, end) of the model and makes them visible to the renderer
+    void uploadUntil(const SplatModel& model, uint32_t end) {
+        uploadUntil(model.covAndPos.data(), model.colorAndOpacity.data(), model.position.data(), end);
+    }
+
+    // the same from arrays of numPoints splats, e.g. a MappedScene. Without positions the point cloud stays empty
+    void uploadUntil(const glm::mat4* covAndPos, const glm::vec4* colorAndOpacity, const float* position, uint32_t end) {
+        end = std::min(end, numPoints);
+        if (end <= residentCount) return;
+
+        const uint32_t begin = residentCount;
+        const uint32_t count = end - begin;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, inputCovSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, begin * sizeof(glm::mat4), count * sizeof(glm::mat4), covAndPos + begin);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, colorAndOpacitySSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, begin * sizeof(glm::vec4), count * sizeof(glm::vec4), colorAndOpacity + begin);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (position) {
+            glBindBuffer(GL_ARRAY_BUFFER, pcVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, begin * 3 * sizeof(float), count * 3 * sizeof(float), position + 3 * begin);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        residentCount = end;
+    }
+
+    // uploads the given ranges of resident splats again after they were edited, see SplatEditor. Returns the
+    // bytes uploaded
+    size_t updateRanges(const SplatModel& model, const std::vector<SplatRange>& ranges) {
+        size_t bytes = 0;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, inputCovSSBO);
+        for (const SplatRange& range : ranges) {
+            const uint32_t end = std::min(range.end, residentCount);
+            if (end <= range.begin) continue;
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, range.begin * sizeof(glm::mat4), (end - range.begin) * sizeof(glm::mat4), model.covAndPos.data() + range.begin);
+            bytes += (end - range.begin) * sizeof(glm::mat4);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, colorAndOpacitySSBO);
+        for (const SplatRange& range : ranges) {
+            const uint32_t end = std::min(range.end, residentCount);
+            if (end <= range.begin) continue;
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, range.begin * sizeof(glm::vec4), (end - range.begin) * sizeof(glm::vec4), model.colorAndOpacity.data() + range.begin);
+            bytes += (end - range.begin) * sizeof(glm::vec4);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, pcVBO);
+        for (const SplatRange& range : ranges) {
+            const uint32_t end = std::min(range.end, residentCount);
+            if (end <= range.begin) continue;
+            glBufferSubData(GL_ARRAY_BUFFER, range.begin * 3 * sizeof(float), (end - range.begin) * 3 * sizeof(float), model.position.data() + 3 * range.begin);
+            bytes += (end - range.begin) * 3 * sizeof(float);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return bytes;
+    }
+
+    // follows a resident model whose splat count changed in place, e.g. by applySnapshotDelta(): splats behind the
+    // old count are uploaded, splats behind the new one dropped. Returns the bytes uploaded; a model beyond the
+    // capacity needs new buffers
+    size_t resize(const SplatModel& model) {
+        const uint32_t previous = residentCount;
+        numPoints = std::min(model.numPoints, capacity);
+        residentCount = std::min(residentCount, numPoints);
+        uploadUntil(model, numPoints);
+        return residentCount > previous ? (residentCount - previous) * (sizeof(glm::mat4) + sizeof(glm::vec4) + 3 * sizeof(float)) : 0;
+    }
+
+    // uploads a model with at most capacity splats from the start, after SplatEditor::compact()
+    void reupload(const SplatModel& model) {
+        numPoints = std::min(model.numPoints, capacity);
+        residentCount = 0;
+        uploadUntil(model, numPoints);
+    }
+};
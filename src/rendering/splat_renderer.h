@@ -0,0 +1,458 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+
+#include "graphics/shader.h"
+#include "graphics/camera.h"
+#include "rendering/splat_buffers.h"
+#include "rendering/tile_binning.h"
+#include "rendering/tile_stats.h"
+
+// size of the image written by process_pixels.cs, NUM_TILES_X x NUM_TILES_Y tiles of 16 x 16 pixels.
+// The tile size is fixed: the texture, the tile counts, the binning and the CPU rasterizers all assume 16. It is
+// injected into the shaders only so that their sources have one definition of it, it is not a variant
+const unsigned int TEXTURE_WIDTH = 800;
+const unsigned int TEXTURE_HEIGHT = 800;
+const unsigned int TILE_SIZE = 16;
+
+// compiled shader variants are stored here, relative to the working directory like resources/
+const char* const SHADER_CACHE_DIR = ".shader_cache";
+
+// Camera parameters of one rendered view, as used by splat_covariances.cs
+struct SplatView {
+    glm::mat4 view;
+    glm::mat4 projection;
+    float near;
+    float screenRight; // half extents of the image plane at the near plane
+    float screenTop;
+
+    // the interactive camera
+    static SplatView fromCamera(Camera& camera, float aspectRatio) {
+        SplatView splatView;
+        splatView.view = camera.GetViewMatrix();
+        splatView.projection = glm::perspective(glm::radians(camera.Fov), aspectRatio, camera.Near, camera.Far);
+        splatView.near = camera.Near;
+        splatView.screenRight = glm::tan(camera.Fov / 2) * camera.Near;
+        splatView.screenTop = splatView.screenRight * (1 / aspectRatio);
+        return splatView;
+    }
+
+    // the region [ndcMin, ndcMax] of this view stretched over the whole screen, e.g. one band of an image larger
+    // than the tile grid. The splats keep their footprints in the region, its pixels match the full image
+    SplatView crop(const glm::vec2& ndcMin, const glm::vec2& ndcMax) const {
+        const glm::vec2 scale = 2.0f / (ndcMax - ndcMin);
+        const glm::vec2 center = 0.5f * (ndcMin + ndcMax);
+
+        // applied in clip space, the offset scales with w
+        glm::mat4 toRegion(1.0f);
+        toRegion[0][0] = scale.x;
+        toRegion[1][1] = scale.y;
+        toRegion[3][0] = -scale.x * center.x;
+        toRegion[3][1] = -scale.y * center.y;
+
+        SplatView region = *this;
+        region.projection = toRegion * projection;
+        region.screenRight = screenRight / scale.x;
+        region.screenTop = screenTop / scale.y;
+        return region;
+    }
+};
+
+// The compute passes that turn the splats of a SplatBuffers into an image:
+// project() runs splat_covariances.cs, which compacts the visible splats to the front of the output buffers, and
+// readOutputData() reads their screen space footprints back for binning on the CPU,
+// rasterize() uploads the bins, gathers the splats of every tile (gather_tiles.cs) and blends them
+// (process_pixels.cs, or process_pixels_weighted.cs followed by resolve_weighted.cs).
+// The shaders are compiled for this device: the tile size, the number of splats per shared memory batch and the
+// projection work group size are injected as #defines, see selectVariants().
+class SplatRenderer {
+public:
+    unsigned int texture;          // RGBA32F, TEXTURE_WIDTH x TEXTURE_HEIGHT
+    unsigned int accumTexture;     // intermediate results of BlendMode::WeightedBlended
+    unsigned int revealageTexture;
+    float gatherTime = 0.0f;       // GPU time of the previous rasterize(), ms, see readTimings()
+    float rasterTime = 0.0f;
+    uint32_t batchSize = 0;        // splats per shared memory batch of the rasterization shaders
+    uint32_t projectGroupSize = 0; // splats per work group of splat_covariances.cs
+
+    SplatRenderer() : shaders(SHADER_CACHE_DIR)
+    {
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxWorkGroupsX);
+        selectVariants();
+
+        glGenBuffers(1, &rangeSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (NUM_TILES + 1) * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+
+        // sorted splat indices of the tiles and the large splats behind them, grows with the number of tile entries
+        glGenBuffers(1, &indexSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+
+        // projected splats of every tile in sorted order, grows with the number of tile entries
+        glGenBuffers(1, &tileSplatSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileSplatSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileSplatCapacity * sizeof(ProjectedSplat), nullptr, GL_DYNAMIC_DRAW);
+
+        // per tile saturation depths of BlendMode::Sorted for the occlusion culling
+        glGenBuffers(1, &tileSaturationSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileSaturationSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_TILES * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+
+        // per tile counters of the TILE_STATS variant of process_pixels.cs
+        glGenBuffers(1, &tileStatsSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileStatsSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_TILES * sizeof(TileStats), nullptr, GL_DYNAMIC_READ);
+
+        // tile rects of the large splats, see TileBins::largeSplats
+        glGenBuffers(1, &largeSplatSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, largeSplatSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_LARGE_SPLATS * sizeof(glm::ivec4), nullptr, GL_DYNAMIC_DRAW);
+
+        glGenBuffers(1, &visibleCountSSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // GPU timings of the gather and rasterization passes, two sets so that one frame's results are read while
+        // the next frame is timed
+        glGenQueries(4, &queries[0][0]);
+
+        // texture to write the final image
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+        glGenTextures(1, &accumTexture);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+        glGenTextures(1, &revealageTexture);
+        glBindTexture(GL_TEXTURE_2D, revealageTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RED, GL_FLOAT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    ~SplatRenderer() {
+        glDeleteBuffers(1, &rangeSSBO);
+        glDeleteBuffers(1, &indexSSBO);
+        glDeleteBuffers(1, &tileSplatSSBO);
+        glDeleteBuffers(1, &visibleCountSSBO);
+        glDeleteBuffers(1, &tileSaturationSSBO);
+        glDeleteBuffers(1, &largeSplatSSBO);
+        glDeleteBuffers(1, &tileStatsSSBO);
+        glDeleteQueries(4, &queries[0][0]);
+        glDeleteTextures(1, &texture);
+        glDeleteTextures(1, &accumTexture);
+        glDeleteTextures(1, &revealageTexture);
+    }
+
+    SplatRenderer(const SplatRenderer&) = delete;
+    SplatRenderer& operator=(const SplatRenderer&) = delete;
+
+    // process_pixels.cs writes the share of the tile's splats blended into every pixel instead of the color
+    void setDebugOutput(bool enabled) {
+        if (enabled == debugOutput) return;
+        debugOutput = enabled;
+        selectVariants();
+    }
+
+    // process_pixels.cs also counts the workload of every tile, see readTileStats()
+    void setTileStats(bool enabled) {
+        if (enabled == tileStats) return;
+        tileStats = enabled;
+        selectVariants();
+    }
+    bool tileStatsEnabled() const { return tileStats; }
+
+    // projects the first numSplats splats and returns how many of them are visible. Only the visible splats are
+    // written, compacted to the front of outputCovSSBO and projectedSSBO; read them with readOutputData()
+    uint32_t project(const SplatBuffers& buffers, uint32_t numSplats, const SplatView& splatView, const TileGrid& grid, float alphaCutoff) {
+        if (numSplats == 0) return 0;
+
+        const uint32_t zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t), &zero);
+
+        // activate the shader and bind the SSBOs to binding points
+        Shader& covShader = *projectShader;
+        covShader.use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers.inputCovSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers.outputCovSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, buffers.colorAndOpacitySSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, buffers.projectedSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, visibleCountSSBO);
+
+        // set frame specific uniforms
+        covShader.setMat4("view", splatView.view);
+        covShader.setFloat("near", splatView.near);
+        covShader.setMat4("mvp", splatView.projection * splatView.view);
+
+        covShader.setFloat("screenRightCoord", splatView.screenRight);
+        covShader.setFloat("screenTopCoord", splatView.screenTop);
+        covShader.setIVec2("tileGrid", grid.x, grid.y);
+        covShader.setFloat("alphaCutoff", alphaCutoff);
+        covShader.setUInt("numSplats", numSplats);
+
+        // start computations
+        glDispatchCompute((numSplats + projectGroupSize - 1) / projectGroupSize, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // read the visible count from GPU
+        uint32_t numVisible = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t), &numVisible);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return numVisible;
+    }
+
+    // reads the footprints of the numVisible splats of the last project()
+    void readOutputData(const SplatBuffers& buffers, uint32_t numVisible, OutputData* outputData) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.outputCovSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numVisible * sizeof(OutputData), outputData);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // reads the rasterizer data of the numVisible splats of the last project()
+    void readProjected(const SplatBuffers& buffers, uint32_t numVisible, ProjectedSplat* projected) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.projectedSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numVisible * sizeof(ProjectedSplat), projected);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // draws the binned splats of the last project() into texture, returns false if no splat is visible.
+    // BlendMode::Sorted needs bins in depth order, BlendMode::WeightedBlended takes them in any order and blends every splat, maxSplatsPerTile only limits sorted bins.
+    bool rasterize(const SplatBuffers& buffers, const TileBins& bins, const TileGrid& grid, float alphaCutoff, uint32_t maxSplatsPerTile,
+                   BlendMode blendMode = BlendMode::Sorted) {
+        const FrameVector<uint32_t>& ranges = bins.ranges;
+        const FrameVector<uint32_t>& sortedIndices = bins.sortedIndices;
+        const uint32_t numLarge = static_cast<uint32_t>(std::min<size_t>(bins.largeSplats.size(), MAX_LARGE_SPLATS));
+        if (sortedIndices.size() == 0 && numLarge == 0) return false;
+
+        // load ranges and sorted indices to GPU, the gaussians themselves are already in the GPU;
+        // the large splats follow the indices of the tiles and are gathered behind them
+        const size_t numEntries = sortedIndices.size() + numLarge;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, ranges.size() * sizeof(uint32_t), ranges.data());
+        if (numEntries > indexCapacity) {
+            indexCapacity = numEntries + numEntries / 2;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sortedIndices.size() * sizeof(uint32_t), sortedIndices.data());
+        if (numLarge > 0) {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, sortedIndices.size() * sizeof(uint32_t), numLarge * sizeof(uint32_t), bins.largeSplats.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, largeSplatSSBO);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numLarge * sizeof(glm::ivec4), bins.largeRects.data());
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (numEntries > tileSplatCapacity) {
+            tileSplatCapacity = numEntries + numEntries / 2;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileSplatSSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, tileSplatCapacity * sizeof(ProjectedSplat), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // write the projected splats of every tile contiguously in sorted order
+        glBeginQuery(GL_TIME_ELAPSED, queries[querySet][0]);
+        Shader& gatherTilesShader = *gatherShader;
+        gatherTilesShader.use();
+        gatherTilesShader.setUInt("numEntries", static_cast<uint32_t>(numEntries));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, indexSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, buffers.projectedSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, tileSplatSSBO);
+        glDispatchCompute(std::min<uint32_t>((numEntries + 255) / 256, maxWorkGroupsX), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        glBeginQuery(GL_TIME_ELAPSED, queries[querySet][1]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rangeSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, tileSplatSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, largeSplatSSBO);
+        // bind texture to image unit (binding point) 0
+        glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        if (blendMode == BlendMode::Sorted) {
+            Shader& processPixelsShader = *sortedShader;
+            processPixelsShader.use();
+            processPixelsShader.setFloat("alphaCutoff", alphaCutoff);
+            processPixelsShader.setUInt("maxSplatsPerTile", maxSplatsPerTile);
+            processPixelsShader.setUInt("largeSplatsBegin", static_cast<uint32_t>(sortedIndices.size()));
+            processPixelsShader.setUInt("numLargeSplats", numLarge);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, tileSaturationSSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, tileStatsSSBO);
+
+            // start computations, one work group per rendered tile
+            glDispatchCompute(grid.x, grid.y, 1);
+            // the image is sampled by the quad pass
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        } else {
+            // accumulate, then resolve
+            glBindImageTexture(1, accumTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+            glBindImageTexture(2, revealageTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+
+            Shader& processPixelsWeightedShader = *weightedShader;
+            processPixelsWeightedShader.use();
+            processPixelsWeightedShader.setFloat("alphaCutoff", alphaCutoff);
+            processPixelsWeightedShader.setUInt("largeSplatsBegin", static_cast<uint32_t>(sortedIndices.size()));
+            processPixelsWeightedShader.setUInt("numLargeSplats", numLarge);
+            glDispatchCompute(grid.x, grid.y, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+            resolveShader->use();
+            glDispatchCompute(grid.x, grid.y, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[querySet] = true;
+
+        // the results of this call are read by the next one, without stalling on the GPU
+        querySet ^= 1;
+        readTimings(querySet, false);
+        return true;
+    }
+
+    // blocks until the GPU timings of the last rasterize() are in gatherTime and rasterTime, for benchmarks that
+    // need the time of every call
+    void waitForTimings() {
+        readTimings(querySet ^ 1, true);
+    }
+
+    // reads the depth at which each tile of the last BlendMode::Sorted rasterize() saturated, as written by
+    // process_pixels.cs: the ndc depth as float bits, or 0xFFFFFFFF where some pixel of the tile never saturated
+    void readTileSaturation(const TileGrid& grid, std::vector<uint32_t>& saturation) {
+        saturation.resize(grid.count());
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileSaturationSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, grid.count() * sizeof(uint32_t), saturation.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // reads the counters of every tile of the last BlendMode::Sorted rasterize(), which needs setTileStats(true)
+    void readTileStats(const TileGrid& grid, std::vector<TileStats>& stats) {
+        stats.resize(grid.count());
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileStatsSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, grid.count() * sizeof(TileStats), stats.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // copies the rendered part of texture to rgb (grid.x * 16 by grid.y * 16 pixels, 3 floats each, bottom row first)
+    void readImage(const TileGrid& grid, std::vector<float>& rgb) {
+        const uint32_t width = grid.x * TILE_SIZE;
+        const uint32_t height = grid.y * TILE_SIZE;
+
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        texturePixels.resize(TEXTURE_WIDTH * TEXTURE_HEIGHT * 4);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, texturePixels.data());
+
+        rgb.resize(static_cast<size_t>(width) * height * 3);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const float* src = &texturePixels[(static_cast<size_t>(y) * TEXTURE_WIDTH + x) * 4];
+                float* dst = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+    }
+
+private:
+    // takes the results of a query set once the GPU has them, or right away when wait is set; a set that is not
+    // done yet stays pending and gatherTime and rasterTime keep the older values
+    void readTimings(int set, bool wait) {
+        if (!queryPending[set]) return;
+        if (!wait) {
+            // the raster query ends last
+            GLint available = 0;
+            glGetQueryObjectiv(queries[set][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        GLuint64 elapsed[2];
+        glGetQueryObjectui64v(queries[set][0], GL_QUERY_RESULT, &elapsed[0]);
+        glGetQueryObjectui64v(queries[set][1], GL_QUERY_RESULT, &elapsed[1]);
+        gatherTime = elapsed[0] / 1e6f;
+        rasterTime = elapsed[1] / 1e6f;
+        queryPending[set] = false;
+    }
+
+    // picks the shader variants for the limits of the device, compiling the ones not built before
+    // the specialized parameters are the shared memory batch size, the projection work group size and the debug
+    // and tile stats outputs; TILE_SIZE is always 16
+    void selectVariants() {
+        // both rasterization shaders keep 48 bytes per splat in shared memory (three vec4 slots at std430 layout
+        // or less), process_pixels.cs 52 more per large splat, the rest of the shared variables fit in 256 bytes.
+        // GL 4.3 guarantees 32 KB.
+        GLint sharedMemory = 32768;
+        GLint maxInvocations = 1024;
+        glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &sharedMemory);
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+
+        const uint32_t tileInvocations = TILE_SIZE * TILE_SIZE;
+        const uint32_t largeBytes = MAX_LARGE_SPLATS * 52;
+        const uint32_t fitting = (static_cast<uint32_t>(std::max<GLint>(sharedMemory, 512 + largeBytes)) - 256 - largeBytes) / 48;
+        // whole multiples of the tile so every thread loads the same number of splats
+        batchSize = std::clamp(fitting / tileInvocations * tileInvocations, tileInvocations, 4 * tileInvocations);
+        projectGroupSize = std::min<uint32_t>(128, static_cast<uint32_t>(maxInvocations));
+
+        const std::string tileSize = std::to_string(TILE_SIZE);
+        const std::string background = "vec3(0.5)";
+        ShaderDefines rasterDefines = {{"TILE_SIZE", tileSize}, {"BATCH_SIZE", std::to_string(batchSize)},
+                                       {"MAX_LARGE_SPLATS", std::to_string(MAX_LARGE_SPLATS)}};
+        ShaderDefines sortedDefines = rasterDefines;
+        sortedDefines.push_back({"BACKGROUND_COLOR", background});
+        if (debugOutput) sortedDefines.push_back({"DEBUG_OUTPUT", "1"});
+        if (tileStats) sortedDefines.push_back({"TILE_STATS", "1"});
+
+        projectShader = &shaders.get("resources/shaders/splat_covariances.cs", {{"GROUP_SIZE", std::to_string(projectGroupSize)}});
+        gatherShader = &shaders.get("resources/shaders/gather_tiles.cs", {});
+        sortedShader = &shaders.get("resources/shaders/process_pixels.cs", sortedDefines);
+        weightedShader = &shaders.get("resources/shaders/process_pixels_weighted.cs", rasterDefines);
+        resolveShader = &shaders.get("resources/shaders/resolve_weighted.cs", {{"TILE_SIZE", tileSize}, {"BACKGROUND_COLOR", background}});
+
+        std::cout << "Shader variants: tile " << TILE_SIZE << ", batch " << batchSize << " splats (" << sharedMemory
+            << " bytes of shared memory), projection group " << projectGroupSize << (debugOutput ? ", debug output" : "") << (tileStats ? ", tile stats" : "") << std::endl;
+    }
+
+    ShaderVariantCache shaders;
+    Shader* projectShader = nullptr;
+    Shader* gatherShader = nullptr;
+    Shader* sortedShader = nullptr;
+    Shader* weightedShader = nullptr;
+    Shader* resolveShader = nullptr;
+    bool debugOutput = false;
+    bool tileStats = false;
+
+    unsigned int rangeSSBO;
+    unsigned int indexSSBO;
+    unsigned int tileSplatSSBO;
+    unsigned int visibleCountSSBO;
+    unsigned int tileSaturationSSBO;
+    unsigned int largeSplatSSBO;
+    unsigned int tileStatsSSBO;
+    size_t indexCapacity = 1 << 16;
+    size_t tileSplatCapacity = 1 << 16;
+    unsigned int queries[2][2];
+    bool queryPending[2] = {false, false};
+    int querySet = 0;
+    int maxWorkGroupsX = 65535;
+
+    std::vector<float> texturePixels;
+};
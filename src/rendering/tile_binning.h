@@ -0,0 +1,399 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <cstdint>
+
+#include "core/frame_arena.h"
+#include "core/job_system.h"
+#include "rendering/splat_buffers.h"
+
+// hardcoded blocks, 800 x 800 pixels in 16 x 16 tiles
+const uint32_t NUM_TILES_X = 50;
+const uint32_t NUM_TILES_Y = 50;
+const uint32_t NUM_TILES = NUM_TILES_X * NUM_TILES_Y;
+
+// tiles actually rendered, fewer than NUM_TILES_X x NUM_TILES_Y when rendering at a reduced resolution
+struct TileGrid {
+    uint32_t x = NUM_TILES_X;
+    uint32_t y = NUM_TILES_Y;
+
+    uint32_t count() const { return x * y; }
+};
+
+enum class BinningMode {
+    SortKeys,     // one (tile, depth) key per overlapped tile, sorted
+    CountingSort, // depth sort of the visible splats, then counting sort into the tiles
+    Unsorted      // counting sort into the tiles without any depth order, for BlendMode::WeightedBlended
+};
+
+// How the splats of a pixel are composited
+enum class BlendMode {
+    Sorted,         // front to back in depth order with early termination (process_pixels.cs), needs sorted bins
+    WeightedBlended // order independent approximation (process_pixels_weighted.cs + resolve_weighted.cs), any order
+};
+
+// Splats whose footprint covers more than this many tiles are not duplicated into the tiles, see TileBins::largeSplats.
+// Close to the camera a few splats can cover most of the screen and would otherwise add thousands of keys each.
+const uint32_t LARGE_SPLAT_TILES = 128;
+// at most this many per frame, the ones covering the most tiles; the rasterization shaders keep them in shared memory
+const uint32_t MAX_LARGE_SPLATS = 64;
+
+// Splat indices per tile in front to back order, as consumed by gather_tiles.cs / process_pixels.cs.
+// ranges[t] and ranges[t + 1] bound the indices of tile t in sortedIndices.
+struct TileBins {
+    FrameVector<uint32_t> ranges;
+    FrameVector<uint32_t> sortedIndices;
+    size_t occludedEntries = 0; // tile entries dropped behind TileOccluders
+
+    // The splats covering more than the large splat threshold, in depth order, and their tile rects
+    // (botCorner.x, botCorner.y, topCorner.x, topCorner.y). They are in no tile of sortedIndices; the rasterizers
+    // merge them by depth into the splats of every tile inside their rect.
+    FrameVector<uint32_t> largeSplats;
+    FrameVector<glm::ivec4> largeRects;
+    size_t largeEntries = 0; // tile entries the large splats would have added
+
+    TileBins(FrameArena& arena, const TileGrid& grid = TileGrid()) :
+        ranges(ArenaAllocator<uint32_t>(arena)),
+        sortedIndices(ArenaAllocator<uint32_t>(arena)),
+        largeSplats(ArenaAllocator<uint32_t>(arena)),
+        largeRects(ArenaAllocator<glm::ivec4>(arena))
+    {
+        ranges.resize(grid.count() + 1, 0);
+    }
+};
+
+// map to maximum uint range knowing that depth is [0,1]
+inline uint16_t depthKey(const OutputData& data) {
+    return static_cast<uint16_t>(data.position.z * 0xFFFF);
+}
+
+inline bool isVisible(const OutputData& data) {
+    return data.topCorner.x != -1;
+}
+
+inline uint32_t tileCount(const OutputData& data) {
+    return static_cast<uint32_t>(data.topCorner.x - data.botCorner.x + 1) * (data.topCorner.y - data.botCorner.y + 1);
+}
+
+const uint32_t NO_OCCLUDER = 0xFFFFFFFF;
+// written by process_pixels.cs for tiles where some pixel never saturated
+const uint32_t NO_SATURATION = 0xFFFFFFFF;
+
+// Depth key per tile behind which nothing of the tile can be seen, reprojected from the previous frame by
+// OcclusionCuller (occlusion_culling.h). The binning drops the tile entries of splats behind it.
+struct TileOccluders {
+    std::vector<uint32_t> depthKeys; // one per tile of the grid, NO_OCCLUDER where nothing is known
+
+    bool occludes(uint32_t tile, uint32_t key) const { return key > depthKeys[tile]; }
+
+    // behind the occluders of every tile it touches
+    bool occludesAll(const OutputData& data, const TileGrid& grid) const {
+        const uint32_t key = depthKey(data);
+        for (int j = data.botCorner.y; j <= data.topCorner.y; j++) {
+            for (int i = data.botCorner.x; i <= data.topCorner.x; i++) {
+                if (!occludes(static_cast<uint32_t>(j * grid.x + i), key)) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Moves the large splat candidates (in index order) to bins.largeSplats, the MAX_LARGE_SPLATS that cover the most
+// tiles if there are more, and returns the ones left for the tiles in index order.
+inline std::vector<uint32_t> selectLargeSplats(const OutputData* outputData, std::vector<uint32_t>& candidates, TileBins& bins) {
+    std::vector<uint32_t> overflow;
+    if (candidates.size() > MAX_LARGE_SPLATS) {
+        std::sort(candidates.begin(), candidates.end(), [outputData](uint32_t a, uint32_t b) {
+            const uint32_t tilesA = tileCount(outputData[a]);
+            const uint32_t tilesB = tileCount(outputData[b]);
+            return tilesA != tilesB ? tilesA > tilesB : a < b;
+        });
+        overflow.assign(candidates.begin() + MAX_LARGE_SPLATS, candidates.end());
+        std::sort(overflow.begin(), overflow.end());
+        candidates.resize(MAX_LARGE_SPLATS);
+    }
+
+    // the depth order of binTilesSortKeys
+    std::sort(candidates.begin(), candidates.end(), [outputData](uint32_t a, uint32_t b) {
+        const uint16_t depthA = depthKey(outputData[a]);
+        const uint16_t depthB = depthKey(outputData[b]);
+        return depthA != depthB ? depthA < depthB : a < b;
+    });
+    for (uint32_t k : candidates) {
+        const OutputData& data = outputData[k];
+        bins.largeSplats.push_back(k);
+        bins.largeRects.push_back(glm::ivec4(data.botCorner, data.topCorner));
+        bins.largeEntries += tileCount(data);
+    }
+    return overflow;
+}
+
+// Duplicates every splat into each tile it touches and sorts the (tile << 16 | depth) keys.
+// Ties are broken by the splat index so that the result is deterministic.
+// Splats covering more than largeSplatTiles tiles go to TileBins::largeSplats instead, 0 = none.
+inline TileBins binTilesSortKeys(const OutputData* outputData, uint32_t numSplats, FrameArena& arena, const TileGrid& grid = TileGrid(),
+                                 const TileOccluders* occluders = nullptr, uint32_t largeSplatTiles = LARGE_SPLAT_TILES) {
+    TileBins bins(arena, grid);
+
+    // count the keys first so that the vectors are allocated exactly once
+    size_t numKeys = 0;
+    std::vector<uint32_t> candidates;
+    for (uint32_t k = 0; k < numSplats; k++) {
+        const OutputData& data = outputData[k];
+        if (!isVisible(data)) continue;
+        // as in visibleSplats(), a splat hidden in all its tiles is binned (and dropped) as usual
+        if (largeSplatTiles > 0 && tileCount(data) > largeSplatTiles && !(occluders && occluders->occludesAll(data, grid))) {
+            candidates.push_back(k);
+        } else {
+            numKeys += tileCount(data);
+        }
+    }
+    const std::vector<uint32_t> overflow = selectLargeSplats(outputData, candidates, bins);
+    for (uint32_t k : overflow) numKeys += tileCount(outputData[k]);
+    if (numKeys == 0) return bins;
+
+    // the large splats by index, skipped below
+    std::vector<uint32_t> large(bins.largeSplats.begin(), bins.largeSplats.end());
+    std::sort(large.begin(), large.end());
+
+    FrameVector<std::tuple<uint32_t, uint32_t>> keyAndIndex{ArenaAllocator<std::tuple<uint32_t, uint32_t>>(arena)};
+    keyAndIndex.reserve(numKeys);
+
+    for (uint32_t k = 0; k < numSplats; k++) {
+        const OutputData& data = outputData[k];
+        if (!isVisible(data)) continue;
+        if (!large.empty() && std::binary_search(large.begin(), large.end(), k)) continue;
+
+        uint32_t depth = depthKey(data);
+        for (int j = data.botCorner.y; j <= data.topCorner.y; j++) {
+            for (int i = data.botCorner.x; i <= data.topCorner.x; i++) {
+                uint32_t index = static_cast<uint32_t>(j * grid.x + i);
+                if (occluders && occluders->occludes(index, depth)) {
+                    bins.occludedEntries++;
+                    continue;
+                }
+                keyAndIndex.push_back(std::tuple<uint32_t, uint32_t>((index << 16) | depth, k));
+            }
+        }
+    }
+
+    if (keyAndIndex.empty()) return bins;
+    std::sort(keyAndIndex.begin(), keyAndIndex.end());
+
+    bins.sortedIndices.reserve(keyAndIndex.size());
+
+    uint32_t prevTileIdx = std::get<0>(keyAndIndex[0]) >> 16;
+    for (uint32_t i = 0; i < keyAndIndex.size(); i++) {
+        uint32_t curTileIdx = std::get<0>(keyAndIndex[i]) >> 16;
+        if (prevTileIdx != curTileIdx) {
+            for (uint32_t j = prevTileIdx + 1; j <= curTileIdx; j++) {
+                bins.ranges[j] = i;
+            }
+            prevTileIdx = curTileIdx;
+        }
+        bins.sortedIndices.push_back(std::get<1>(keyAndIndex[i]));
+    }
+
+    for (uint32_t j = prevTileIdx + 1; j < bins.ranges.size(); j++) {
+        bins.ranges[j] = static_cast<uint32_t>(keyAndIndex.size());
+    }
+
+    return bins;
+}
+
+// Distributes the visible splats into the tiles with a counting sort: every job counts the tiles of a
+// contiguous part of visible, an exclusive prefix sum over (tile, job) gives every job its write offsets,
+// and a stable scatter keeps the order of visible inside the tiles. Entries behind the occluders are skipped.
+// numThreads limits the number of parts, 0 = as many as the job system runs at once.
+inline void countTiles(const OutputData* outputData, const FrameVector<uint32_t>& visible, TileBins& bins, FrameArena& arena, const TileGrid& grid, unsigned int numThreads,
+                       const TileOccluders* occluders = nullptr) {
+    const uint32_t numTiles = grid.count();
+
+    JobSystem& jobs = JobSystem::global();
+    if (numThreads == 0) numThreads = jobs.concurrency();
+    numThreads = std::min<unsigned int>(numThreads, static_cast<unsigned int>(visible.size() / 1024 + 1));
+    const uint32_t numVisible = static_cast<uint32_t>(visible.size());
+    const uint32_t chunk = (numVisible + numThreads - 1) / numThreads;
+
+    auto parallelFor = [&jobs, numThreads](auto&& body) {
+        jobs.parallelChunks(numThreads, [&body](size_t t) { body(static_cast<unsigned int>(t)); });
+    };
+
+    // count pass, one histogram per thread
+    FrameVector<uint32_t> counts{ArenaAllocator<uint32_t>(arena)};
+    counts.resize(static_cast<size_t>(numThreads) * numTiles, 0);
+    std::vector<size_t> occluded(numThreads, 0);
+
+    parallelFor([&](unsigned int t) {
+        uint32_t* histogram = counts.data() + static_cast<size_t>(t) * numTiles;
+        uint32_t end = std::min(numVisible, (t + 1) * chunk);
+        for (uint32_t v = t * chunk; v < end; v++) {
+            const OutputData& data = outputData[visible[v]];
+            const uint32_t key = depthKey(data);
+            for (int j = data.botCorner.y; j <= data.topCorner.y; j++) {
+                for (int i = data.botCorner.x; i <= data.topCorner.x; i++) {
+                    if (occluders && occluders->occludes(j * grid.x + i, key)) occluded[t]++;
+                    else histogram[j * grid.x + i]++;
+                }
+            }
+        }
+    });
+    for (size_t count : occluded) bins.occludedEntries += count;
+
+    // exclusive prefix sum over tiles, and over the parts inside a tile so that the scatter stays stable
+    const size_t tileGrain = 512;
+    jobs.parallelFor(0, numTiles, tileGrain, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            uint32_t sum = 0;
+            for (unsigned int t = 0; t < numThreads; t++) sum += counts[static_cast<size_t>(t) * numTiles + tile];
+            bins.ranges[tile] = sum;
+        }
+    });
+    const uint32_t total = jobs.exclusiveScan(bins.ranges.data(), numTiles, tileGrain);
+    bins.ranges[numTiles] = total;
+    jobs.parallelFor(0, numTiles, tileGrain, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            uint32_t offset = bins.ranges[tile];
+            for (unsigned int t = 0; t < numThreads; t++) {
+                uint32_t& count = counts[static_cast<size_t>(t) * numTiles + tile];
+                uint32_t c = count;
+                count = offset;
+                offset += c;
+            }
+        }
+    });
+
+    // stable scatter
+    bins.sortedIndices.resize(total);
+    parallelFor([&](unsigned int t) {
+        uint32_t* offsets = counts.data() + static_cast<size_t>(t) * numTiles;
+        uint32_t end = std::min(numVisible, (t + 1) * chunk);
+        for (uint32_t v = t * chunk; v < end; v++) {
+            const uint32_t k = visible[v];
+            const OutputData& data = outputData[k];
+            const uint32_t key = depthKey(data);
+            for (int j = data.botCorner.y; j <= data.topCorner.y; j++) {
+                for (int i = data.botCorner.x; i <= data.topCorner.x; i++) {
+                    if (occluders && occluders->occludes(j * grid.x + i, key)) continue;
+                    bins.sortedIndices[offsets[j * grid.x + i]++] = k;
+                }
+            }
+        }
+    });
+}
+
+// the visible splats, without the ones hidden in all their tiles so that they do not enter the depth sort, and
+// without the large splats, which go to bins.largeSplats (largeSplatTiles = 0: none).
+// Every job compacts a chunk in place, then the chunks are moved together in order.
+inline FrameVector<uint32_t> visibleSplats(const OutputData* outputData, uint32_t numSplats, FrameArena& arena, TileBins& bins,
+                                           const TileGrid& grid, const TileOccluders* occluders, unsigned int numThreads = 0,
+                                           uint32_t largeSplatTiles = 0) {
+    FrameVector<uint32_t> visible{ArenaAllocator<uint32_t>(arena)};
+    if (numSplats == 0) return visible;
+    visible.resize(numSplats);
+
+    const uint32_t grain = numThreads == 1 ? numSplats : 16384;
+    const uint32_t numChunks = (numSplats + grain - 1) / grain;
+    std::vector<uint32_t> counts(numChunks, 0);
+    std::vector<size_t> occluded(numChunks, 0);
+    std::vector<std::vector<uint32_t>> candidates(numChunks);
+
+    JobSystem::global().parallelChunks(numChunks, [&](size_t c) {
+        const uint32_t begin = static_cast<uint32_t>(c) * grain;
+        const uint32_t end = std::min(numSplats, begin + grain);
+        uint32_t count = 0;
+        for (uint32_t k = begin; k < end; k++) {
+            if (!isVisible(outputData[k])) continue;
+            if (occluders && occluders->occludesAll(outputData[k], grid)) {
+                occluded[c] += tileCount(outputData[k]);
+                continue;
+            }
+            if (largeSplatTiles > 0 && tileCount(outputData[k]) > largeSplatTiles) {
+                candidates[c].push_back(k);
+                continue;
+            }
+            visible[begin + count++] = k;
+        }
+        counts[c] = count;
+    });
+
+    uint32_t total = 0;
+    for (uint32_t c = 0; c < numChunks; c++) {
+        if (total != c * grain) {
+            std::copy(visible.begin() + c * grain, visible.begin() + c * grain + counts[c], visible.begin() + total);
+        }
+        total += counts[c];
+        bins.occludedEntries += occluded[c];
+    }
+    visible.resize(total);
+
+    std::vector<uint32_t> large;
+    for (const std::vector<uint32_t>& chunk : candidates) large.insert(large.end(), chunk.begin(), chunk.end());
+    if (large.empty()) return visible;
+
+    // more large splats than the rasterizers take, the rest goes back to the tiles
+    const std::vector<uint32_t> overflow = selectLargeSplats(outputData, large, bins);
+    if (!overflow.empty()) {
+        FrameVector<uint32_t> merged{ArenaAllocator<uint32_t>(arena)};
+        merged.resize(visible.size() + overflow.size());
+        std::merge(visible.begin(), visible.end(), overflow.begin(), overflow.end(), merged.begin());
+        visible.swap(merged);
+    }
+    return visible;
+}
+
+// Sorts only the visible splats by depth (stable 2 x 8 bit radix sort), then bins them with countTiles,
+// which keeps the depth order inside the tiles.
+// Produces the same ranges, indices and large splats as binTilesSortKeys.
+inline TileBins binTilesCounting(const OutputData* outputData, uint32_t numSplats, FrameArena& arena, const TileGrid& grid = TileGrid(), unsigned int numThreads = 0,
+                                 const TileOccluders* occluders = nullptr, uint32_t largeSplatTiles = LARGE_SPLAT_TILES) {
+    TileBins bins(arena, grid);
+
+    FrameVector<uint32_t> visible = visibleSplats(outputData, numSplats, arena, bins, grid, occluders, numThreads, largeSplatTiles);
+    if (visible.empty()) return bins;
+
+    // depth sort, low byte then high byte
+    FrameVector<uint32_t> scratch{ArenaAllocator<uint32_t>(arena)};
+    scratch.resize(visible.size());
+    for (int pass = 0; pass < 2; pass++) {
+        const int shift = pass * 8;
+        uint32_t offsets[256] = {};
+        for (uint32_t k : visible) offsets[(depthKey(outputData[k]) >> shift) & 0xFF]++;
+
+        uint32_t sum = 0;
+        for (uint32_t& offset : offsets) {
+            uint32_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (uint32_t k : visible) scratch[offsets[(depthKey(outputData[k]) >> shift) & 0xFF]++] = k;
+        visible.swap(scratch);
+    }
+
+    countTiles(outputData, visible, bins, arena, grid, numThreads, occluders);
+    return bins;
+}
+
+// Bins the visible splats in index order, without any depth sort. Only valid for BlendMode::WeightedBlended.
+inline TileBins binTilesUnsorted(const OutputData* outputData, uint32_t numSplats, FrameArena& arena, const TileGrid& grid = TileGrid(), unsigned int numThreads = 0,
+                                 uint32_t largeSplatTiles = LARGE_SPLAT_TILES) {
+    TileBins bins(arena, grid);
+
+    FrameVector<uint32_t> visible = visibleSplats(outputData, numSplats, arena, bins, grid, nullptr, numThreads, largeSplatTiles);
+    if (visible.empty()) return bins;
+
+    countTiles(outputData, visible, bins, arena, grid, numThreads);
+    return bins;
+}
+
+// occluders need depth sorted bins and are ignored by BinningMode::Unsorted
+inline TileBins binTiles(BinningMode mode, const OutputData* outputData, uint32_t numSplats, FrameArena& arena, const TileGrid& grid = TileGrid(),
+                         const TileOccluders* occluders = nullptr, uint32_t largeSplatTiles = LARGE_SPLAT_TILES) {
+    if (mode == BinningMode::CountingSort) return binTilesCounting(outputData, numSplats, arena, grid, 0, occluders, largeSplatTiles);
+    if (mode == BinningMode::Unsorted) return binTilesUnsorted(outputData, numSplats, arena, grid, 0, largeSplatTiles);
+    return binTilesSortKeys(outputData, numSplats, arena, grid, occluders, largeSplatTiles);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "rendering/tile_binning.h"
+
+// pixels of a tile, the evaluated and contributed counts are summed over them
+const uint32_t TILE_PIXELS = 16 * 16;
+
+// Per tile counters of a BlendMode::Sorted rasterize(), written by process_pixels.cs when it is compiled with
+// TILE_STATS (SplatRenderer::setTileStats) and read with SplatRenderer::readTileStats. Matches TileStats there.
+struct TileStats {
+    uint32_t splats;          // splats of the tile, with the large splats touching it
+    uint32_t truncated;       // splats beyond maxSplatsPerTile, never blended
+    uint32_t evaluated;       // splats visited by the pixels before they saturated, summed over the pixels
+    uint32_t contributed;     // splats above the alpha cutoff that were blended, summed over the pixels
+    uint32_t saturated;       // pixels that saturated (early termination)
+    uint32_t saturationDepth; // ndc depth as float bits at which the last pixel saturated, NO_SATURATION if one never did
+};
+
+enum class TileMetric {
+    Splats,
+    Truncated,
+    Evaluated,      // per pixel
+    Contributed,    // per pixel
+    SaturationDepth
+};
+
+const char* const TILE_METRIC_NAMES[] = {"Splats", "Truncated", "Evaluated / pixel", "Contributed / pixel", "Saturation depth"};
+
+// ndc depth at which the tile saturated, 1 (the far plane) if some pixel never did
+inline float tileSaturationDepth(const TileStats& stats) {
+    if (stats.saturationDepth == NO_SATURATION) return 1.0f;
+    float depth;
+    std::memcpy(&depth, &stats.saturationDepth, sizeof(depth));
+    return depth;
+}
+
+inline float tileMetric(const TileStats& stats, TileMetric metric) {
+    switch (metric) {
+        case TileMetric::Splats: return static_cast<float>(stats.splats);
+        case TileMetric::Truncated: return static_cast<float>(stats.truncated);
+        case TileMetric::Evaluated: return static_cast<float>(stats.evaluated) / TILE_PIXELS;
+        case TileMetric::Contributed: return static_cast<float>(stats.contributed) / TILE_PIXELS;
+        case TileMetric::SaturationDepth: return tileSaturationDepth(stats);
+    }
+    return 0.0f;
+}
+
+// totals over the tiles of a frame
+struct TileStatsSummary {
+    uint32_t maxSplats = 0;
+    uint32_t truncatedTiles = 0;
+    uint64_t truncatedSplats = 0;
+    uint32_t saturatedTiles = 0;     // every pixel saturated
+    float meanEvaluated = 0.0f;      // per pixel
+    float meanContributed = 0.0f;    // per pixel
+};
+
+inline TileStatsSummary summarizeTileStats(const std::vector<TileStats>& stats) {
+    TileStatsSummary summary;
+    uint64_t evaluated = 0;
+    uint64_t contributed = 0;
+    for (const TileStats& tile : stats) {
+        summary.maxSplats = std::max(summary.maxSplats, tile.splats);
+        if (tile.truncated > 0) summary.truncatedTiles++;
+        summary.truncatedSplats += tile.truncated;
+        if (tile.saturated == TILE_PIXELS) summary.saturatedTiles++;
+        evaluated += tile.evaluated;
+        contributed += tile.contributed;
+    }
+    if (!stats.empty()) {
+        summary.meanEvaluated = static_cast<float>(evaluated) / (stats.size() * TILE_PIXELS);
+        summary.meanContributed = static_cast<float>(contributed) / (stats.size() * TILE_PIXELS);
+    }
+    return summary;
+}
+
+// One RGBA8 texel per tile (bottom row first, like the tiles) for an overlay on the rendered image: blue to red
+// over [0, largest value of the frame], the depth over [0, 1]. Truncated shows only the tiles that truncate,
+// empty tiles are transparent.
+inline void tileHeatmap(const std::vector<TileStats>& stats, TileMetric metric, std::vector<uint8_t>& rgba) {
+    float maxValue = metric == TileMetric::SaturationDepth ? 1.0f : 0.0f;
+    if (metric != TileMetric::SaturationDepth) {
+        for (const TileStats& tile : stats) maxValue = std::max(maxValue, tileMetric(tile, metric));
+    }
+
+    rgba.assign(stats.size() * 4, 0);
+    for (size_t t = 0; t < stats.size(); t++) {
+        if (stats[t].splats == 0) continue;
+        if (metric == TileMetric::Truncated && stats[t].truncated == 0) continue;
+
+        const float v = maxValue > 0.0f ? std::min(1.0f, tileMetric(stats[t], metric) / maxValue) : 0.0f;
+        // blue, cyan, green, yellow, red
+        const glm::vec3 color = glm::clamp(glm::vec3(4.0f * v - 2.0f, 2.0f - std::abs(4.0f * v - 2.0f), 2.0f - 4.0f * v), 0.0f, 1.0f);
+        rgba[t * 4 + 0] = static_cast<uint8_t>(color.x * 255.0f);
+        rgba[t * 4 + 1] = static_cast<uint8_t>(color.y * 255.0f);
+        rgba[t * 4 + 2] = static_cast<uint8_t>(color.z * 255.0f);
+        rgba[t * 4 + 3] = 160;
+    }
+}
+
+// Writes the tile stats of every frame to a csv file, one row per tile
+class TileStatsLog {
+public:
+    bool open(const std::string& file) {
+        log.open(file);
+        if (!log) {
+            std::cerr << "Could not write tile stats " << file << std::endl;
+            return false;
+        }
+        log << "frame,tile_x,tile_y,splats,truncated,evaluated_per_pixel,contributed_per_pixel,saturated_pixels,saturation_depth" << std::endl;
+        return true;
+    }
+
+    bool isOpen() const { return log.is_open(); }
+
+    void write(uint32_t frame, const TileGrid& grid, const std::vector<TileStats>& stats) {
+        if (!log) return;
+        for (uint32_t t = 0; t < grid.count() && t < stats.size(); t++) {
+            const TileStats& tile = stats[t];
+            log << frame << "," << t % grid.x << "," << t / grid.x << "," << tile.splats << "," << tile.truncated << ","
+                << tileMetric(tile, TileMetric::Evaluated) << "," << tileMetric(tile, TileMetric::Contributed) << ","
+                << tile.saturated << "," << tileSaturationDepth(tile) << "\n";
+        }
+    }
+
+private:
+    std::ofstream log;
+};
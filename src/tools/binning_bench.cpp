@@ -0,0 +1,127 @@
+// Compares the two binning engines of tile_binning.h on synthetic frames with different duplication
+// factors (average number of tiles a visible splat touches), and checks that they produce the same bins.
+// Then adds a few screen filling splats, as seen with the camera close to the model, and compares the sort keys
+// and binning times with and without the large splat list (LARGE_SPLAT_TILES).
+//
+// usage: binningBench [numSplats] [repetitions]
+
+#include "core/frame_arena.h"
+#include "rendering/tile_binning.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+// random splats with square tile footprints of up to maxSide tiles, 10% of them culled
+std::vector<OutputData> makeFrame(uint32_t numSplats, int maxSide, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+    std::uniform_int_distribution<int> side(1, maxSide);
+    std::uniform_int_distribution<int> tile(0, NUM_TILES_X - 1);
+    std::uniform_int_distribution<int> culled(0, 9);
+
+    std::vector<OutputData> frame(numSplats);
+    for (OutputData& data : frame) {
+        data.position = glm::vec4(0.0f, 0.0f, depth(rng), 1.0f);
+        if (culled(rng) == 0) {
+            data.topCorner = glm::ivec2(-1);
+            continue;
+        }
+        int s = side(rng);
+        data.botCorner = glm::ivec2(tile(rng), tile(rng));
+        data.topCorner = glm::ivec2(
+            std::min<int>(NUM_TILES_X - 1, data.botCorner.x + s - 1),
+            std::min<int>(NUM_TILES_Y - 1, data.botCorner.y + s - 1));
+    }
+    return frame;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t numSplats = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1000000;
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    using Clock = std::chrono::steady_clock;
+    FrameArena arena(1 << 26);
+
+    std::cout << "splats: " << numSplats << std::endl;
+    std::cout << "tiles/splat   sort keys (ms)   counting sort (ms)   speedup" << std::endl;
+
+    for (int maxSide : {1, 2, 4, 8, 16}) {
+        std::vector<OutputData> frame = makeFrame(numSplats, maxSide, 1234u + maxSide);
+
+        double bestSort = 1e30;
+        double bestCounting = 1e30;
+        float duplication = 0.0f;
+        bool identical = true;
+
+        for (int r = 0; r < repetitions; r++) {
+            arena.reset();
+
+            auto start = Clock::now();
+            TileBins sorted = binTilesSortKeys(frame.data(), numSplats, arena);
+            bestSort = std::min(bestSort, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            start = Clock::now();
+            TileBins counted = binTilesCounting(frame.data(), numSplats, arena);
+            bestCounting = std::min(bestCounting, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            identical = identical && sorted.ranges == counted.ranges && sorted.sortedIndices == counted.sortedIndices &&
+                sorted.largeSplats == counted.largeSplats;
+
+            uint32_t numVisible = 0;
+            for (const OutputData& data : frame) {
+                if (isVisible(data)) numVisible++;
+            }
+            duplication = static_cast<float>(sorted.sortedIndices.size()) / std::max(1u, numVisible);
+        }
+
+        std::cout << duplication << "\t\t" << bestSort << "\t\t" << bestCounting << "\t\t" << bestSort / bestCounting << "x"
+            << (identical ? "" : "   MISMATCH") << std::endl;
+
+        if (!identical) return 1;
+    }
+
+    // close-up frames: splats of up to 2 x 2 tiles plus a few that cover 20 x 20 to all 50 x 50 tiles
+    std::cout << "large splats   keys without   keys with   counting sort without / with (ms)" << std::endl;
+    for (uint32_t numLarge : {0u, 4u, 16u, 64u}) {
+        std::vector<OutputData> frame = makeFrame(numSplats, 2, 99u);
+        std::mt19937 rng(numLarge);
+        std::uniform_int_distribution<int> side(20, NUM_TILES_X);
+        for (uint32_t i = 0; i < numLarge && i < numSplats; i++) {
+            OutputData& data = frame[i * (numSplats / numLarge)];
+            const int s = side(rng);
+            data.botCorner = glm::ivec2(std::uniform_int_distribution<int>(0, NUM_TILES_X - s)(rng));
+            data.topCorner = data.botCorner + glm::ivec2(s - 1);
+        }
+
+        double bestWithout = 1e30;
+        double bestWith = 1e30;
+        size_t keysWithout = 0;
+        size_t keysWith = 0;
+        for (int r = 0; r < repetitions; r++) {
+            arena.reset();
+
+            auto start = Clock::now();
+            TileBins without = binTilesCounting(frame.data(), numSplats, arena, TileGrid(), 0, nullptr, 0);
+            bestWithout = std::min(bestWithout, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            start = Clock::now();
+            TileBins with = binTilesCounting(frame.data(), numSplats, arena);
+            bestWith = std::min(bestWith, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            keysWithout = without.sortedIndices.size();
+            keysWith = with.sortedIndices.size();
+            if (keysWith + with.largeEntries != keysWithout) {
+                std::cout << "MISMATCH" << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << numLarge << "\t\t" << keysWithout << "\t" << keysWith << "\t" << bestWithout << " / " << bestWith << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Measures the build time of the splat BVH in splat_bvh.h and the throughput of its queries (picking rays, box and
+// sphere regions, nearest splat) on one thread and on all threads of the job system, and checks a sample of every
+// query against a brute force search over all splats.
+// Without a model a synthetic scene of random splats is used, with a model the queries are spread over its bounds.
+//
+// usage: bvhBench [model.ply | numSplats] [queries] [repetitions]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/job_system.h"
+#include "model_loading/splat_model.h"
+#include "model_loading/splat_bvh.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+
+// random anisotropic splats in a 8 x 8 x 8 box around the origin
+void makeScene(uint32_t numSplats, std::vector<glm::mat4>& covAndPos, std::vector<glm::vec4>& colorAndOpacity) {
+    std::mt19937 rng(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    covAndPos.resize(numSplats);
+    colorAndOpacity.resize(numSplats);
+    for (uint32_t i = 0; i < numSplats; i++) {
+        glm::vec3 scale(0.002f + 0.02f * unit(rng), 0.002f + 0.02f * unit(rng), 0.002f + 0.02f * unit(rng));
+        float angle = 6.2831853f * unit(rng);
+        glm::mat3 R = glm::mat3(glm::rotate(glm::mat4(1.0f), angle, glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + 0.01f)));
+        glm::mat3 S(scale.x, 0.0f, 0.0f, 0.0f, scale.y, 0.0f, 0.0f, 0.0f, scale.z);
+
+        glm::mat4 cov = glm::mat4(R * S * S * glm::transpose(R));
+        cov[3] = glm::vec4(8.0f * unit(rng) - 4.0f, 8.0f * unit(rng) - 4.0f, 8.0f * unit(rng) - 4.0f, 0.0f);
+        covAndPos[i] = cov;
+        colorAndOpacity[i] = glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng));
+    }
+}
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// best of repetitions of query(q) for every q, on one thread or split over the job system
+template<typename Query>
+double timeQueries(size_t numQueries, int repetitions, bool parallel, Query&& query) {
+    double best = 1e30;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        if (parallel) {
+            JobSystem::global().parallelFor(0, numQueries, 256, [&](size_t begin, size_t end) {
+                for (size_t q = begin; q < end; q++) query(q);
+            });
+        } else {
+            for (size_t q = 0; q < numQueries; q++) query(q);
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+void printThroughput(const char* name, size_t numQueries, double single, double all, double resultsPerQuery) {
+    std::cout << name << single / numQueries * 1e6 << " us/query, " << numQueries / single / 1e6 << " M queries/s on 1 thread, "
+        << numQueries / all / 1e6 << " M queries/s on all, " << resultsPerQuery << " splats/query" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string source = argc > 1 ? argv[1] : "2000000";
+    const size_t numQueries = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 100000;
+    const int repetitions = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    std::vector<glm::mat4> covAndPos;
+    std::vector<glm::vec4> colorAndOpacity;
+    if (source.find_first_not_of("0123456789") == std::string::npos) {
+        makeScene(static_cast<uint32_t>(std::stoul(source)), covAndPos, colorAndOpacity);
+    } else {
+        SplatModel model(source);
+        if (!model.loaded) return 1;
+        covAndPos = std::move(model.covAndPos);
+        colorAndOpacity = std::move(model.colorAndOpacity);
+    }
+    const uint32_t numSplats = static_cast<uint32_t>(covAndPos.size());
+    std::cout << "splats: " << numSplats << ", threads: " << JobSystem::global().concurrency() << std::endl;
+
+    // build
+    std::unique_ptr<SplatBvh> bvh;
+    double buildTime = 1e30;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        bvh = std::make_unique<SplatBvh>(covAndPos, colorAndOpacity, numSplats);
+        buildTime = std::min(buildTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::cout << "build: " << buildTime * 1000.0 << " ms, " << numSplats / buildTime / 1e6 << " M splats/s, "
+        << bvh->nodes().size() << " nodes, depth " << bvh->depth() << ", " << bvh->memoryBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    // the queries are spread over the bounds of the splat centers
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (const glm::mat4& m : covAndPos) {
+        lo = glm::min(lo, glm::vec3(m[3]));
+        hi = glm::max(hi, glm::vec3(m[3]));
+    }
+    const glm::vec3 center = (lo + hi) * 0.5f;
+    const float size = glm::length(hi - lo);
+
+    std::mt19937 rng(42u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto inBounds = [&]() { return lo + (hi - lo) * glm::vec3(unit(rng), unit(rng), unit(rng)); };
+
+    // picking rays from cameras around the model through random points of it, like mouse clicks
+    std::vector<Ray> rays(numQueries);
+    std::vector<glm::vec3> points(numQueries);
+    std::vector<float> radii(numQueries);
+    for (size_t q = 0; q < numQueries; q++) {
+        const glm::vec3 eye = center + glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) - 0.5f) * size;
+        rays[q] = Ray{eye, glm::normalize(inBounds() - eye)};
+        points[q] = inBounds();
+        radii[q] = size * (0.002f + 0.02f * unit(rng));
+    }
+
+    const float minAlpha = 0.1f;
+    std::vector<SplatHit> hits(numQueries);
+    const double pickSingle = timeQueries(numQueries, repetitions, false, [&](size_t q) { hits[q] = bvh->pick(rays[q].origin, rays[q].direction, minAlpha); });
+    const double pickAll = timeQueries(numQueries, repetitions, true, [&](size_t q) { hits[q] = bvh->pick(rays[q].origin, rays[q].direction, minAlpha); });
+    size_t numHits = 0;
+    for (const SplatHit& hit : hits) numHits += hit.index != NO_SPLAT;
+    printThroughput("pick:    ", numQueries, pickSingle, pickAll, static_cast<double>(numHits) / numQueries);
+
+    std::vector<size_t> boxCounts(numQueries);
+    auto boxQuery = [&](size_t q) {
+        std::vector<uint32_t> splats;
+        bvh->queryBox(points[q] - radii[q], points[q] + radii[q], splats);
+        boxCounts[q] = splats.size();
+    };
+    const double boxSingle = timeQueries(numQueries, repetitions, false, boxQuery);
+    const double boxAll = timeQueries(numQueries, repetitions, true, boxQuery);
+    size_t boxTotal = 0;
+    for (size_t count : boxCounts) boxTotal += count;
+    printThroughput("box:     ", numQueries, boxSingle, boxAll, static_cast<double>(boxTotal) / numQueries);
+
+    std::vector<size_t> sphereCounts(numQueries);
+    auto sphereQuery = [&](size_t q) {
+        std::vector<uint32_t> splats;
+        bvh->querySphere(points[q], radii[q], splats);
+        sphereCounts[q] = splats.size();
+    };
+    const double sphereSingle = timeQueries(numQueries, repetitions, false, sphereQuery);
+    const double sphereAll = timeQueries(numQueries, repetitions, true, sphereQuery);
+    size_t sphereTotal = 0;
+    for (size_t count : sphereCounts) sphereTotal += count;
+    printThroughput("sphere:  ", numQueries, sphereSingle, sphereAll, static_cast<double>(sphereTotal) / numQueries);
+
+    std::vector<uint32_t> nearest(numQueries);
+    const double nearestSingle = timeQueries(numQueries, repetitions, false, [&](size_t q) { nearest[q] = bvh->nearest(points[q], minAlpha); });
+    const double nearestAll = timeQueries(numQueries, repetitions, true, [&](size_t q) { nearest[q] = bvh->nearest(points[q], minAlpha); });
+    printThroughput("nearest: ", numQueries, nearestSingle, nearestAll, 1.0);
+
+    // a sample of the queries against a brute force search
+    const size_t numChecked = std::min<size_t>(numQueries, 200);
+    uint32_t mismatches = 0;
+    for (size_t q = 0; q < numChecked; q++) {
+        SplatHit reference;
+        size_t boxReference = 0;
+        size_t sphereReference = 0;
+        uint32_t nearestReference = NO_SPLAT;
+        float nearest2 = std::numeric_limits<float>::infinity();
+
+        for (uint32_t i = 0; i < numSplats; i++) {
+            float t, alpha;
+            if (bvh->intersectSplat(i, rays[q].origin, rays[q].direction, t, alpha) && alpha >= minAlpha && t > 0.0f && t < reference.distance) {
+                reference.index = i;
+                reference.distance = t;
+            }
+
+            const glm::vec3 c(covAndPos[i][3]);
+            if (glm::all(glm::lessThanEqual(points[q] - radii[q], c)) && glm::all(glm::lessThanEqual(c, points[q] + radii[q]))) boxReference++;
+            const float d2 = glm::dot(c - points[q], c - points[q]);
+            if (d2 <= radii[q] * radii[q]) sphereReference++;
+            if (d2 < nearest2 && colorAndOpacity[i].w >= minAlpha) {
+                nearest2 = d2;
+                nearestReference = i;
+            }
+        }
+
+        if (reference.index != hits[q].index || boxReference != boxCounts[q] || sphereReference != sphereCounts[q] || nearestReference != nearest[q]) {
+            mismatches++;
+        }
+    }
+    std::cout << "brute force check: " << mismatches << " of " << numChecked << " queries differ" << std::endl;
+    if (mismatches > 0) std::cout << "MISMATCH" << std::endl;
+    return mismatches > 0 ? 1 : 0;
+}
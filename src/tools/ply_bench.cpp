@@ -0,0 +1,129 @@
+// Compares the throughput of the memory mapped binary PLY reader against miniply.
+// Both paths extract the attributes SplatModel needs (position, opacity, scale, rot, f_dc)
+// and the outputs are checked to be identical.
+//
+// usage: plyBench <file.ply> [repetitions] [threads]
+
+#include <miniply.h>
+
+#include "model_loading/ply_reader.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+
+struct Attributes {
+    std::vector<float> position;
+    std::vector<float> opacity;
+    std::vector<float> scale;
+    std::vector<float> rot;
+    std::vector<float> color;
+
+    void resize(uint32_t numPoints) {
+        position.resize(numPoints * 3);
+        opacity.resize(numPoints);
+        scale.resize(numPoints * 3);
+        rot.resize(numPoints * 4);
+        color.resize(numPoints * 3);
+    }
+
+    bool operator==(const Attributes& other) const {
+        return position == other.position && opacity == other.opacity && scale == other.scale &&
+            rot == other.rot && color == other.color;
+    }
+};
+
+// same extraction sequence as the miniply path of SplatModel::loadPLY
+bool loadMiniply(const std::string& plyFile, Attributes& out) {
+    miniply::PLYReader reader(plyFile.c_str());
+    if (!reader.valid() || !reader.has_element() || !reader.element_is("vertex") || !reader.load_element()) {
+        return false;
+    }
+
+    const uint32_t numPoints = reader.num_rows();
+    out.resize(numPoints);
+
+    auto extract = [&](const std::vector<std::string>& names, float* dst) {
+        uint32_t indices[16];
+        for (size_t i = 0; i < names.size(); i++) {
+            indices[i] = reader.find_property(names[i].c_str());
+            if (indices[i] == miniply::kInvalidIndex) return false;
+        }
+        return reader.extract_properties(indices, static_cast<uint32_t>(names.size()), miniply::PLYPropertyType::Float, dst);
+    };
+
+    bool ok = extract({"x", "y", "z"}, out.position.data()) &&
+        extract({"opacity"}, out.opacity.data()) &&
+        extract({"scale_0", "scale_1", "scale_2"}, out.scale.data()) &&
+        extract({"rot_0", "rot_1", "rot_2", "rot_3"}, out.rot.data()) &&
+        extract({"f_dc_0", "f_dc_1", "f_dc_2"}, out.color.data());
+    return ok;
+}
+
+bool loadBinary(const std::string& plyFile, Attributes& out, unsigned int numThreads) {
+    BinaryPlyReader reader(plyFile);
+    if (!reader.valid()) return false;
+
+    out.resize(reader.numRows());
+    return reader.extract({
+        {{"x", "y", "z"}, out.position.data()},
+        {{"opacity"}, out.opacity.data()},
+        {{"scale_0", "scale_1", "scale_2"}, out.scale.data()},
+        {{"rot_0", "rot_1", "rot_2", "rot_3"}, out.rot.data()},
+        {{"f_dc_0", "f_dc_1", "f_dc_2"}, out.color.data()},
+    }, numThreads);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cout << "usage: " << argv[0] << " <file.ply> [repetitions] [threads]" << std::endl;
+        return 1;
+    }
+
+    const std::string plyFile = argv[1];
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    const unsigned int numThreads = argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 0;
+
+    using Clock = std::chrono::steady_clock;
+
+    Attributes miniplyAttributes;
+    Attributes binaryAttributes;
+    // from the header, outside of the timed loads
+    const size_t vertexBytes = BinaryPlyReader(plyFile).vertexBytes();
+
+    double bestMiniply = 1e30;
+    double bestBinary = 1e30;
+
+    for (int i = 0; i < repetitions; i++) {
+        auto start = Clock::now();
+        if (!loadMiniply(plyFile, miniplyAttributes)) {
+            std::cerr << "miniply failed to load " << plyFile << std::endl;
+            return 1;
+        }
+        bestMiniply = std::min(bestMiniply, std::chrono::duration<double>(Clock::now() - start).count());
+
+        start = Clock::now();
+        if (!loadBinary(plyFile, binaryAttributes, numThreads)) {
+            std::cerr << "Binary reader does not support " << plyFile << std::endl;
+            return 1;
+        }
+        bestBinary = std::min(bestBinary, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    if (!(miniplyAttributes == binaryAttributes)) {
+        std::cerr << "Outputs differ between miniply and the binary reader" << std::endl;
+        return 1;
+    }
+
+    const double gigabytes = static_cast<double>(vertexBytes) / 1e9;
+
+    std::cout << "Vertex data: " << vertexBytes << " bytes, " << miniplyAttributes.opacity.size() << " points" << std::endl;
+    std::cout << "miniply:       " << bestMiniply * 1000.0 << " ms, " << gigabytes / bestMiniply << " GB/s" << std::endl;
+    std::cout << "binary reader: " << bestBinary * 1000.0 << " ms, " << gigabytes / bestBinary << " GB/s" << std::endl;
+    std::cout << "speedup:       " << bestMiniply / bestBinary << "x" << std::endl;
+
+    return 0;
+}
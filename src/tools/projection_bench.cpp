@@ -0,0 +1,136 @@
+// Measures the throughput of the CPU projection in cpu_projection.h (splats/s) with the scalar code, the vector
+// code on one thread and the vector code on all threads of the job system, and checks that the vector results
+// match the scalar ones.
+// Without a model a synthetic scene of random splats in front of the camera is used; with a model the camera
+// looks at it from the front, far enough back to see all of it.
+//
+// usage: projectionBench [model.ply | numSplats] [threads] [repetitions]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/job_system.h"
+#include "model_loading/splat_model.h"
+#include "rendering/cpu_projection.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+
+// random anisotropic splats in a 8 x 8 x 8 box centered 6 units in front of the origin
+void makeScene(uint32_t numSplats, std::vector<glm::mat4>& covAndPos, std::vector<glm::vec4>& colorAndOpacity) {
+    std::mt19937 rng(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    covAndPos.resize(numSplats);
+    colorAndOpacity.resize(numSplats);
+    for (uint32_t i = 0; i < numSplats; i++) {
+        glm::vec3 scale(0.002f + 0.04f * unit(rng), 0.002f + 0.04f * unit(rng), 0.002f + 0.04f * unit(rng));
+        float angle = 6.2831853f * unit(rng);
+        glm::mat3 R = glm::mat3(glm::rotate(glm::mat4(1.0f), angle, glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + 0.01f)));
+        glm::mat3 S(scale.x, 0.0f, 0.0f, 0.0f, scale.y, 0.0f, 0.0f, 0.0f, scale.z);
+
+        glm::mat4 cov = glm::mat4(R * S * S * glm::transpose(R));
+        cov[3] = glm::vec4(8.0f * unit(rng) - 4.0f, 8.0f * unit(rng) - 4.0f, 8.0f * unit(rng) - 10.0f, 0.0f);
+        covAndPos[i] = cov;
+        colorAndOpacity[i] = glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng));
+    }
+}
+
+SplatView makeView(const glm::vec3& eye, const glm::vec3& target) {
+    const float near = 0.01f;
+    const float tanHalfFov = std::tan(glm::radians(45.0f) * 0.5f);
+
+    SplatView splatView;
+    splatView.view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    splatView.projection = glm::perspective(glm::radians(45.0f), 1.0f, near, 100.0f);
+    splatView.near = near;
+    splatView.screenRight = tanHalfFov * near;
+    splatView.screenTop = tanHalfFov * near;
+    return splatView;
+}
+
+int main(int argc, char** argv)
+{
+    std::string source = argc > 1 ? argv[1] : "2000000";
+    const unsigned int numThreads = argc > 2 ? static_cast<unsigned int>(std::atoi(argv[2])) : JobSystem::global().concurrency();
+    const int repetitions = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    std::vector<glm::mat4> covAndPos;
+    std::vector<glm::vec4> colorAndOpacity;
+    SplatView splatView = makeView(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+
+    if (source.find_first_not_of("0123456789") == std::string::npos) {
+        makeScene(static_cast<uint32_t>(std::stoul(source)), covAndPos, colorAndOpacity);
+    } else {
+        SplatModel model(source);
+        if (!model.loaded) return 1;
+        covAndPos = std::move(model.covAndPos);
+        colorAndOpacity = std::move(model.colorAndOpacity);
+
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for (const glm::mat4& m : covAndPos) {
+            lo = glm::min(lo, glm::vec3(m[3]));
+            hi = glm::max(hi, glm::vec3(m[3]));
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        splatView = makeView(center + glm::vec3(0.0f, 0.0f, 1.5f * glm::length(hi - lo)), center);
+    }
+
+    const uint32_t numSplats = static_cast<uint32_t>(covAndPos.size());
+    SplatSoA splats(covAndPos, colorAndOpacity, numSplats);
+    const TileGrid grid;
+    const float alphaCutoff = 1.0f / 255.0f;
+
+    struct Run {
+        const char* name;
+        unsigned int threads;
+        bool simd;
+    };
+    const Run runs[] = {
+        {"scalar, 1 thread ", 1, false},
+        {"vector, 1 thread ", 1, true},
+        {"vector, all      ", numThreads, true},
+    };
+
+    std::cout << "splats: " << numSplats << ", threads: " << numThreads
+#ifdef __AVX2__
+        << ", AVX2"
+#else
+        << ", no AVX2 (the vector runs use the scalar code)"
+#endif
+        << std::endl;
+
+    std::vector<std::unique_ptr<CpuProjector>> projectors;
+    for (const Run& run : runs) {
+        projectors.push_back(std::make_unique<CpuProjector>(splats));
+        CpuProjector& projector = *projectors.back();
+
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            projector.project(numSplats, splatView, grid, alphaCutoff, run.threads, run.simd);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << run.name << best * 1000.0 << " ms, " << numSplats / best / 1e6 << " M splats/s, "
+            << projector.visibleCount() << " visible" << std::endl;
+    }
+
+    // the vector path against the scalar reference
+    const CpuProjector& reference = *projectors[0];
+    const CpuProjector& vector = *projectors[2];
+    ProjectionDifference difference = compareProjections(vector.outputData(), vector.projected(), vector.visibleCount(),
+        reference.outputData(), reference.projected(), reference.visibleCount(), numSplats);
+
+    std::cout << "vector vs scalar: " << difference.unmatched << " unmatched, " << difference.cornerMismatches
+        << " tile rects differ, max ndc error " << difference.maxPositionError << ", max relative conic error "
+        << difference.maxConicError << std::endl;
+
+    const bool matches = difference.unmatched <= numSplats / 10000 && difference.maxPositionError < 1e-5f && difference.maxConicError < 1e-3f;
+    if (!matches) std::cout << "MISMATCH" << std::endl;
+    return matches ? 0 : 1;
+}
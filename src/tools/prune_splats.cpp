@@ -0,0 +1,321 @@
+// Removes splats that cost render time without contributing to the image and writes a compacted PLY.
+//
+// Rules (each one optional):
+//  --min-opacity a          opacity after the sigmoid is below a (default 1/255, the alpha skip threshold of process_pixels.cs)
+//  --min-scale s            largest axis (after exp) is below s
+//  --max-scale s            largest axis (after exp) is above s
+//  --max-anisotropy r       largest / smallest axis is above r
+//  --bbox x0 y0 z0 x1 y1 z1 position outside the box
+//  --floater-neighbors k    fewer than k other splats within --floater-radius (default: 3x the mean spacing)
+//
+// Only the attributes the viewer reads are written, higher SH bands and normals are dropped.
+// The CPU binning and sort of the render loop is timed on a fixed orbit around the model before and after pruning.
+//
+// usage: splatPrune <in.ply> <out.ply> [rules]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/job_system.h"
+#include "graphics/camera.h"
+#include "model_loading/splat_model.h"
+#include "model_loading/ply_writer.h"
+
+#include <iostream>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+struct PruneRules {
+    float minOpacity = 1.0f / 255.0f;
+    float minScale = 0.0f;
+    float maxScale = 0.0f;
+    float maxAnisotropy = 0.0f;
+    bool useBox = false;
+    glm::vec3 boxMin = glm::vec3(0.0f);
+    glm::vec3 boxMax = glm::vec3(0.0f);
+    uint32_t floaterNeighbors = 0;
+    float floaterRadius = 0.0f;
+};
+
+struct PruneCounts {
+    uint32_t opacity = 0;
+    uint32_t scale = 0;
+    uint32_t box = 0;
+    uint32_t floaters = 0;
+};
+
+// Counts the neighbours of every splat within radius using a uniform grid with cells of that size.
+std::vector<uint32_t> countNeighbors(const SplatModel& model, const std::vector<uint32_t>& candidates, float radius) {
+    auto cellOf = [radius](const float* p) {
+        return glm::ivec3(
+            static_cast<int>(std::floor(p[0] / radius)),
+            static_cast<int>(std::floor(p[1] / radius)),
+            static_cast<int>(std::floor(p[2] / radius)));
+    };
+    auto cellKey = [](const glm::ivec3& c) {
+        return (static_cast<uint64_t>(c.x & 0x1FFFFF) << 42) | (static_cast<uint64_t>(c.y & 0x1FFFFF) << 21) | static_cast<uint64_t>(c.z & 0x1FFFFF);
+    };
+
+    std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+    for (uint32_t i : candidates) {
+        grid[cellKey(cellOf(&model.position[3 * i]))].push_back(i);
+    }
+
+    std::vector<uint32_t> counts(candidates.size(), 0);
+    const float radiusSquared = radius * radius;
+
+    auto countRange = [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const uint32_t i = candidates[c];
+            const float* p = &model.position[3 * i];
+            const glm::ivec3 cell = cellOf(p);
+
+            uint32_t count = 0;
+            for (int dz = -1; dz <= 1; dz++)
+            for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                auto it = grid.find(cellKey(cell + glm::ivec3(dx, dy, dz)));
+                if (it == grid.end()) continue;
+                for (uint32_t j : it->second) {
+                    if (j == i) continue;
+                    const float* q = &model.position[3 * j];
+                    float d0 = p[0] - q[0], d1 = p[1] - q[1], d2 = p[2] - q[2];
+                    if (d0 * d0 + d1 * d1 + d2 * d2 <= radiusSquared) count++;
+                }
+            }
+            counts[c] = count;
+        }
+    };
+
+    JobSystem::global().parallelFor(0, candidates.size(), 1024, countRange);
+
+    return counts;
+}
+
+// model must be processed (activated values), the returned indices are in the original order
+std::vector<uint32_t> prune(const SplatModel& model, const PruneRules& rules, PruneCounts& counts) {
+    std::vector<uint32_t> kept;
+    kept.reserve(model.numPoints);
+
+    for (uint32_t i = 0; i < model.numPoints; i++) {
+        if (model.colorAndOpacity[i].w < rules.minOpacity) {
+            counts.opacity++;
+            continue;
+        }
+
+        const float* s = &model.scale[3 * i];
+        float largest = std::max(s[0], std::max(s[1], s[2]));
+        float smallest = std::min(s[0], std::min(s[1], s[2]));
+        if ((rules.minScale > 0.0f && largest < rules.minScale) ||
+            (rules.maxScale > 0.0f && largest > rules.maxScale) ||
+            (rules.maxAnisotropy > 0.0f && largest > rules.maxAnisotropy * smallest)) {
+            counts.scale++;
+            continue;
+        }
+
+        if (rules.useBox) {
+            glm::vec3 p(model.position[3 * i], model.position[3 * i + 1], model.position[3 * i + 2]);
+            if (p.x < rules.boxMin.x || p.y < rules.boxMin.y || p.z < rules.boxMin.z ||
+                p.x > rules.boxMax.x || p.y > rules.boxMax.y || p.z > rules.boxMax.z) {
+                counts.box++;
+                continue;
+            }
+        }
+
+        kept.push_back(i);
+    }
+
+    if (rules.floaterNeighbors > 0 && !kept.empty()) {
+        float radius = rules.floaterRadius;
+        if (radius <= 0.0f) {
+            // 3x the mean spacing of the remaining splats inside their bounding box
+            glm::vec3 lo(1e30f), hi(-1e30f);
+            for (uint32_t i : kept) {
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = std::min(lo[a], model.position[3 * i + a]);
+                    hi[a] = std::max(hi[a], model.position[3 * i + a]);
+                }
+            }
+            glm::vec3 extent = hi - lo;
+            float volume = std::max(extent.x * extent.y * extent.z, 1e-12f);
+            radius = 3.0f * std::cbrt(volume / kept.size());
+        }
+        std::cout << "Floater radius: " << radius << std::endl;
+
+        std::vector<uint32_t> neighbors = countNeighbors(model, kept, radius);
+        std::vector<uint32_t> dense;
+        dense.reserve(kept.size());
+        for (size_t c = 0; c < kept.size(); c++) {
+            if (neighbors[c] >= rules.floaterNeighbors) {
+                dense.push_back(kept[c]);
+            } else {
+                counts.floaters++;
+            }
+        }
+        kept.swap(dense);
+    }
+
+    return kept;
+}
+
+// Replicates the CPU side of a frame in main.cpp (tile keys from the projected bounding boxes, sort)
+// for a fixed orbit of views around the model. The projection follows splat_covariances.cs.
+struct PathResult {
+    double seconds = 0.0;
+    uint64_t keys = 0;
+};
+
+PathResult runCameraPath(const SplatModel& model, const std::vector<uint32_t>& indices, glm::vec3 center, float radius) {
+    const int NUM_VIEWS = 36;
+    PathResult result;
+
+    for (int v = 0; v < NUM_VIEWS; v++) {
+        float angle = glm::radians(360.0f * v / NUM_VIEWS);
+        glm::vec3 eye = center + radius * glm::vec3(std::cos(angle), 0.3f, std::sin(angle));
+        glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(FOV), 1.0f, NEAR, FAR);
+        glm::mat4 mvp = projection * view;
+        float right = glm::tan(FOV / 2) * NEAR;
+        float top = right;
+
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::tuple<uint32_t, uint32_t>> keyAndIndex;
+        for (uint32_t k : indices) {
+            const glm::mat4& covAndPos = model.covAndPos[k];
+            glm::mat3 cov = glm::mat3(covAndPos);
+            glm::vec3 worldPos = glm::vec3(covAndPos[3]);
+            glm::vec4 viewPos = view * glm::vec4(worldPos, 1.0f);
+
+            float onePerPosz = 1.0f / viewPos.z;
+            float onePerPoszSquared = onePerPosz * onePerPosz;
+            glm::mat3 J = glm::mat3(
+                -NEAR / right * onePerPosz, 0, NEAR / right * viewPos.x * onePerPoszSquared,
+                0, -NEAR / top * onePerPosz, NEAR / top * viewPos.y * onePerPoszSquared,
+                0, 0, 0);
+            glm::mat3 JW = J * glm::mat3(view);
+            glm::mat2 splatCovariance = glm::mat2(JW * cov * glm::transpose(JW));
+
+            glm::vec4 clipPos = mvp * glm::vec4(worldPos, 1.0f);
+            if (std::abs(clipPos.z) > clipPos.w) continue;
+            glm::vec4 ndcPos = clipPos / clipPos.w;
+
+            float var_x = splatCovariance[0][0];
+            float var_y = splatCovariance[1][1];
+            float cov_xy = splatCovariance[0][1];
+            float varxMinusVary = var_x - var_y;
+            float greaterEig = ((var_x + var_y) + std::sqrt(varxMinusVary * varxMinusVary + 4 * cov_xy * cov_xy)) * 0.5f;
+            float majorAxisLength = 3.034798181f * std::sqrt(greaterEig);
+
+            glm::ivec2 topCorner = glm::ivec2(((glm::vec2(ndcPos) + majorAxisLength) * 400.0f + 400.0f) / 16.0f);
+            glm::ivec2 botCorner = glm::ivec2(((glm::vec2(ndcPos) - majorAxisLength) * 400.0f + 400.0f) / 16.0f);
+            if ((topCorner.x < 0 && botCorner.x < 0) || (topCorner.y < 0 && botCorner.y < 0) ||
+                (topCorner.x > 49 && botCorner.x > 49) || (topCorner.y > 49 && botCorner.y > 49)) continue;
+            topCorner = glm::clamp(topCorner, 0, 49);
+            botCorner = glm::clamp(botCorner, 0, 49);
+
+            uint16_t uintDepth = static_cast<uint16_t>(ndcPos.z * 0xFFFF);
+            for (int j = botCorner.y; j <= topCorner.y; j++) {
+                for (int i = botCorner.x; i <= topCorner.x; i++) {
+                    uint32_t key = (static_cast<uint32_t>(j * 50 + i) << 16) | uintDepth;
+                    keyAndIndex.push_back(std::tuple<uint32_t, uint32_t>(key, k));
+                }
+            }
+        }
+        std::sort(keyAndIndex.begin(), keyAndIndex.end(),
+            [](std::tuple<uint32_t, uint32_t> const &a, std::tuple<uint32_t, uint32_t> const &b) {
+                return std::get<0>(a) < std::get<0>(b);
+            });
+
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.keys += keyAndIndex.size();
+    }
+
+    result.seconds /= NUM_VIEWS;
+    result.keys /= NUM_VIEWS;
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <in.ply> <out.ply> [--min-opacity a] [--min-scale s] [--max-scale s] "
+            "[--max-anisotropy r] [--bbox x0 y0 z0 x1 y1 z1] [--floater-neighbors k] [--floater-radius r]" << std::endl;
+        return 1;
+    }
+
+    const std::string inFile = argv[1];
+    const std::string outFile = argv[2];
+
+    PruneRules rules;
+    for (int a = 3; a < argc; a++) {
+        auto next = [&]() { return a + 1 < argc ? static_cast<float>(std::atof(argv[++a])) : 0.0f; };
+
+        if (!std::strcmp(argv[a], "--min-opacity")) rules.minOpacity = next();
+        else if (!std::strcmp(argv[a], "--min-scale")) rules.minScale = next();
+        else if (!std::strcmp(argv[a], "--max-scale")) rules.maxScale = next();
+        else if (!std::strcmp(argv[a], "--max-anisotropy")) rules.maxAnisotropy = next();
+        else if (!std::strcmp(argv[a], "--floater-neighbors")) rules.floaterNeighbors = static_cast<uint32_t>(next());
+        else if (!std::strcmp(argv[a], "--floater-radius")) rules.floaterRadius = next();
+        else if (!std::strcmp(argv[a], "--bbox")) {
+            rules.useBox = true;
+            for (int c = 0; c < 3; c++) rules.boxMin[c] = next();
+            for (int c = 0; c < 3; c++) rules.boxMax[c] = next();
+        } else {
+            std::cerr << "Unknown option " << argv[a] << std::endl;
+            return 1;
+        }
+    }
+
+    // raw values for writing, processed values for evaluating the rules
+    SplatModel raw(inFile, false, true, false);
+    if (!raw.loaded) return 1;
+    SplatModel model = raw;
+    model.processRange(0, model.numPoints);
+
+    PruneCounts counts;
+    std::vector<uint32_t> kept = prune(model, rules, counts);
+
+    if (!writeSplatPLY(outFile, raw, kept)) return 1;
+
+    const uint32_t removed = model.numPoints - static_cast<uint32_t>(kept.size());
+    const auto inSize = std::filesystem::file_size(inFile);
+    const auto outSize = std::filesystem::file_size(outFile);
+
+    std::cout << "Splats: " << model.numPoints << " -> " << kept.size() << " (" << removed << " removed, "
+        << 100.0 * removed / std::max(1u, model.numPoints) << "%)" << std::endl;
+    std::cout << "  opacity: " << counts.opacity << ", scale: " << counts.scale << ", bbox: " << counts.box
+        << ", floaters: " << counts.floaters << std::endl;
+    std::cout << "File size: " << inSize << " -> " << outSize << " bytes (" << static_cast<int64_t>(inSize) - static_cast<int64_t>(outSize) << " saved)" << std::endl;
+
+    if (kept.empty()) return 0;
+
+    // fixed orbit around the bounding box of the kept splats
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (uint32_t i : kept) {
+        for (int a = 0; a < 3; a++) {
+            lo[a] = std::min(lo[a], model.position[3 * i + a]);
+            hi[a] = std::max(hi[a], model.position[3 * i + a]);
+        }
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = std::max(glm::length(hi - lo) * 0.75f, 2.0f * NEAR);
+
+    std::vector<uint32_t> all(model.numPoints);
+    for (uint32_t i = 0; i < model.numPoints; i++) all[i] = i;
+
+    PathResult before = runCameraPath(model, all, center, radius);
+    PathResult after = runCameraPath(model, kept, center, radius);
+
+    std::cout << "Camera path (binning + sort per frame): " << before.seconds * 1000.0 << " ms -> " << after.seconds * 1000.0
+        << " ms, keys " << before.keys << " -> " << after.keys << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+// Renders a preview thumbnail of every splat model of an asset library on the CPU.
+//
+// Several models are processed at the same time, one per lane. A lane loads a model, keeps the --splats most
+// important splats (opacity times the area of their two largest axes, about how much of an image they cover),
+// computes only their covariances, frames them from their bounding box and renders the thumbnail with the CPU
+// projection and rasterization. The PNGs are written by separate jobs while the lane goes on to the next model.
+// Every lane reuses its arena and image buffer for all of its models.
+// A thumbnail newer than its model is kept unless --force, so a republished library only renders what changed.
+//
+// Options:
+//  --output dir         where the thumbnails go, the directory layout of the inputs is kept (required)
+//  --size px            width and height, rounded up to whole tiles (default 256)
+//  --splats n           splats rendered per model at most (default 200000)
+//  --lanes k            models in flight at the same time (default: the threads of the job system)
+//  --view az el         direction the models are seen from, degrees around and above them (default 30 20)
+//  --force              render every model, also when its thumbnail is up to date
+//
+// usage: splatThumbnails <dir | model.ply>... --output dir [options]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "core/frame_arena.h"
+#include "core/job_system.h"
+#include "model_loading/splat_model.h"
+#include "model_loading/splat_edits.h"
+#include "rendering/cpu_projection.h"
+#include "rendering/cpu_rasterizer.h"
+#include "rendering/tile_binning.h"
+#include "rendering/quality_controller.h"
+#include "rendering/image_metrics.h"
+
+#include <sys/resource.h>
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+struct ThumbnailOptions {
+    std::string outputDir;
+    uint32_t size = 256;
+    uint32_t maxSplats = 200000;
+    unsigned int numLanes = 0;
+    float azimuth = 30.0f;
+    float elevation = 20.0f;
+    bool force = false;
+};
+
+struct Asset {
+    std::filesystem::path model;
+    std::filesystem::path thumbnail;
+};
+
+// per lane, summed up for the report
+struct LaneStats {
+    uint32_t rendered = 0;
+    uint32_t failed = 0;
+    double loadTime = 0.0;
+    double detailTime = 0.0;
+    double renderTime = 0.0;
+    uint64_t splatsLoaded = 0;
+    uint64_t splatsRendered = 0;
+};
+
+// the part of the CPU renderer a lane reuses from model to model
+struct ThumbnailSlot {
+    FrameArena arena;
+    std::vector<float> rgb;
+    std::vector<JobHandle> writers;
+    LaneStats stats;
+};
+
+// the .ply files below the inputs, with the thumbnails they get
+std::vector<Asset> findAssets(const std::vector<std::string>& inputs, const std::string& outputDir) {
+    std::vector<Asset> assets;
+    auto add = [&](const std::filesystem::path& model, const std::filesystem::path& relative) {
+        std::filesystem::path thumbnail = std::filesystem::path(outputDir) / relative;
+        thumbnail.replace_extension(".png");
+        assets.push_back(Asset{model, thumbnail});
+    };
+
+    for (const std::string& input : inputs) {
+        if (std::filesystem::is_directory(input)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".ply") {
+                    add(entry.path(), std::filesystem::relative(entry.path(), input));
+                }
+            }
+        } else if (std::filesystem::is_regular_file(input)) {
+            add(input, std::filesystem::path(input).filename());
+        } else {
+            std::cerr << "Skipping " << input << ", no such file or directory" << std::endl;
+        }
+    }
+    // the same order on every run
+    std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.model < b.model; });
+    return assets;
+}
+
+// Reduces a model as read from the PLY file to its maxSplats most important splats, before any of them is
+// processed. Returns the indices that were dropped.
+std::vector<uint32_t> droppedSplats(const SplatModel& model, uint32_t maxSplats) {
+    if (model.numPoints <= maxSplats) return {};
+
+    std::vector<float> importance(model.numPoints);
+    for (uint32_t i = 0; i < model.numPoints; i++) {
+        // the scales are logarithms, the area of the two largest axes is the exp of their sum
+        const float* s = &model.scale[3 * i];
+        const float smallest = std::min(s[0], std::min(s[1], s[2]));
+        importance[i] = SplatModel::activatedOpacity(model.opacity[i]) * std::exp(s[0] + s[1] + s[2] - smallest);
+    }
+
+    std::vector<uint32_t> order(model.numPoints);
+    for (uint32_t i = 0; i < model.numPoints; i++) order[i] = i;
+    // the most important ones first, the rest is dropped
+    std::nth_element(order.begin(), order.begin() + maxSplats, order.end(), [&importance](uint32_t a, uint32_t b) {
+        return importance[a] > importance[b];
+    });
+    return std::vector<uint32_t>(order.begin() + maxSplats, order.end());
+}
+
+// A camera that sees the model from the given direction with all of it in the image. The box leaves out the
+// outermost percent of the splats on each axis, floaters far from the capture would shrink it to a dot.
+SplatView frameModel(const SplatModel& model, float azimuth, float elevation) {
+    const float fov = glm::radians(40.0f);
+    const uint32_t n = model.numPoints;
+
+    glm::vec3 lo(-1.0f), hi(1.0f);
+    if (n > 0) {
+        std::vector<float> values(n);
+        const size_t low = n / 100;
+        const size_t high = n - 1 - n / 100;
+        for (int a = 0; a < 3; a++) {
+            for (uint32_t i = 0; i < n; i++) values[i] = model.position[3 * i + a];
+            std::nth_element(values.begin(), values.begin() + low, values.end());
+            lo[a] = values[low];
+            std::nth_element(values.begin(), values.begin() + high, values.end());
+            hi[a] = values[high];
+        }
+    }
+
+    const glm::vec3 center = 0.5f * (lo + hi);
+    const float radius = std::max(0.5f * glm::length(hi - lo), 1e-3f);
+    const float distance = radius / std::sin(0.5f * fov);
+    const float az = glm::radians(azimuth);
+    const float el = glm::radians(elevation);
+    const glm::vec3 direction(std::sin(az) * std::cos(el), std::sin(el), std::cos(az) * std::cos(el));
+
+    SplatView splatView;
+    splatView.near = 0.01f * distance;
+    splatView.view = glm::lookAt(center + distance * direction, center, glm::vec3(0.0f, 1.0f, 0.0f));
+    // far enough for the splats outside of the box
+    splatView.projection = glm::perspective(fov, 1.0f, splatView.near, distance + 8.0f * radius);
+    splatView.screenRight = std::tan(0.5f * fov) * splatView.near;
+    splatView.screenTop = splatView.screenRight;
+    return splatView;
+}
+
+bool renderThumbnail(const Asset& asset, const ThumbnailOptions& options, ThumbnailSlot& slot) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    auto start = Clock::now();
+    SplatModel model(asset.model.string(), true, false, false);
+    if (!model.loaded) return false;
+    slot.stats.loadTime += seconds(start);
+    slot.stats.splatsLoaded += model.numPoints;
+
+    // only the splats that are kept are processed
+    start = Clock::now();
+    {
+        SplatEditor reduction(model);
+        reduction.remove(droppedSplats(model, options.maxSplats));
+        reduction.compact();
+    }
+    model.processRange(0, model.numPoints);
+    const SplatView splatView = frameModel(model, options.azimuth, options.elevation);
+    const SplatSoA splats(model.covAndPos, model.colorAndOpacity, model.numPoints);
+    slot.stats.splatsRendered += model.numPoints;
+    slot.stats.detailTime += seconds(start);
+
+    // the lanes run side by side, the binning of one model runs on its lane only
+    start = Clock::now();
+    const uint32_t tiles = (options.size + TILE_SIZE - 1) / TILE_SIZE;
+    TileGrid grid;
+    grid.x = grid.y = tiles;
+    const QualityLevel& quality = QUALITY_LEVELS[0];
+
+    CpuProjector projector(splats);
+    const uint32_t numVisible = projector.project(splats.count, splatView, grid, quality.alphaCutoff);
+    slot.arena.reset();
+    {
+        TileBins bins = binTilesCounting(projector.outputData(), numVisible, slot.arena, grid, 1);
+        rasterizeSortedCPU(projector.projected(), bins, grid, quality.alphaCutoff, quality.maxSplatsPerTile, slot.rgb);
+    }
+    slot.stats.renderTime += seconds(start);
+
+    const uint32_t width = tiles * TILE_SIZE;
+    slot.writers.push_back(JobSystem::global().submit([file = asset.thumbnail.string(), width, pixels = toImage8(slot.rgb, width, width)]() {
+        if (!stbi_write_png(file.c_str(), width, width, 3, pixels.data(), width * 3)) {
+            std::cerr << "Could not write " << file << std::endl;
+        }
+    }));
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    ThumbnailOptions options;
+    std::vector<std::string> inputs;
+    for (int a = 1; a < argc; a++) {
+        auto next = [&]() { return a + 1 < argc ? argv[++a] : ""; };
+
+        if (!std::strcmp(argv[a], "--output")) options.outputDir = next();
+        else if (!std::strcmp(argv[a], "--size")) options.size = static_cast<uint32_t>(std::max(1, std::atoi(next())));
+        else if (!std::strcmp(argv[a], "--splats")) options.maxSplats = static_cast<uint32_t>(std::max(1, std::atoi(next())));
+        else if (!std::strcmp(argv[a], "--lanes")) options.numLanes = static_cast<unsigned int>(std::max(1, std::atoi(next())));
+        else if (!std::strcmp(argv[a], "--view")) {
+            options.azimuth = static_cast<float>(std::atof(next()));
+            options.elevation = static_cast<float>(std::atof(next()));
+        }
+        else if (!std::strcmp(argv[a], "--force")) options.force = true;
+        else if (argv[a][0] == '-') {
+            std::cerr << "Unknown option " << argv[a] << std::endl;
+            return 1;
+        }
+        else inputs.push_back(argv[a]);
+    }
+    if (inputs.empty() || options.outputDir.empty()) {
+        std::cout << "usage: " << argv[0] << " <dir | model.ply>... --output dir [--size px] [--splats n] [--lanes k] "
+            "[--view azimuth elevation] [--force]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Asset> assets = findAssets(inputs, options.outputDir);
+    const size_t numFound = assets.size();
+    // a model that disappeared since it was found is reported and counted as failed, the others go on
+    uint32_t unreadable = 0;
+    if (!options.force) {
+        assets.erase(std::remove_if(assets.begin(), assets.end(), [&unreadable](const Asset& asset) {
+            std::error_code error;
+            const auto modelTime = std::filesystem::last_write_time(asset.model, error);
+            if (error) {
+                std::cerr << "Skipping " << asset.model.string() << ": " << error.message() << std::endl;
+                unreadable++;
+                return true;
+            }
+            const auto thumbnailTime = std::filesystem::last_write_time(asset.thumbnail, error);
+            return !error && thumbnailTime >= modelTime;
+        }), assets.end());
+    }
+    // a directory that cannot be created shows up as a thumbnail that could not be written
+    for (const Asset& asset : assets) {
+        std::error_code error;
+        std::filesystem::create_directories(asset.thumbnail.parent_path(), error);
+    }
+
+    JobSystem& jobs = JobSystem::global();
+    const unsigned int numLanes = std::max(1u, std::min<unsigned int>(options.numLanes > 0 ? options.numLanes : jobs.concurrency(),
+                                                                      static_cast<unsigned int>(assets.size())));
+    std::cout << numFound << " models, " << numFound - assets.size() - unreadable << " thumbnails up to date, " << numLanes << " lanes" << std::endl;
+
+    // a lane is a background job, so that the threads waiting inside the projection and rasterization of
+    // another lane help with those and never start loading a model of their own
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ThumbnailSlot> slots(numLanes);
+    std::atomic<size_t> nextAsset{0};
+    std::vector<JobHandle> lanes;
+    for (unsigned int l = 0; l < numLanes; l++) {
+        lanes.push_back(jobs.submitBackground([&, &slot = slots[l]]() {
+            for (size_t a = nextAsset++; a < assets.size(); a = nextAsset++) {
+                if (renderThumbnail(assets[a], options, slot)) slot.stats.rendered++;
+                else slot.stats.failed++;
+            }
+        }));
+    }
+    jobs.wait(lanes);
+    for (ThumbnailSlot& slot : slots) jobs.wait(slot.writers);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LaneStats total;
+    total.failed = unreadable;
+    for (const ThumbnailSlot& slot : slots) {
+        total.rendered += slot.stats.rendered;
+        total.failed += slot.stats.failed;
+        total.loadTime += slot.stats.loadTime;
+        total.detailTime += slot.stats.detailTime;
+        total.renderTime += slot.stats.renderTime;
+        total.splatsLoaded += slot.stats.splatsLoaded;
+        total.splatsRendered += slot.stats.splatsRendered;
+    }
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const double perAsset = 1000.0 / std::max(1u, total.rendered);
+    std::cout << "Rendered " << total.rendered << " thumbnails (" << total.failed << " failed) in " << seconds << " s, "
+        << total.rendered / std::max(seconds, 1e-9) << " assets/s" << std::endl;
+    std::cout << "Per asset: load " << total.loadTime * perAsset << " ms, level of detail " << total.detailTime * perAsset
+        << " ms, render " << total.renderTime * perAsset << " ms" << std::endl;
+    std::cout << "Splats: " << total.splatsLoaded << " loaded, " << total.splatsRendered << " rendered ("
+        << 100.0 * total.splatsRendered / std::max<uint64_t>(1, total.splatsLoaded) << "%)" << std::endl;
+    // ru_maxrss is in kilobytes on Linux
+    std::cout << "Peak memory: " << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+
+    return total.failed == 0 ? 0 : 1;
+}